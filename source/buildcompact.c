@@ -0,0 +1,59 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file buildcompact.c
+ * @brief convert shape file into quantized columnar geometry (.shpc).
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.2
+ *
+ * @since 2024-10-20 10:02:48
+ * @date 2024-10-24 14:50:00
+ *
+ * @note
+ */
+#include "shapetool-common.h"
+#include "drawshape.h"
+
+
+static int buildCompact(const char *shpcfile, const shapeSidecarSource *source, void *buildArg)
+{
+    if (source->nShpTypeMask == SHAPE_TYPE_NIL) {
+        printf("Error: Bad shp type: SHAPE_TYPE_NIL\n");
+        return -1;
+    }
+
+    return shpcFileBuild(shpcfile, source->fileMap, source->nShapeType, source->bounds, source->hasZ, source->hasM);
+}
+
+
+int shpfile2compact(shapetool_flags *flags, shapetool_options *options)
+{
+    const char *shapefile = CSTR_FILE_URI_PATH(options->shpfile);
+
+    if (shapeFileBuildSidecar(shapefile, SHPCOMPACT_FILE_EXT, buildCompact, NULL) != 0) {
+        return SHAPETOOL_RES_ERR;
+    }
+    return SHAPETOOL_RES_SOK;
+}
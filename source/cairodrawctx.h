@@ -26,10 +26,10 @@
  *
  * @author mapaware@hotmail.com
  * @copyright © 2024-2030 mapaware.top All Rights Reserved.
- * @version 0.0.12
+ * @version 0.0.24
  *
  * @since 2024-10-03 00:05:20
- * @date 2024-10-16 22:07:05
+ * @date 2024-10-24 15:35:00
  *
  * @note
  */
@@ -75,6 +75,7 @@ extern "C" {
 
 
 #include <common/viewport.h>
+#include <common/memapi.h>
 
 #include "cssdrawstyle.h"
 
@@ -89,6 +90,31 @@ extern "C" {
 #   define CAIRO_DRAW_HEIGHT_MIN      96
 #endif
 
+#ifndef CAIRO_DRAW_BATCH_MAX
+// records in one block of batch mode: a path holds features of one block
+#   define CAIRO_DRAW_BATCH_MAX       8192
+#endif
+
+#ifndef CAIRO_DRAW_POINT_RADIUS
+// radius of point marker in dots
+#   define CAIRO_DRAW_POINT_RADIUS    3
+#endif
+
+#ifndef CAIRO_DRAW_SIMPLIFY_MAX
+// max tolerance of simplifying parts in view space (dots)
+#   define CAIRO_DRAW_SIMPLIFY_MAX    8.0
+#endif
+
+#ifndef CAIRO_DRAW_SNAP_MAX
+// max subdivisions of a dot for snapping view points
+#   define CAIRO_DRAW_SNAP_MAX        64
+#endif
+
+#ifndef CAIRO_DRAW_SUBPIXEL_MAX
+// max size (dots) of features drawn from envelope only
+#   define CAIRO_DRAW_SUBPIXEL_MAX    4.0
+#endif
+
 #ifndef CAIRO_DRAW_WIDTH_DEFAULT
 // default 15.6 in, 4K display
 #   define CAIRO_DRAW_WIDTH_DEFAULT   3840
@@ -119,6 +145,34 @@ typedef enum
 } cairoDrawDPI;
 
 
+typedef enum
+{
+    quality_auto = -1,      // quality_draft at dpi_draft_display, else quality_normal
+    quality_normal = 0,     // cairo defaults
+    quality_draft,          // fastest raster for previews: no antialias, simplified
+    quality_best            // best antialias and curves, round joins and caps
+} cairoDrawQuality;
+
+
+typedef enum
+{
+    subpixel_draw = 0,      // draw all features from geometry
+    subpixel_skip,          // skip features under subpixelPx
+    subpixel_dot            // one coverage weighted dot for features under subpixelPx
+} cairoSubpixelMode;
+
+
+typedef struct
+{
+    // pixel of surface
+    int x;
+    int y;
+
+    // premultiplied ARGB32
+    ub4 argb;
+} cairoDrawDot;
+
+
 typedef struct
 {
     // cairo paint devices
@@ -131,10 +185,95 @@ typedef struct
     Viewport2D viewport;
 
     CssDrawStyle drawStyles;
+
+    // rendering profile applied to cr
+    cairoDrawQuality quality;
+
+    // batch mode: consecutive features of the same style and shape type
+    //   are added to one path which is filled and stroked once
+    int batchMode;
+
+    // features in pending path of batch mode, all of records in block
+    //   batchBlock (nShapeId / CAIRO_DRAW_BATCH_MAX), so that a path
+    //   never depends on which features are culled
+    int batchFeatures;
+    int batchBlock;
+    int batchShapeType;
+    CssDrawStyle batchStyle;
+
+    // dots of sub-pixel features in pending batch, blended over pixels of
+    //   surface after its path is painted
+    cairoDrawDot *batchDots;
+    int numBatchDots;
+    int batchDotsCapacity;
+
+    // marker of points pre-rendered with pointSpriteStyle
+    cairo_surface_t *pointSprite;
+    CssDrawStyle pointSpriteStyle;
+
+    // tolerance (dots) of simplifying parts in view space, 0 for none
+    double simplifyPx;
+
+    // view points are snapped to grid of 1/snapGrid dot, 0 for none
+    int snapGrid;
+
+    // polygons and lines under subpixelPx in both width and height are
+    //   handled by their envelopes only, without reading geometry
+    cairoSubpixelMode subpixelMode;
+    double subpixelPx;
+
+    // number of features elided by subpixelMode, counted only if center of
+    //   envelope in view is in [countBox.Xmin, Xmax) x [countBox.Ymin, Ymax)
+    sb8 numSubpixel;
+    CGBox2D countBox;
+
+    // scratch of view points of one part: viewPoints has 3 regions of
+    //   2 * capacity points (for transform, clipping and simplification),
+    //   viewStack has 4 * capacity
+    CGPoint2D *viewPoints;
+    int *viewStack;
+    int viewPointsCapacity;
 } cairoDrawCtx;
 
 
-static int cairoDrawCtxInit(cairoDrawCtx *CDC, CGBox2D dataBox, CGSize2D drawSize, cairoDotUnit dotUnit, float drawDPI)
+/**
+ * set antialias, tolerance, line join and cap of CDC->cr by CDC->quality
+ */
+static void cairoDrawCtxApplyQuality(cairoDrawCtx *CDC)
+{
+    cairo_t *cr = CDC->cr;
+
+    switch (CDC->quality) {
+    case quality_draft:
+        cairo_set_antialias(cr, CAIRO_ANTIALIAS_NONE);
+        cairo_set_tolerance(cr, 0.5);
+        cairo_set_line_join(cr, CAIRO_LINE_JOIN_BEVEL);
+        cairo_set_line_cap(cr, CAIRO_LINE_CAP_BUTT);
+        break;
+
+    case quality_best:
+        cairo_set_antialias(cr, CAIRO_ANTIALIAS_BEST);
+        cairo_set_tolerance(cr, 0.05);
+        cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND);
+        cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+        break;
+
+    default:
+        cairo_set_antialias(cr, CAIRO_ANTIALIAS_DEFAULT);
+        cairo_set_tolerance(cr, 0.1);
+        cairo_set_line_join(cr, CAIRO_LINE_JOIN_MITER);
+        cairo_set_line_cap(cr, CAIRO_LINE_CAP_BUTT);
+        break;
+    }
+}
+
+
+/**
+ * quality_auto is taken as quality_draft at dpi_draft_display, else as
+ *   quality_normal. the quality also sets default simplifyPx, which caller
+ *   may change.
+ */
+static int cairoDrawCtxInit(cairoDrawCtx *CDC, CGBox2D dataBox, CGSize2D drawSize, cairoDotUnit dotUnit, float drawDPI, cairoDrawQuality quality)
 {
     CGBox2D viewBox = {
         .Xmin = 0,
@@ -161,6 +300,33 @@ static int cairoDrawCtxInit(cairoDrawCtx *CDC, CGBox2D dataBox, CGSize2D drawSiz
 
     ViewportInitAll(&CDC->viewport, dataBox, viewBox, viewDPI, 1.0f);
 
+    // no batch mode unless set by caller
+    CDC->batchMode = 0;
+    CDC->batchFeatures = 0;
+    CDC->batchDots = 0;
+    CDC->numBatchDots = 0;
+    CDC->batchDotsCapacity = 0;
+
+    CDC->pointSprite = 0;
+
+    if (quality == quality_auto) {
+        quality = ((int) drawDPI == dpi_draft_display ? quality_draft : quality_normal);
+    }
+    CDC->quality = quality;
+    cairoDrawCtxApplyQuality(CDC);
+
+    // vertices closer than a dot are not seen in draft
+    CDC->simplifyPx = (quality == quality_draft ? 1.0 : 0);
+    CDC->snapGrid = 0;
+    CDC->subpixelMode = subpixel_draw;
+    CDC->subpixelPx = 0;
+    CDC->numSubpixel = 0;
+    CDC->countBox.Xmin = CDC->countBox.Ymin = -DBL_MAX;
+    CDC->countBox.Xmax = CDC->countBox.Ymax = DBL_MAX;
+    CDC->viewPoints = 0;
+    CDC->viewStack = 0;
+    CDC->viewPointsCapacity = 0;
+
     // TODO:
     ///CDC->polygonStyle.border_color.red = 128;
     ///CDC->polygonStyle.fill_color.blue = 128;
@@ -177,6 +343,26 @@ static void cairoDrawCtxFinal(cairoDrawCtx *CDC)
     CDC->surface = 0;
     CDC->cr = 0;
 
+    if (CDC->pointSprite) {
+        cairo_surface_destroy(CDC->pointSprite);
+        CDC->pointSprite = 0;
+    }
+
+    if (CDC->batchDots) {
+        mem_free(CDC->batchDots);
+        CDC->batchDots = 0;
+        CDC->numBatchDots = 0;
+        CDC->batchDotsCapacity = 0;
+    }
+
+    if (CDC->viewPoints) {
+        mem_free(CDC->viewPoints);
+        mem_free(CDC->viewStack);
+        CDC->viewPoints = 0;
+        CDC->viewStack = 0;
+        CDC->viewPointsCapacity = 0;
+    }
+
     if (cr) {
         cairo_destroy(cr);
     }
@@ -186,6 +372,74 @@ static void cairoDrawCtxFinal(cairoDrawCtx *CDC)
 }
 
 
+/**
+ * make a draw context for rows [y0, y1) of CDC which paints directly into
+ *   the pixels of CDC->surface. viewport is the same as CDC's, but its
+ *   viewBox only covers the band inflated by margin (for culling), so that
+ *   shapes stroked across the band edge are drawn by both bands. sub-pixel
+ *   features are only counted by the band of their center.
+ *   cairo_surface_flush(CDC->surface) must be called before, and
+ *   cairo_surface_mark_dirty(CDC->surface) after all bands are drawn.
+ */
+static int cairoDrawCtxInitBand(const cairoDrawCtx *CDC, int y0, int y1, double margin, cairoDrawCtx *bandCDC)
+{
+    unsigned char *data = cairo_image_surface_get_data(CDC->surface);
+    int stride = cairo_image_surface_get_stride(CDC->surface);
+    int width = cairo_image_surface_get_width(CDC->surface);
+
+    bzero(bandCDC, sizeof(cairoDrawCtx));
+
+    if (! data || y0 < 0 || y1 <= y0 || y1 > cairo_image_surface_get_height(CDC->surface)) {
+        printf("Error: bad draw band: %d-%d\n", y0, y1);
+        return -1;
+    }
+
+    bandCDC->surface = cairo_image_surface_create_for_data(data + (size_t) y0 * stride,
+        cairo_image_surface_get_format(CDC->surface), width, y1 - y0, stride);
+    if (cairo_surface_status(bandCDC->surface) != CAIRO_STATUS_SUCCESS) {
+        printf("Error: cairo_image_surface_create_for_data()\n");
+        cairo_surface_destroy(bandCDC->surface);
+        bandCDC->surface = 0;
+        return -1;
+    }
+
+    bandCDC->cr = cairo_create(bandCDC->surface);
+    if (cairo_status(bandCDC->cr) != CAIRO_STATUS_SUCCESS) {
+        printf("Error: cairo_create()\n");
+        cairoDrawCtxFinal(bandCDC);
+        return -1;
+    }
+
+    // view coordinates of band are the same as of whole canvas
+    cairo_translate(bandCDC->cr, 0, -y0);
+
+    bandCDC->quality = CDC->quality;
+    cairoDrawCtxApplyQuality(bandCDC);
+
+    bandCDC->viewport = CDC->viewport;
+    bandCDC->viewport.viewBox.Ymin = CG_MAX(CDC->viewport.viewBox.Ymin, y0 - margin);
+    bandCDC->viewport.viewBox.Ymax = CG_MIN(CDC->viewport.viewBox.Ymax, y1 + margin);
+
+    bandCDC->drawStyles = CDC->drawStyles;
+    bandCDC->batchMode = CDC->batchMode;
+    bandCDC->simplifyPx = CDC->simplifyPx;
+    bandCDC->snapGrid = CDC->snapGrid;
+    bandCDC->subpixelMode = CDC->subpixelMode;
+    bandCDC->subpixelPx = CDC->subpixelPx;
+
+    // top and bottom bands count what is above or below canvas
+    bandCDC->countBox = CDC->countBox;
+    if (y0 > 0) {
+        bandCDC->countBox.Ymin = CG_MAX(CDC->countBox.Ymin, y0);
+    }
+    if (y1 < cairo_image_surface_get_height(CDC->surface)) {
+        bandCDC->countBox.Ymax = CG_MIN(CDC->countBox.Ymax, y1);
+    }
+
+    return 0;
+}
+
+
 static void cairoDrawCtxSetStyle(cairoDrawCtx *CDC, const CssKeyArray cssStyleKeys, cstrbuf styleClass)
 {
     CssKeyArrayNode classNodes[32] = { 0 };
@@ -197,6 +451,11 @@ static void cairoDrawCtxSetStyle(cairoDrawCtx *CDC, const CssKeyArray cssStyleKe
 }
 
 
+/**
+ * write png of whole surface, or of viewBoxOutput in view coordinates (dots
+ *   from top left of surface) clipped to the surface. the crop is a surface
+ *   over pixels of CDC->surface with its stride, nothing is copied.
+ */
 static cairo_status_t cairoDrawCtxOutputPng(cairoDrawCtx *CDC, const CGBox2D *viewBoxOutput, const char * outputPngFile)
 {
     cairo_status_t status = CAIRO_STATUS_LAST_STATUS;
@@ -204,7 +463,37 @@ static cairo_status_t cairoDrawCtxOutputPng(cairoDrawCtx *CDC, const CGBox2D *vi
     if (! viewBoxOutput) {
         status = cairo_surface_write_to_png(CDC->surface, outputPngFile);
     } else {
-        // TODO:
+        unsigned char *data;
+        int stride, x0, y0, x1, y1;
+        cairo_surface_t *crop;
+
+        // pending drawing must be in pixels before they are shared
+        cairo_surface_flush(CDC->surface);
+
+        data = cairo_image_surface_get_data(CDC->surface);
+        stride = cairo_image_surface_get_stride(CDC->surface);
+
+        // whole dots touched by box
+        x0 = (int) CG_MAX(0, floor(viewBoxOutput->Xmin));
+        y0 = (int) CG_MAX(0, floor(viewBoxOutput->Ymin));
+        x1 = (int) CG_MIN(cairo_image_surface_get_width(CDC->surface), ceil(viewBoxOutput->Xmax));
+        y1 = (int) CG_MIN(cairo_image_surface_get_height(CDC->surface), ceil(viewBoxOutput->Ymax));
+
+        if (! data || cairo_image_surface_get_format(CDC->surface) != CAIRO_FORMAT_ARGB32 || x1 <= x0 || y1 <= y0) {
+            printf("Error: bad output box: (%g, %g, %g, %g)\n",
+                viewBoxOutput->Xmin, viewBoxOutput->Ymin, viewBoxOutput->Xmax, viewBoxOutput->Ymax);
+            return CAIRO_STATUS_INVALID_SIZE;
+        }
+
+        // 4 bytes per dot of ARGB32
+        crop = cairo_image_surface_create_for_data(data + (size_t) y0 * stride + (size_t) x0 * 4,
+            CAIRO_FORMAT_ARGB32, x1 - x0, y1 - y0, stride);
+
+        status = cairo_surface_status(crop);
+        if (status == CAIRO_STATUS_SUCCESS) {
+            status = cairo_surface_write_to_png(crop, outputPngFile);
+        }
+        cairo_surface_destroy(crop);
     }
 
     return status;
@@ -0,0 +1,226 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file cgclip.h
+ * @brief clipping of 2D rings and segments to a box
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.1
+ *
+ * @since 2024-10-22 20:03:44
+ * @date 2024-10-22 20:03:44
+ *
+ * @note
+ *   Rings are clipped by Sutherland-Hodgman, one pass per edge of box.
+ *   Segments are clipped by Liang-Barsky.
+ */
+#ifndef CG_CLIP_H__
+#define CG_CLIP_H__
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+#include "cgtypes.h"
+#include "basetype.h"
+
+
+// edges of clip box
+#define CG_CLIP_XMIN    0
+#define CG_CLIP_XMAX    1
+#define CG_CLIP_YMIN    2
+#define CG_CLIP_YMAX    3
+
+
+STATIC_INLINE int CGClipInside(const CGPoint2D *P, const CGBox2D *box, int edge)
+{
+    switch (edge) {
+    case CG_CLIP_XMIN:
+        return (P->X >= box->Xmin);
+    case CG_CLIP_XMAX:
+        return (P->X <= box->Xmax);
+    case CG_CLIP_YMIN:
+        return (P->Y >= box->Ymin);
+    }
+    return (P->Y <= box->Ymax);
+}
+
+
+/**
+ * intersection of segment AB with edge line of box. A and B are on
+ *   different sides of the edge.
+ */
+STATIC_INLINE void CGClipIntersect(const CGPoint2D *A, const CGPoint2D *B, const CGBox2D *box, int edge, CGPoint2D *I)
+{
+    double t, v;
+
+    if (edge == CG_CLIP_XMIN || edge == CG_CLIP_XMAX) {
+        v = (edge == CG_CLIP_XMIN ? box->Xmin : box->Xmax);
+        t = (v - A->X) / (B->X - A->X);
+        I->X = v;
+        I->Y = A->Y + t * (B->Y - A->Y);
+    } else {
+        v = (edge == CG_CLIP_YMIN ? box->Ymin : box->Ymax);
+        t = (v - A->Y) / (B->Y - A->Y);
+        I->X = A->X + t * (B->X - A->X);
+        I->Y = v;
+    }
+}
+
+
+/**
+ * clip ring against one edge of box. returns number of points written
+ *   to outPts, or -1 if more than capacity.
+ */
+static int CGClipRingEdge(const CGPoint2D *pts, int count, const CGBox2D *box, int edge, CGPoint2D *outPts, int capacity)
+{
+    int i, inS, inE, numOut = 0;
+    const CGPoint2D *S, *E;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    // closing edge from last to first point is implied
+    S = &pts[count - 1];
+    inS = CGClipInside(S, box, edge);
+
+    for (i = 0; i < count; i++) {
+        E = &pts[i];
+        inE = CGClipInside(E, box, edge);
+
+        if (inE != inS) {
+            if (numOut == capacity) {
+                return (-1);
+            }
+            CGClipIntersect(S, E, box, edge, &outPts[numOut++]);
+        }
+
+        if (inE) {
+            if (numOut == capacity) {
+                return (-1);
+            }
+            outPts[numOut++] = *E;
+        }
+
+        S = E;
+        inS = inE;
+    }
+
+    return numOut;
+}
+
+
+/**
+ * Sutherland-Hodgman clipping of ring to box.
+ *   pts: ring of count points
+ *   outPts, tmpPts: capacity points each, distinct from pts
+ * returns number of points in outPts, which is closed (last point same
+ *   as first) if not empty, 0 if ring is outside of box, or -1 if more
+ *   than capacity points are needed.
+ */
+static int CGClipRingToBox(const CGPoint2D *pts, int count, const CGBox2D *box, CGPoint2D *outPts, CGPoint2D *tmpPts, int capacity)
+{
+    int num;
+
+    num = CGClipRingEdge(pts, count, box, CG_CLIP_XMIN, tmpPts, capacity);
+    if (num > 0) {
+        num = CGClipRingEdge(tmpPts, num, box, CG_CLIP_XMAX, outPts, capacity);
+    }
+    if (num > 0) {
+        num = CGClipRingEdge(outPts, num, box, CG_CLIP_YMIN, tmpPts, capacity);
+    }
+    if (num > 0) {
+        num = CGClipRingEdge(tmpPts, num, box, CG_CLIP_YMAX, outPts, capacity);
+    }
+
+    if (num > 0 && (outPts[0].X != outPts[num - 1].X || outPts[0].Y != outPts[num - 1].Y)) {
+        if (num == capacity) {
+            return (-1);
+        }
+        outPts[num] = outPts[0];
+        num++;
+    }
+
+    return num;
+}
+
+
+/**
+ * Liang-Barsky clipping of segment AB to box. A and B are replaced by ends
+ *   of the part inside box. returns 0 if segment is outside of box.
+ */
+static int CGClipSegmentToBox(CGPoint2D *A, CGPoint2D *B, const CGBox2D *box)
+{
+    int i;
+    double r, t0 = 0, t1 = 1;
+
+    const double X = A->X, Y = A->Y;
+    const double dx = B->X - X, dy = B->Y - Y;
+
+    const double p[4] = {-dx, dx, -dy, dy};
+    const double q[4] = {X - box->Xmin, box->Xmax - X, Y - box->Ymin, box->Ymax - Y};
+
+    for (i = 0; i < 4; i++) {
+        if (p[i] == 0) {
+            // parallel to edge
+            if (q[i] < 0) {
+                return 0;
+            }
+        } else {
+            r = q[i] / p[i];
+            if (p[i] < 0) {
+                if (r > t1) {
+                    return 0;
+                }
+                if (r > t0) {
+                    t0 = r;
+                }
+            } else {
+                if (r < t0) {
+                    return 0;
+                }
+                if (r < t1) {
+                    t1 = r;
+                }
+            }
+        }
+    }
+
+    if (t1 < 1) {
+        B->X = X + t1 * dx;
+        B->Y = Y + t1 * dy;
+    }
+    if (t0 > 0) {
+        A->X = X + t0 * dx;
+        A->Y = Y + t0 * dy;
+    }
+    return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* CG_CLIP_H__ */
@@ -0,0 +1,170 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file cgsimplify.h
+ * @brief polyline simplification of 2D points
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.2
+ *
+ * @since 2024-10-21 14:20:06
+ * @date 2024-10-22 16:05:31
+ *
+ * @note
+ *   Points are kept in place: first and last point of input are always kept,
+ *   so a closed ring stays closed.
+ */
+#ifndef CG_SIMPLIFY_H__
+#define CG_SIMPLIFY_H__
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+#include "cgtypes.h"
+#include "basetype.h"
+
+
+/**
+ * squared distance from point P to segment AB
+ */
+STATIC_INLINE double CGSegmentDistance2(const CGPoint2D *P, const CGPoint2D *A, const CGPoint2D *B)
+{
+    double t, dx, dy;
+    double ux = B->X - A->X;
+    double uy = B->Y - A->Y;
+    double d2 = ux * ux + uy * uy;
+
+    if (d2 > 0) {
+        t = ((P->X - A->X) * ux + (P->Y - A->Y) * uy) / d2;
+        t = (t < 0 ? 0 : (t > 1 ? 1 : t));
+        dx = A->X + t * ux - P->X;
+        dy = A->Y + t * uy - P->Y;
+    } else {
+        dx = A->X - P->X;
+        dy = A->Y - P->Y;
+    }
+    return (dx * dx + dy * dy);
+}
+
+
+/**
+ * radial distance simplification: drops points within tolerance of the
+ *   last kept point. cheap pass to thin dense input before Douglas-Peucker.
+ *   pts: input points (count > 0)
+ *   outPts: at least count points, may not be pts
+ * returns number of points written to outPts.
+ */
+static int CGSimplifyRadialDistance(const CGPoint2D *pts, int count, double tolerance, CGPoint2D *outPts)
+{
+    int i, numOut = 0;
+    double dx, dy;
+
+    const double tol2 = tolerance * tolerance;
+
+    if (count < 3) {
+        for (i = 0; i < count; i++) {
+            outPts[i] = pts[i];
+        }
+        return count;
+    }
+
+    outPts[numOut++] = pts[0];
+
+    for (i = 1; i < count - 1; i++) {
+        dx = pts[i].X - outPts[numOut - 1].X;
+        dy = pts[i].Y - outPts[numOut - 1].Y;
+
+        if (dx * dx + dy * dy > tol2) {
+            outPts[numOut++] = pts[i];
+        }
+    }
+
+    outPts[numOut++] = pts[count - 1];
+
+    return numOut;
+}
+
+
+/**
+ * Douglas-Peucker simplification without recursion.
+ *   pts: input points (count > 0)
+ *   tolerance: max distance of dropped point to simplified line
+ *   outPts: at least count points, may not be pts
+ *   stack: scratch of at least count * 2 ints
+ * returns number of points written to outPts.
+ */
+static int CGSimplifyDouglasPeucker(const CGPoint2D *pts, int count, double tolerance, CGPoint2D *outPts, int *stack)
+{
+    int i, first, last, farthest, top = 0, numOut = 0;
+    double d2, maxd2;
+
+    const double tol2 = tolerance * tolerance;
+
+    if (count < 3) {
+        for (i = 0; i < count; i++) {
+            outPts[i] = pts[i];
+        }
+        return count;
+    }
+
+    // ranges are popped left first, so kept points come out in order
+    stack[top++] = 0;
+    stack[top++] = count - 1;
+
+    outPts[numOut++] = pts[0];
+
+    while (top > 0) {
+        last = stack[--top];
+        first = stack[--top];
+
+        maxd2 = -1;
+        farthest = first;
+
+        for (i = first + 1; i < last; i++) {
+            d2 = CGSegmentDistance2(&pts[i], &pts[first], &pts[last]);
+            if (d2 > maxd2) {
+                maxd2 = d2;
+                farthest = i;
+            }
+        }
+
+        if (maxd2 > tol2) {
+            stack[top++] = farthest;
+            stack[top++] = last;
+            stack[top++] = first;
+            stack[top++] = farthest;
+        } else {
+            outPts[numOut++] = pts[last];
+        }
+    }
+
+    return numOut;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* CG_SIMPLIFY_H__ */
@@ -26,10 +26,10 @@
  *
  * @author mapaware@hotmail.com
  * @copyright © 2024-2030 mapaware.top All Rights Reserved.
- * @version 0.1.3
+ * @version 0.1.4
  *
  * @since 2024-10-16 12:45:30
- * @date 2024-10-16 22:09:07
+ * @date 2024-10-22 20:31:09
  *
  * @note
  */
@@ -120,6 +120,8 @@ typedef struct
 
 #define CGBoxIsOverlap(a, b)   ((a).Xmin<(b).Xmax && (a).Ymin<(b).Ymax && (b).Xmin<(a).Xmax && (b).Ymin<(a).Ymax)
 
+#define CGBoxContains(a, b)    ((a).Xmin<=(b).Xmin && (a).Ymin<=(b).Ymin && (b).Xmax<=(a).Xmax && (b).Ymax<=(a).Ymax)
+
 #define CGBoxInflate(box, d)   do { box.Xmin -= d; box.Ymin -= d; box.Xmax += d; box.Ymax += d; } while(0)
 
 #ifdef __cplusplus
@@ -0,0 +1,132 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file murmur3.h
+ * @brief 128-bit MurmurHash3 (x64) over a stream of 16-byte blocks
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.1
+ *
+ * @since 2024-10-23 19:40:52
+ * @date 2024-10-23 19:40:52
+ *
+ * @note
+ *   MurmurHash3_x64_128 by Austin Appleby (public domain). Data is fed in
+ *   whole 16-byte blocks, so rows of an image can be hashed one by one
+ *   without copying them together. Little-endian hosts only.
+ */
+#ifndef MURMUR3_H__
+#define MURMUR3_H__
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+#include "basetype.h"
+
+
+#define MURMUR3_BLOCK_SIZE  16
+
+#define MURMUR3_ROTL64(x, r)  (((x) << (r)) | ((x) >> (64 - (r))))
+
+
+typedef struct
+{
+    ub8 h1;
+    ub8 h2;
+    ub8 len;
+} murmur3_128_t;
+
+
+STATIC_INLINE ub8 murmur3_fmix64(ub8 k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+
+STATIC_INLINE void murmur3_128_init(murmur3_128_t *ctx, ub4 seed)
+{
+    ctx->h1 = seed;
+    ctx->h2 = seed;
+    ctx->len = 0;
+}
+
+
+/**
+ * hash nblocks of 16 bytes
+ */
+STATIC_INLINE void murmur3_128_update(murmur3_128_t *ctx, const void *data, size_t nblocks)
+{
+    const ub8 c1 = 0x87c37b91114253d5ULL;
+    const ub8 c2 = 0x4cf5ad432745937fULL;
+
+    const ub1 *p = (const ub1 *) data;
+    ub8 h1 = ctx->h1, h2 = ctx->h2, k1, k2;
+    size_t i;
+
+    for (i = 0; i < nblocks; i++, p += MURMUR3_BLOCK_SIZE) {
+        memcpy(&k1, p, 8);
+        memcpy(&k2, p + 8, 8);
+
+        k1 *= c1; k1 = MURMUR3_ROTL64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = MURMUR3_ROTL64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2; k2 = MURMUR3_ROTL64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = MURMUR3_ROTL64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    ctx->h1 = h1;
+    ctx->h2 = h2;
+    ctx->len += (ub8) nblocks * MURMUR3_BLOCK_SIZE;
+}
+
+
+STATIC_INLINE void murmur3_128_final(murmur3_128_t *ctx, ub8 hash[2])
+{
+    ub8 h1 = ctx->h1 ^ ctx->len;
+    ub8 h2 = ctx->h2 ^ ctx->len;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = murmur3_fmix64(h1);
+    h2 = murmur3_fmix64(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    hash[0] = h1;
+    hash[1] = h2;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* MURMUR3_H__ */
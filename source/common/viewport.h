@@ -26,10 +26,10 @@
  *
  * @author mapaware@hotmail.com
  * @copyright © 2024-2030 mapaware.top All Rights Reserved.
- * @version 1.0.4
+ * @version 1.0.6
  *
  * @since 2005-09-30 13:45:12
- * @date 2024-10-16 22:07:10
+ * @date 2024-10-23 11:47:03
  *
  * @note
  *
@@ -148,6 +148,32 @@ static void ViewportInitAll(Viewport2D *vp, CGBox2D dataBox, CGBox2D viewBox, CG
 }
 
 
+/**
+ * @brief init viewport so that dataBox maps exactly onto viewBox of same
+ *   aspect, without inflating dataBox nor limits of scale, so that views of
+ *   adjacent data boxes (tiles) join without seams.
+ */
+static void ViewportInitExact(Viewport2D *vp, CGBox2D dataBox, CGBox2D viewBox, CGSize2D viewDPI)
+{
+    vp->dataBox = dataBox;
+    vp->viewBox = viewBox;
+
+    vp->dpiRatio = viewDPI.H / viewDPI.W;
+    vp->Xdpi = viewDPI.W;
+
+    vp->dataCP.X = (vp->dataBox.Xmin + vp->dataBox.Xmax) * 0.5;
+    vp->dataCP.Y = (vp->dataBox.Ymin + vp->dataBox.Ymax) * 0.5;
+
+    vp->viewCP.X = (vp->viewBox.Xmin + vp->viewBox.Xmax) * 0.5;
+    vp->viewCP.Y = (vp->viewBox.Ymin + vp->viewBox.Ymax) * 0.5;
+
+    vp->XScale = (vp->viewBox.Xmax - vp->viewBox.Xmin) / (vp->dataBox.Xmax - vp->dataBox.Xmin);
+
+    vp->MinScale = vp->XScale;
+    vp->MaxScale = vp->XScale;
+}
+
+
 /**
  * @brief Set the view port when view's size changed, such as: WM_ONSIZE
  *   (Xmin, Ymin, Xmax, Ymax) is Box of view
@@ -279,6 +305,19 @@ static void DataToViewPoints(const Viewport2D *vp, const CGPoint2D *datas, CGPoi
 }
 
 
+/**
+ * data XY to view point on integer grid of 1/grid dot (grid > 0), that is
+ *   view X = Vq->X / grid. points in the same grid cell compare equal
+ *   with integers and snap to the same view point on any platform.
+ */
+STATIC_INLINE void DataToViewGridXY(const Viewport2D *vp, double Dx, double Dy, int grid, CGPoint2L *Vq)
+{
+    double Vx, Vy;
+    DataToViewXY(vp, Dx, Dy, &Vx, &Vy);
+    Vq->X = (int64_t) floor(Vx * grid + 0.5);
+    Vq->Y = (int64_t) floor(Vy * grid + 0.5);
+}
+
 /**
  *
  *      data                  view
@@ -0,0 +1,153 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file drawbands.c
+ * @brief draw one canvas by threads, each on horizontal bands of it.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.2
+ *
+ * @since 2024-10-22 09:16:45
+ * @date 2024-10-22 18:40:17
+ *
+ * @note
+ */
+#include "drawbands.h"
+
+#include <common/memapi.h>
+
+
+typedef struct
+{
+    cairoDrawCtx *CDC;
+
+    int height;
+    int numBands;
+
+    drawBandFunc drawFunc;
+    void *drawArg;
+
+    uatomic_int nextBand;
+    uatomic_int failedCount;
+} drawBandsJob;
+
+
+typedef struct
+{
+    drawBandsJob *job;
+    pthread_t thread;
+    int started;
+
+    // sum of band counters
+    sb8 numSubpixel;
+} drawBandsWorker;
+
+
+static void * drawBandsWorkerRun(void *arg)
+{
+    int band, y0, y1;
+    cairoDrawCtx bandCDC;
+
+    drawBandsWorker *worker = (drawBandsWorker *) arg;
+    drawBandsJob *job = worker->job;
+
+    while ((band = uatomic_int_add(&job->nextBand) - 1) < job->numBands) {
+        y0 = (int) ((sb8) job->height * band / job->numBands);
+        y1 = (int) ((sb8) job->height * (band + 1) / job->numBands);
+
+        if (cairoDrawCtxInitBand(job->CDC, y0, y1, DRAWBANDS_MARGIN, &bandCDC) != 0) {
+            uatomic_int_add(&job->failedCount);
+            continue;
+        }
+
+        if (job->drawFunc(&bandCDC, job->drawArg) != 0) {
+            uatomic_int_add(&job->failedCount);
+        }
+
+        worker->numSubpixel += bandCDC.numSubpixel;
+
+        cairoDrawCtxFinal(&bandCDC);
+    }
+
+    return 0;
+}
+
+
+int drawBandsRun(cairoDrawCtx *CDC, int numThreads, drawBandFunc drawFunc, void *drawArg)
+{
+    int i;
+    drawBandsJob job;
+    drawBandsWorker *workers;
+
+    bzero(&job, sizeof(job));
+
+    numThreads = CG_MAX(1, CG_MIN(numThreads, DRAWBANDS_THREADS_MAX));
+
+    job.CDC = CDC;
+    job.height = cairo_image_surface_get_height(CDC->surface);
+    job.numBands = CG_MAX(1, CG_MIN(numThreads * DRAWBANDS_PER_THREAD, job.height / DRAWBANDS_ROWS_MIN));
+    job.drawFunc = drawFunc;
+    job.drawArg = drawArg;
+
+    uatomic_int_zero(&job.nextBand);
+    uatomic_int_zero(&job.failedCount);
+
+    // pending drawing must be in pixels before bands share them
+    cairo_surface_flush(CDC->surface);
+
+    workers = (drawBandsWorker *) mem_alloc_zero(numThreads, sizeof(drawBandsWorker));
+
+    for (i = 1; i < numThreads; i++) {
+        workers[i].job = &job;
+        if (pthread_create(&workers[i].thread, 0, drawBandsWorkerRun, &workers[i]) != 0) {
+            // remaining bands are drawn by running threads
+            printf("Warn: pthread_create() failed\n");
+            break;
+        }
+        workers[i].started = 1;
+    }
+
+    workers[0].job = &job;
+    drawBandsWorkerRun(&workers[0]);
+
+    for (i = 1; i < numThreads; i++) {
+        if (workers[i].started) {
+            pthread_join(workers[i].thread, 0);
+        }
+    }
+
+    for (i = 0; i < numThreads; i++) {
+        CDC->numSubpixel += workers[i].numSubpixel;
+    }
+
+    mem_free(workers);
+
+    cairo_surface_mark_dirty(CDC->surface);
+
+    if (uatomic_int_get(&job.failedCount)) {
+        printf("Error: %d of %d bands failed\n", (int) uatomic_int_get(&job.failedCount), job.numBands);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file drawbands.h
+ * @brief draw one canvas by threads, each on horizontal bands of it.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.3
+ *
+ * @since 2024-10-22 09:16:45
+ * @date 2024-10-24 15:20:00
+ *
+ * @note
+ *   Every band is a cairo surface over its own rows of the pixel buffer of
+ *   canvas, so bands are drawn without locks and nothing is copied. Shapes
+ *   are drawn in the same order with the same transform as on the whole
+ *   canvas, and paths of batch mode hold fixed blocks of records, so a band
+ *   has the same pixels as the single-threaded render. Sub-pixel features
+ *   are counted only by the band of their center.
+ *
+ *   There are more bands than threads: threads claim next band when done,
+ *   so dense bands do not leave other threads idle.
+ *
+ *   drawFunc is called concurrently and must only read shared state. Shape
+ *   files are opened by shapeLayerDraw under the layer lock (see also
+ *   shapeLayerPrepare), and must not be read by SHPReadObjectEx on a shared
+ *   SHPHandle.
+ */
+#ifndef DRAW_BANDS_H__
+#define DRAW_BANDS_H__
+
+#ifdef    __cplusplus
+extern "C" {
+#endif
+
+#include "cairodrawctx.h"
+
+#include <common/uatomic.h>
+
+#include <pthread.h>
+
+
+#define DRAWBANDS_THREADS_MAX    64
+
+// bands per thread for balancing
+#define DRAWBANDS_PER_THREAD     4
+
+// min rows of a band
+#define DRAWBANDS_ROWS_MIN       32
+
+// shapes this close to band in pixels are drawn by it (half of widest stroke)
+#define DRAWBANDS_MARGIN         16
+
+
+/**
+ * draw everything into bandCDC. returns 0 on success.
+ */
+typedef int (*drawBandFunc)(cairoDrawCtx *bandCDC, void *drawArg);
+
+
+/**
+ * draw CDC by numThreads threads (calling thread is one of them).
+ * returns 0 on success, -1 if any band failed.
+ */
+extern int drawBandsRun(cairoDrawCtx *CDC, int numThreads, drawBandFunc drawFunc, void *drawArg);
+
+#ifdef    __cplusplus
+}
+#endif
+#endif /* DRAW_BANDS_H__ */
@@ -26,10 +26,10 @@
  *
  * @author mapaware@hotmail.com
  * @copyright © 2024-2030 mapaware.top All Rights Reserved.
- * @version 0.0.2
+ * @version 0.0.13
  *
  * @since 2024-10-16 22:31:46
- * @date 2024-10-17 03:47:05
+ * @date 2024-10-24 09:18:27
  *
  * @note
  *   https://github.com/pepstack/shapefile
@@ -37,50 +37,164 @@
  */
 #include "shapetool-common.h"
 #include "drawlayers.h"
+#include "drawbands.h"
 
 
-int maplayers2png(shapetool_flags *flags, shapetool_options *options)
+#define MAPLAYERS_MAX   1024
+
+
+typedef struct
 {
-    const char* CfgFile = CSTR_FILE_URI_PATH(options->layerscfg);
+    shapeLayer *layers;
+    int numLayers;
+} maplayersBandArg;
 
-    // 读环境变量
-    ConfVariables env = { 0 };
-    int number = ConfReadSectionVariables(CfgFile, "environments", &env);
-    if (number > 0) {
-        for (int i = 0; i < number; i++) {
-            printf("<%.*s> : {%.*s}\n", env.keylens[i], env.keys[i], env.valuelens[i], env.values[i]);
+
+static int maplayersDrawBand(cairoDrawCtx *bandCDC, void *drawArg)
+{
+    int j;
+    maplayersBandArg *arg = (maplayersBandArg *) drawArg;
+
+    for (j = 0; j < arg->numLayers; j++) {
+        shapeLayerDraw(&arg->layers[j], bandCDC);
+    }
+    return 0;
+}
+
+
+int maplayersBounds(const shapeLayer *layers, int numLayers, CGBox2D *dataBox)
+{
+    int j, numBounds = 0;
+
+    bzero(dataBox, sizeof(CGBox2D));
+
+    for (j = 0; j < numLayers; j++) {
+        if (layers[j].nEntities > 0) {
+            if (numBounds++ == 0) {
+                *dataBox = layers[j].bounds;
+            } else {
+                dataBox->Xmin = CG_MIN(dataBox->Xmin, layers[j].bounds.Xmin);
+                dataBox->Ymin = CG_MIN(dataBox->Ymin, layers[j].bounds.Ymin);
+                dataBox->Xmax = CG_MAX(dataBox->Xmax, layers[j].bounds.Xmax);
+                dataBox->Ymax = CG_MAX(dataBox->Ymax, layers[j].bounds.Ymax);
+            }
+        }
+    }
+
+    return numBounds;
+}
+
+
+/**
+ * draw opened layers of map into png
+ */
+static int maplayersDrawPng(shapeLayer *layers, int numLayers, shapetool_options *options)
+{
+    int j;
+    cairoDrawCtx CDC;
+    cairo_status_t status;
+
+    CGBox2D dataBox;
+    CGSize2D viewSize = {
+        .W = options->width,
+        .H = options->height
+    };
+
+    maplayersBounds(layers, numLayers, &dataBox);
+
+    if (cairoDrawCtxInit(&CDC, dataBox, viewSize, dot_logical_px, (float)options->dpi, (cairoDrawQuality) options->quality)) {
+        return SHAPETOOL_RES_ERR;
+    }
+
+    CDC.batchMode = options->batch;
+    if (options->simplifypx >= 0) {
+        // else by quality
+        CDC.simplifyPx = options->simplifypx;
+    }
+    CDC.snapGrid = options->snap;
+    CDC.subpixelMode = (cairoSubpixelMode) options->subpixel;
+    CDC.subpixelPx = options->subpixelpx;
+
+    // layers are drawn in order of map: first at bottom
+    if (options->threads > 1) {
+        maplayersBandArg bandArg = { layers, numLayers };
+
+        for (j = 0; j < numLayers; j++) {
+            shapeLayerPrepare(&layers[j], &CDC.viewport);
+        }
+
+        if (drawBandsRun(&CDC, options->threads, maplayersDrawBand, &bandArg) != 0) {
+            printf("Error: failed to draw bands\n");
+        }
+    } else {
+        for (j = 0; j < numLayers; j++) {
+            shapeLayerDraw(&layers[j], &CDC);
         }
     }
 
+    if (CDC.numSubpixel > 0) {
+        printf("Info: %" PRId64 " sub-pixel features elided\n", CDC.numSubpixel);
+    }
+
+    status = cairoDrawCtxOutputPng(&CDC, 0, CSTR_FILE_URI_PATH(options->outpng));
+
+    // crops of the same canvas, never drawn again
+    for (int i = 0; i < options->numoutbox && status == CAIRO_STATUS_SUCCESS; i++) {
+        status = cairoDrawCtxOutputPng(&CDC, &options->outbox[i], CSTR_FILE_URI_PATH(options->outboxpng[i]));
+    }
+
+    cairoDrawCtxFinal(&CDC);
+
+    return (status == CAIRO_STATUS_SUCCESS ? SHAPETOOL_RES_SOK : SHAPETOOL_RES_ERR);
+}
+
+
+int maplayersOpen(const char *cfgFile, const char *mapid, int mapidlen, const shapeReadOpts *readOpts, shapeLayer **layers)
+{
+    shapeLayer *mapLayers = 0;
+    int numLayers = 0;
+
     // 读 [map:MAPID]
     void* sections = 0;
-    int secs = ConfGetSectionList(CfgFile, &sections);
+    int secs = ConfGetSectionList(cfgFile, &sections);
     if (secs > 0) {
         char buffer[READCONF_MAX_LINESIZE];
 
-        for (int i = 0; i < secs; ++i) {
+        for (int i = 0; i < secs && !mapLayers; ++i) {
             char* sec, * family, * qualifier;
 
             sec = ConfSectionListGetAt(sections, i);
             if (ConfSectionParse(sec, &family, &qualifier) == 2) {
-                if (!cstr_compare_len(family, -1, "map", 3, 0) && !cstr_compare_len(qualifier, -1, options->mapid->str, options->mapid->len, 0)) {
+                if (!cstr_compare_len(family, -1, "map", 3, 0) && !cstr_compare_len(qualifier, -1, mapid, mapidlen, 0)) {
                     printf("[%s:%s]\n", family, qualifier);
 
-                    int buflen = ConfReadValueParsed(CfgFile, "map", options->mapid->str, "layers", buffer, sizeof(buffer));
+                    int buflen = ConfReadValueParsed(cfgFile, "map", mapid, "layers", buffer, sizeof(buffer));
 
                     printf("layers={%.*s}\n", buflen, buffer);
 
                     // 最多 1024 个图层
-                    char *layerid[1024];
-                    int idlens[1024];
+                    char *layerid[MAPLAYERS_MAX];
+                    int idlens[MAPLAYERS_MAX];
                     int layers = cstr_slpit_chr(buffer, buflen, 32, layerid, idlens, sizeof(idlens)/sizeof(idlens[0]));
                     if (layers > 0) {
+                        mapLayers = (shapeLayer *) mem_alloc_zero(layers, sizeof(shapeLayer));
+
                         for (int j = 0; j < layers; j++) {
                             printf("[layer:%.*s]\n", idlens[j], layerid[j]);
 
-                            int valuelen = ConfReadValueParsed2(CfgFile, "layer", layerid[j], idlens[j], "file", buffer, sizeof(buffer));
+                            int valuelen = ConfReadValueParsed2(cfgFile, "layer", layerid[j], idlens[j], "file", buffer, sizeof(buffer));
                             printf("file=%.*s\n", valuelen, buffer);
 
+                            if (valuelen > 0 && valuelen < (int) sizeof(buffer)) {
+                                // file=/dir/a.shp, /dir/a_*.shp or manifest of shards
+                                buffer[valuelen] = '\0';
+                                if (shapeLayerOpen(&mapLayers[numLayers], buffer, readOpts) == 0) {
+                                    numLayers++;
+                                }
+                            } else {
+                                printf("Warn: no file for layer: %.*s\n", idlens[j], layerid[j]);
+                            }
+
                             mem_free(layerid[j]);
                         }
                     }
@@ -91,6 +205,71 @@ int maplayers2png(shapetool_flags *flags, shapetool_options *options)
     }
 
     ConfSectionListFree(sections);
+
+    *layers = mapLayers;
+    return numLayers;
+}
+
+
+void maplayersClose(shapeLayer *layers, int numLayers)
+{
+    for (int j = 0; j < numLayers; j++) {
+        shapeLayerClose(&layers[j]);
+    }
+    if (layers) {
+        mem_free(layers);
+    }
+}
+
+
+int maplayers2png(shapetool_flags *flags, shapetool_options *options)
+{
+    int ret = SHAPETOOL_RES_ERR;
+
+    const char* CfgFile = CSTR_FILE_URI_PATH(options->layerscfg);
+
+    shapeReadOpts readOpts = {
+        .readMode = (shapeReadMode) options->readmode,
+        .readAhead = options->readahead,
+        .decoders = options->decoders,
+        .geomCache = 0,
+        // positioned reads can be shared by threads, SHPReadObjectEx cannot
+        .xyOnly = (options->xyonly || options->threads > 1)
+    };
+
+    shapeLayer *mapLayers = 0;
+    int numLayers = 0;
+
+    // 读环境变量
+    ConfVariables env = { 0 };
+    int number = ConfReadSectionVariables(CfgFile, "environments", &env);
+    if (number > 0) {
+        for (int i = 0; i < number; i++) {
+            printf("<%.*s> : {%.*s}\n", env.keylens[i], env.keys[i], env.valuelens[i], env.values[i]);
+        }
+    }
+
+    numLayers = maplayersOpen(CfgFile, options->mapid->str, options->mapid->len, &readOpts, &mapLayers);
+
+    if (numLayers > 0) {
+        if (options->geomcache > 0) {
+            readOpts.geomCache = shpGeomCacheCreate((size_t) options->geomcache * 1024 * 1024);
+            for (int j = 0; j < numLayers; j++) {
+                mapLayers[j].readOpts.geomCache = readOpts.geomCache;
+            }
+        }
+        ret = maplayersDrawPng(mapLayers, numLayers, options);
+    } else {
+        printf("Error: no layer to draw for map: %.*s\n", options->mapid->len, options->mapid->str);
+    }
+
+    maplayersClose(mapLayers, numLayers);
+
+    if (readOpts.geomCache) {
+        shpGeomCachePrintStats(readOpts.geomCache);
+        shpGeomCacheDestroy(readOpts.geomCache);
+    }
+
     ConfVariablesClear(&env);
-    return SHAPETOOL_RES_ERR;
-}
\ No newline at end of file
+    return ret;
+}
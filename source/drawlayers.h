@@ -26,10 +26,10 @@
  *
  * @author mapaware@hotmail.com
  * @copyright © 2024-2030 mapaware.top All Rights Reserved.
- * @version 0.0.2
+ * @version 0.0.4
  *
  * @since 2024-10-16 22:34:10
- * @date 2024-10-16 22:54:39
+ * @date 2024-10-23 11:47:03
  *
  * @note
  */
@@ -44,10 +44,22 @@ extern "C" {
 
 #include "drawshape.h"
 
+#include "shapelayer.h"
 
 
+/**
+ * open layers listed by [map:MAPID] of config file, in order of map.
+ *   *layers must be released by maplayersClose().
+ * returns number of layers opened.
+ */
+extern int maplayersOpen(const char *cfgFile, const char *mapid, int mapidlen, const shapeReadOpts *readOpts, shapeLayer **layers);
 
+extern void maplayersClose(shapeLayer *layers, int numLayers);
 
+/**
+ * merged extent of layers which are not empty. returns number of them.
+ */
+extern int maplayersBounds(const shapeLayer *layers, int numLayers, CGBox2D *dataBox);
 
 
 #ifdef    __cplusplus
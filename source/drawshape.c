@@ -26,10 +26,10 @@
  *
  * @author mapaware@hotmail.com
  * @copyright © 2024-2030 mapaware.top All Rights Reserved.
- * @version 0.0.9
+ * @version 0.0.31
  *
  * @since 2024-10-15 01:33:13
- * @date 2024-10-17 03:02:02
+ * @date 2024-10-24 15:35:00
  *
  * @note
  *   https://github.com/pepstack/shapefile
@@ -37,16 +37,51 @@
  */
 #include "shapetool-common.h"
 #include "drawshape.h"
+#include "shapelayer.h"
+#include "drawbands.h"
+
+#include <common/cgsimplify.h>
+#include <common/cgclip.h>
+
+
+typedef struct
+{
+    double red;
+    double green;
+    double blue;
+} drawColorRGB;
+
+// fill and stroke of shapes until colors of styles are applied. sub-pixel
+//   dots are painted with the same colors.
+static const drawColorRGB drawFillColor = { 1.0, 0.0, 1.0 };
+static const drawColorRGB drawStrokeColor = { 0.0, 1.0, 1.0 };
+
+
+static int shapeLayerDrawBand(cairoDrawCtx *bandCDC, void *drawArg)
+{
+    shapeLayerDraw((shapeLayer *) drawArg, bandCDC);
+    return 0;
+}
 
 
 int shpfile2png(shapetool_flags *flags, shapetool_options *options)
 {
-    shapeFileInfo shpInfo;
+    shapeLayer layer;
     cairoDrawCtx CDC;
     cairo_status_t status;
 
-    // load shp file: file:///path/to/some.shp
-    if (shapeFileInfoOpen(&shpInfo, CSTR_FILE_URI_PATH(options->shpfile)) != 0) {
+    shapeReadOpts readOpts = {
+        .readMode = (shapeReadMode) options->readmode,
+        .readAhead = options->readahead,
+        .decoders = options->decoders,
+        // shapes are drawn once, so geometry cache never hits
+        .geomCache = 0,
+        // positioned reads can be shared by threads, SHPReadObjectEx cannot
+        .xyOnly = (options->xyonly || options->threads > 1)
+    };
+
+    // load shp file: file:///path/to/some.shp, file:///path/to/some_*.shp or manifest
+    if (shapeLayerOpen(&layer, CSTR_FILE_URI_PATH(options->shpfile), &readOpts) != 0) {
         return SHAPETOOL_RES_ERR;
     }
 
@@ -55,13 +90,13 @@ int shpfile2png(shapetool_flags *flags, shapetool_options *options)
         // if css file provided, check css class
         if (!flags->styleclass) {
             // if not class given , set default class name by type of shape
-            if (shpInfo.nShpTypeMask == SHAPE_TYPE_POLYGON) {
+            if (layer.nShpTypeMask == SHAPE_TYPE_POLYGON) {
                 options->styleclass = cstrbufDup(options->styleclass, ".polygon", 8);
             }
-            else if (shpInfo.nShpTypeMask == SHAPE_TYPE_LINE) {
+            else if (layer.nShpTypeMask == SHAPE_TYPE_LINE) {
                 options->styleclass = cstrbufDup(options->styleclass, ".line", 5);
             }
-            else if (shpInfo.nShpTypeMask == SHAPE_TYPE_POINT) {
+            else if (layer.nShpTypeMask == SHAPE_TYPE_POINT) {
                 options->styleclass = cstrbufDup(options->styleclass, ".point", 6);
             }
             flags->styleclass = 1;
@@ -69,19 +104,14 @@ int shpfile2png(shapetool_flags *flags, shapetool_options *options)
     }
 
     // create cairo draw context
-    CGBox2D dataBox = {
-        .Xmin = shpInfo.minBounds[0],
-        .Ymin = shpInfo.minBounds[1],
-        .Xmax = shpInfo.maxBounds[0],
-        .Ymax = shpInfo.maxBounds[1]
-    };
+    CGBox2D dataBox = layer.bounds;
     CGSize2D viewSize = {
         .W = options->width,
         .H = options->height
     };
 
-    if (cairoDrawCtxInit(&CDC, dataBox, viewSize, dot_logical_px, (float)options->dpi)) {
-        shapeFileInfoClose(&shpInfo);
+    if (cairoDrawCtxInit(&CDC, dataBox, viewSize, dot_logical_px, (float)options->dpi, (cairoDrawQuality) options->quality)) {
+        shapeLayerClose(&layer);
         exit(1);
     }
 
@@ -90,14 +120,40 @@ int shpfile2png(shapetool_flags *flags, shapetool_options *options)
         cairoDrawCtxSetStyle(&CDC, options->cssStyleKeys, options->styleclass);
     }
 
+    CDC.batchMode = options->batch;
+    if (options->simplifypx >= 0) {
+        // else by quality
+        CDC.simplifyPx = options->simplifypx;
+    }
+    CDC.snapGrid = options->snap;
+    CDC.subpixelMode = (cairoSubpixelMode) options->subpixel;
+    CDC.subpixelPx = options->subpixelpx;
+
     // draw shapes onto cairo
-    shapeFileInfoDraw(&shpInfo, &CDC);
+    if (options->threads > 1) {
+        shapeLayerPrepare(&layer, &CDC.viewport);
+
+        if (drawBandsRun(&CDC, options->threads, shapeLayerDrawBand, &layer) != 0) {
+            printf("Error: failed to draw bands\n");
+        }
+    } else {
+        shapeLayerDraw(&layer, &CDC);
+    }
+
+    if (CDC.numSubpixel > 0) {
+        printf("Info: %" PRId64 " sub-pixel features elided\n", CDC.numSubpixel);
+    }
 
     status = cairoDrawCtxOutputPng(&CDC, 0, CSTR_FILE_URI_PATH(options->outpng));
 
+    // crops of the same canvas, never drawn again
+    for (int i = 0; i < options->numoutbox && status == CAIRO_STATUS_SUCCESS; i++) {
+        status = cairoDrawCtxOutputPng(&CDC, &options->outbox[i], CSTR_FILE_URI_PATH(options->outboxpng[i]));
+    }
+
     cairoDrawCtxFinal(&CDC);
 
-    shapeFileInfoClose(&shpInfo);
+    shapeLayerClose(&layer);
 
     if (status != CAIRO_STATUS_SUCCESS) {
         return SHAPETOOL_RES_ERR;
@@ -107,77 +163,435 @@ int shpfile2png(shapetool_flags *flags, shapetool_options *options)
 }
 
 
-void drawPolygonShape(const SHPObjectEx* hShpRef, cairoDrawCtx* cdc)
-{
-    int i, part, cnt;
-    double X0, Y0, X, Y;
+// region r (0-2) of cdc->viewPoints, each has 2 * viewPointsCapacity points
+#define DRAW_VIEW_REGION(cdc, r)  ((cdc)->viewPoints + (size_t) (r) * 2 * (cdc)->viewPointsCapacity)
 
-    SHPPointType* points, * ppt;
 
-    cairo_t* cr = cdc->cr;
-    Viewport2D* vwp = &(cdc->viewport);
+/**
+ * view points of a part into region 0 of cdc->viewPoints and their bounds.
+ *   points within 0.5 dot of the previous are dropped, the last point is
+ *   always kept. with snapGrid set, points are snapped to the grid instead
+ *   and dropped if in the same grid cell as the previous.
+ * returns number of view points.
+ */
+static int drawPartViewPoints(cairoDrawCtx* cdc, const shapeGeomPoint SHAPEGEOM_UNALIGNED* points, int npp, CGBox2D* bounds)
+{
+    int i, num;
+    double X, Y;
+    CGPoint2D* vpts;
 
-    ///CssPolygonStyle * polygon = &cdc->polygonStyle;
+    // clipping may add points
+    if (npp + 8 > cdc->viewPointsCapacity) {
+        int capacity = CG_MAX(npp + 8, 1024);
 
-    cairo_save(cr);
+        // nothing to keep
+        mem_free(cdc->viewPoints);
+        mem_free(cdc->viewStack);
 
-    for (part = 0; part < hShpRef->nParts; part++) {
-        /* start index of points of current part */
-        int start = hShpRef->panPartStart[part];
+        cdc->viewPoints = (CGPoint2D*) mem_alloc_unset(sizeof(CGPoint2D) * 6 * capacity);
+        cdc->viewStack = (int*) mem_alloc_unset(sizeof(int) * 4 * capacity);
+        cdc->viewPointsCapacity = capacity;
+    }
 
-        /* type of current part */
-        int parttype = hShpRef->panPartType[part];
+    vpts = DRAW_VIEW_REGION(cdc, 0);
 
-        /* number of points of part */
-        int npp = hShpRef->panPartStart[part + 1] - start;
+    if (cdc->snapGrid > 0) {
+        CGPoint2L q0, q;
+        const int grid = cdc->snapGrid;
 
-        if (npp > 0) {
-            points = &hShpRef->pPoints[start];
+        DataToViewGridXY(&cdc->viewport, points[0].x, points[0].y, grid, &q0);
+        vpts[0].X = (double) q0.X / grid;
+        vpts[0].Y = (double) q0.Y / grid;
+        num = 1;
 
-            if (part == 0) {
-                /* first part as contour path */
-                cairo_new_path(cr);
+        for (i = 1; i < npp; i++) {
+            DataToViewGridXY(&cdc->viewport, points[i].x, points[i].y, grid, &q);
+
+            // a line in one cell still ends at its last point
+            if (q.X != q0.X || q.Y != q0.Y || (i == npp - 1 && num == 1)) {
+                vpts[num].X = (double) q.X / grid;
+                vpts[num].Y = (double) q.Y / grid;
+                num++;
+                q0 = q;
             }
-            else {
-                /* hole path */
-                cairo_new_sub_path(cr);
+        }
+    } else {
+        DataToViewXY(&cdc->viewport, points[0].x, points[0].y, &vpts[0].X, &vpts[0].Y);
+        num = 1;
+
+        for (i = 1; i < npp; i++) {
+            DataToViewXY(&cdc->viewport, points[i].x, points[i].y, &X, &Y);
+
+            if (CGPointNotEqual(X, Y, vpts[num - 1].X, vpts[num - 1].Y, 0.5)) {
+                vpts[num].X = X;
+                vpts[num].Y = Y;
+                num++;
+            } else if (i == npp - 1 && num > 1) {
+                // last point replaces the previous one nearby
+                vpts[num - 1].X = X;
+                vpts[num - 1].Y = Y;
+            } else if (i == npp - 1) {
+                vpts[num].X = X;
+                vpts[num].Y = Y;
+                num++;
             }
+        }
+    }
+
+    bounds->Xmin = bounds->Xmax = vpts[0].X;
+    bounds->Ymin = bounds->Ymax = vpts[0].Y;
+
+    for (i = 1; i < num; i++) {
+        bounds->Xmin = CG_MIN(bounds->Xmin, vpts[i].X);
+        bounds->Xmax = CG_MAX(bounds->Xmax, vpts[i].X);
+        bounds->Ymin = CG_MIN(bounds->Ymin, vpts[i].Y);
+        bounds->Ymax = CG_MAX(bounds->Ymax, vpts[i].Y);
+    }
+
+    return num;
+}
+
+
+/**
+ * reduce view points by radial distance and Douglas-Peucker with tolerance
+ *   of cdc, into outPts (may be pts). first and last point are kept, so
+ *   that a closed ring stays closed. tmpPts is distinct from both.
+ * returns number of points in outPts.
+ */
+static int drawSimplifyPoints(cairoDrawCtx* cdc, const CGPoint2D* pts, int num, CGPoint2D* tmpPts, CGPoint2D* outPts)
+{
+    if (cdc->simplifyPx > 0 && num > 2) {
+        num = CGSimplifyRadialDistance(pts, num, cdc->simplifyPx, tmpPts);
+        return CGSimplifyDouglasPeucker(tmpPts, num, cdc->simplifyPx, outPts, cdc->viewStack);
+    }
+
+    if (outPts != pts) {
+        memcpy(outPts, pts, sizeof(CGPoint2D) * num);
+    }
+    return num;
+}
+
+
+/**
+ * view box of cdc inflated by line width: paths are clipped to it, so
+ *   that neither fill nor stroke changes inside view box.
+ */
+static void drawClipBox(const cairoDrawCtx* cdc, CGBox2D* clipBox)
+{
+    double margin = cairo_get_line_width(cdc->cr) + 1;
+
+    *clipBox = cdc->viewport.viewBox;
+    CGBoxInflate((*clipBox), margin);
+}
+
+
+/**
+ * add view points to current path of cr
+ */
+static void drawPartPath(cairo_t* cr, const CGPoint2D* vpts, int num)
+{
+    int i;
 
-            i = cnt = 0;
-            ppt = &points[i++];
+    cairo_move_to(cr, vpts[0].X, vpts[0].Y);
 
-            DataToViewXY(vwp, ppt->x, ppt->y, &X0, &Y0);
+    for (i = 1; i < num; i++) {
+        cairo_line_to(cr, vpts[i].X, vpts[i].Y);
+    }
+}
+
+
+/**
+ * add rings of polygon to current path of cr. returns number of parts.
+ *   rings are simplified as a whole before they are clipped to clip box,
+ *   so that a ring looks the same in every band or tile it crosses.
+ *   rings outside of clip box are dropped.
+ *   a ring simplified to less than 4 points has no area: it is dropped,
+ *   unless it is the first ring which is then drawn without simplifying,
+ *   so that a feature smaller than tolerance is still visible.
+ */
+static int drawPolygonPath(const shapeGeomView* geomView, cairoDrawCtx* cdc)
+{
+    int part, num, numOut;
+    CGBox2D bounds, clipBox;
+    CGPoint2D *vpts, *tmpPts, *outPts, *swapPts;
 
-            cairo_move_to(cr, X0, Y0);
+    drawClipBox(cdc, &clipBox);
 
-            while (i < npp) {
-                ppt = &points[i++];
+    for (part = 0; part < geomView->nParts; part++) {
+        /* start index of points of current part */
+        int start = geomView->panPartStart[part];
 
-                DataToViewXY(vwp, ppt->x, ppt->y, &X, &Y);
+        /* number of points of part */
+        int npp = ShapeGeomPartEnd(geomView, part) - start;
+
+        if (npp > 0 && start >= 0 && start + npp <= geomView->nPoints) {
+            num = drawPartViewPoints(cdc, &geomView->pPoints[start], npp, &bounds);
+
+            if (! CGBoxIsOverlap(clipBox, bounds)) {
+                // no fill nor stroke in view box
+                continue;
+            }
+
+            // regions not used by points in vpts
+            vpts = DRAW_VIEW_REGION(cdc, 0);
+            tmpPts = DRAW_VIEW_REGION(cdc, 1);
+            outPts = DRAW_VIEW_REGION(cdc, 2);
+
+            if (cdc->simplifyPx > 0) {
+                numOut = drawSimplifyPoints(cdc, vpts, num, tmpPts, outPts);
+
+                if (numOut >= 4) {
+                    swapPts = vpts;
+                    vpts = outPts;
+                    outPts = swapPts;
+                    num = numOut;
+                } else if (part > 0) {
+                    continue;
+                }
+            }
 
-                if (CGPointNotEqual(X, Y, X0, Y0, 0.5)) {
-                    cairo_line_to(cr, X, Y);
-                    X0 = X;
-                    Y0 = Y;
+            // simplified ring is inside of bounds
+            if (! CGBoxContains(clipBox, bounds)) {
+                numOut = CGClipRingToBox(vpts, num, &clipBox, tmpPts, outPts, 2 * cdc->viewPointsCapacity);
+                if (numOut == 0) {
+                    // clip box is outside of ring
+                    continue;
+                }
+                if (numOut > 0) {
+                    vpts = tmpPts;
+                    num = numOut;
                 }
             }
 
-            cairo_close_path(cr);
+            /* contour or hole path */
+            cairo_new_sub_path(cdc->cr);
+
+            drawPartPath(cdc->cr, vpts, num);
+
+            cairo_close_path(cdc->cr);
         }
         else {
             // empty path
         }
     }
 
-    if (part) {
-        // success returns 0
-        /// cairo_set_source_rgb(cr, polygon->fill_color.red, polygon->fill_color.green, polygon->fill_color.blue);
-        cairo_set_source_rgb(cr, 128, 0, 128);
-        cairo_fill_preserve(cr);
+    return part;
+}
+
+
+/**
+ * fill and stroke current path of cr
+ */
+static void drawPolygonPaint(cairo_t* cr, const CssDrawStyle* style)
+{
+    /// cairo_set_source_rgb(cr, style->fill_color.red, style->fill_color.green, style->fill_color.blue);
+    cairo_set_source_rgb(cr, drawFillColor.red, drawFillColor.green, drawFillColor.blue);
+    cairo_fill_preserve(cr);
+
+    ///cairo_set_source_rgb(cr, style->border_color.red, style->border_color.green, style->border_color.blue);
+    cairo_set_source_rgb(cr, drawStrokeColor.red, drawStrokeColor.green, drawStrokeColor.blue);
+    cairo_stroke(cr);
+}
+
+
+/**
+ * stroke current path of cr
+ */
+static void drawPolylinePaint(cairo_t* cr, const CssDrawStyle* style)
+{
+    ///cairo_set_source_rgb(cr, style->border_color.red, style->border_color.green, style->border_color.blue);
+    cairo_set_source_rgb(cr, drawStrokeColor.red, drawStrokeColor.green, drawStrokeColor.blue);
+    cairo_stroke(cr);
+}
+
+
+/**
+ * pre-render marker of points: a filled and stroked circle in the middle
+ *   of an odd sized square, so that its center is a pixel center.
+ */
+static cairo_surface_t* drawPointSpriteCreate(const CssDrawStyle* style)
+{
+    cairo_t* cr;
+    cairo_surface_t* sprite;
+
+    // cairo default line width is 2
+    int size = (CAIRO_DRAW_POINT_RADIUS + 2) * 2 + 1;
+
+    sprite = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+    if (cairo_surface_status(sprite) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(sprite);
+        return 0;
+    }
+
+    cr = cairo_create(sprite);
+    cairo_arc(cr, size * 0.5, size * 0.5, CAIRO_DRAW_POINT_RADIUS, 0, 2 * 3.14159265358979323846);
+    drawPolygonPaint(cr, style);
+    cairo_destroy(cr);
+
+    cairo_surface_flush(sprite);
+    return sprite;
+}
+
+
+/**
+ * premultiplied ARGB32 pixel s OVER d
+ */
+STATIC_INLINE ub4 drawPixelOver(ub4 d, ub4 s)
+{
+    int c;
+    ub4 t, out = 0;
+    ub4 a = s >> 24;
+
+    if (a == 255) {
+        return s;
+    }
+    if (a == 0) {
+        return d;
+    }
+
+    // s + d * (255 - a) / 255 per channel, rounded as pixman
+    for (c = 0; c < 32; c += 8) {
+        t = ((d >> c) & 0xFF) * (255 - a) + 0x80;
+        out |= (((s >> c) & 0xFF) + ((t + (t >> 8)) >> 8)) << c;
+    }
+    return out;
+}
+
+
+/**
+ * composite premultiplied ARGB32 sprite over image at (x0, y0), clipped
+ */
+static void drawSpriteBlit(cairo_surface_t* image, cairo_surface_t* sprite, int x0, int y0)
+{
+    int x, y, xmin, ymin, xmax, ymax;
+
+    unsigned char* dstData = cairo_image_surface_get_data(image);
+    int dstStride = cairo_image_surface_get_stride(image);
+
+    const unsigned char* srcData = cairo_image_surface_get_data(sprite);
+    int srcStride = cairo_image_surface_get_stride(sprite);
+    int size = cairo_image_surface_get_width(sprite);
+
+    xmin = CG_MAX(0, -x0);
+    ymin = CG_MAX(0, -y0);
+    xmax = CG_MIN(size, cairo_image_surface_get_width(image) - x0);
+    ymax = CG_MIN(size, cairo_image_surface_get_height(image) - y0);
+
+    for (y = ymin; y < ymax; y++) {
+        const ub4* src = (const ub4*) (srcData + (size_t) y * srcStride);
+        ub4* dst = (ub4*) (dstData + (size_t) (y0 + y) * dstStride) + x0;
+
+        for (x = xmin; x < xmax; x++) {
+            dst[x] = drawPixelOver(dst[x], src[x]);
+        }
+    }
+}
+
+
+/**
+ * flush pending path if style, shape type or block of records changes,
+ *   then start a new one
+ */
+static void drawBatchBegin(cairoDrawCtx* cdc, int shapeType, int nShapeId)
+{
+    const int block = nShapeId / CAIRO_DRAW_BATCH_MAX;
+
+    if (cdc->batchFeatures > 0 && (cdc->batchShapeType != shapeType || cdc->batchBlock != block ||
+            memcmp(&cdc->batchStyle, &cdc->drawStyles, sizeof(CssDrawStyle)))) {
+        drawBatchFlush(cdc);
+    }
+
+    if (cdc->batchFeatures == 0) {
+        cdc->batchShapeType = shapeType;
+        cdc->batchBlock = block;
+        cdc->batchStyle = cdc->drawStyles;
+        cairo_new_path(cdc->cr);
+
+        if (shapeType == SHAPE_TYPE_POINT) {
+            if (cdc->pointSprite && memcmp(&cdc->pointSpriteStyle, &cdc->batchStyle, sizeof(CssDrawStyle))) {
+                cairo_surface_destroy(cdc->pointSprite);
+                cdc->pointSprite = 0;
+            }
+            if (! cdc->pointSprite) {
+                cdc->pointSprite = drawPointSpriteCreate(&cdc->batchStyle);
+                cdc->pointSpriteStyle = cdc->batchStyle;
+            }
+
+            // points are blitted into pixels until flushed
+            cairo_surface_flush(cairo_get_target(cdc->cr));
+        }
+    }
+}
+
+
+/**
+ * blend pending dots of sub-pixel features over pixels of surface
+ */
+static void drawBatchDots(cairoDrawCtx* cdc)
+{
+    int k;
+    ub4* dst;
+    const cairoDrawDot *dot;
+
+    cairo_surface_t* target = cairo_get_target(cdc->cr);
+    unsigned char* data = cairo_image_surface_get_data(target);
+    int stride = cairo_image_surface_get_stride(target);
+
+    cairo_surface_flush(target);
+
+    for (k = 0; k < cdc->numBatchDots; k++) {
+        dot = &cdc->batchDots[k];
+        dst = (ub4*) (data + (size_t) dot->y * stride) + dot->x;
+        *dst = drawPixelOver(*dst, dot->argb);
+    }
+
+    cairo_surface_mark_dirty(target);
+    cdc->numBatchDots = 0;
+}
+
+
+void drawBatchFlush(cairoDrawCtx* cdc)
+{
+    if (cdc->batchFeatures > 0) {
+        if (cdc->batchShapeType == SHAPE_TYPE_POLYGON) {
+            drawPolygonPaint(cdc->cr, &cdc->batchStyle);
+        } else if (cdc->batchShapeType == SHAPE_TYPE_LINE) {
+            drawPolylinePaint(cdc->cr, &cdc->batchStyle);
+        } else if (cdc->batchShapeType == SHAPE_TYPE_POINT) {
+            cairo_surface_mark_dirty(cairo_get_target(cdc->cr));
+        }
+        cairo_new_path(cdc->cr);
+        cdc->batchFeatures = 0;
+    }
+
+    if (cdc->numBatchDots > 0) {
+        // dots are over features before them in the same batch
+        drawBatchDots(cdc);
+    }
+}
+
+
+void drawPolygonShape(const shapeGeomView* geomView, cairoDrawCtx* cdc)
+{
+    cairo_t* cr = cdc->cr;
+
+    if (cdc->batchMode) {
+        drawBatchBegin(cdc, SHAPE_TYPE_POLYGON, geomView->nShapeId);
+
+        drawPolygonPath(geomView, cdc);
+        cdc->batchFeatures++;
+        return;
+    }
+
+    // lines or points may be pending
+    drawBatchFlush(cdc);
 
-        ///cairo_set_source_rgb(cr, polygon->border_color.red, polygon->border_color.green, polygon->border_color.blue);
-        cairo_set_source_rgb(cr, 0, 160, 35);
-        cairo_stroke(cr);
+    cairo_save(cr);
+
+    cairo_new_path(cr);
+
+    if (drawPolygonPath(geomView, cdc) > 0) {
+        drawPolygonPaint(cr, &cdc->drawStyles);
     }
     else {
         // empty shape
@@ -185,3 +599,190 @@ void drawPolygonShape(const SHPObjectEx* hShpRef, cairoDrawCtx* cdc)
 
     cairo_restore(cr);
 }
+
+
+/**
+ * add a run of line to path
+ */
+static void drawPolylineRun(cairoDrawCtx* cdc, const CGPoint2D* runPts, int num)
+{
+    if (num > 1) {
+        drawPartPath(cdc->cr, runPts, num);
+    }
+}
+
+
+void drawPolylineShape(const shapeGeomView* geomView, cairoDrawCtx* cdc)
+{
+    int i, part, num, numRun;
+    CGBox2D bounds, clipBox;
+    CGPoint2D A, B, *vpts, *runPts, *tmpPts;
+
+    // lines of the same style are always stroked at once
+    drawBatchBegin(cdc, SHAPE_TYPE_LINE, geomView->nShapeId);
+
+    drawClipBox(cdc, &clipBox);
+
+    for (part = 0; part < geomView->nParts; part++) {
+        int start = geomView->panPartStart[part];
+        int npp = ShapeGeomPartEnd(geomView, part) - start;
+
+        if (npp > 1 && start >= 0 && start + npp <= geomView->nPoints) {
+            // last point is always kept so that line ends where it should
+            num = drawPartViewPoints(cdc, &geomView->pPoints[start], npp, &bounds);
+
+            if (! CGBoxIsOverlap(clipBox, bounds)) {
+                continue;
+            }
+
+            vpts = DRAW_VIEW_REGION(cdc, 0);
+            runPts = DRAW_VIEW_REGION(cdc, 1);
+            tmpPts = DRAW_VIEW_REGION(cdc, 2);
+
+            // whole part is simplified before clipping, as polygon rings
+            num = drawSimplifyPoints(cdc, vpts, num, tmpPts, vpts);
+
+            if (CGBoxContains(clipBox, bounds)) {
+                drawPolylineRun(cdc, vpts, num);
+            } else {
+                // a run of line ends where it leaves clip box
+                numRun = 0;
+
+                for (i = 1; i < num; i++) {
+                    A = vpts[i - 1];
+                    B = vpts[i];
+
+                    if (CGClipSegmentToBox(&A, &B, &clipBox)) {
+                        if (numRun > 0 && (A.X != runPts[numRun - 1].X || A.Y != runPts[numRun - 1].Y)) {
+                            drawPolylineRun(cdc, runPts, numRun);
+                            numRun = 0;
+                        }
+                        if (numRun == 0) {
+                            runPts[numRun++] = A;
+                        }
+                        runPts[numRun++] = B;
+                    } else if (numRun > 0) {
+                        drawPolylineRun(cdc, runPts, numRun);
+                        numRun = 0;
+                    }
+                }
+
+                drawPolylineRun(cdc, runPts, numRun);
+            }
+        }
+    }
+
+    cdc->batchFeatures++;
+}
+
+
+void drawPointShape(const shapeGeomView* geomView, cairoDrawCtx* cdc)
+{
+    int k, half;
+    double X, Y, DX = 0, DY = 0;
+
+    cairo_t* cr = cdc->cr;
+    cairo_surface_t* target = cairo_get_target(cr);
+
+    drawBatchBegin(cdc, SHAPE_TYPE_POINT, geomView->nShapeId);
+
+    if (! cdc->pointSprite) {
+        return;
+    }
+
+    half = cairo_image_surface_get_width(cdc->pointSprite) / 2;
+
+    // offset of band surface (only translated)
+    cairo_user_to_device(cr, &DX, &DY);
+
+    for (k = 0; k < geomView->nPoints; k++) {
+        DataToViewXY(&cdc->viewport, geomView->pPoints[k].x, geomView->pPoints[k].y, &X, &Y);
+
+        if (cairo_image_surface_get_data(target)) {
+            // center pixel of sprite onto pixel of point
+            drawSpriteBlit(target, cdc->pointSprite, (int) floor(X + DX) - half, (int) floor(Y + DY) - half);
+        } else {
+            cairo_set_source_surface(cr, cdc->pointSprite, floor(X) - half, floor(Y) - half);
+            cairo_paint(cr);
+        }
+    }
+
+    cdc->batchFeatures++;
+}
+
+
+void drawPolygonCover(cairoDrawCtx* cdc)
+{
+    cairo_t* cr = cdc->cr;
+
+    // border is stroked out of surface
+    double margin = cairo_get_line_width(cr) + 1;
+
+    drawBatchFlush(cdc);
+
+    cairo_new_path(cr);
+    cairo_rectangle(cr, -margin, -margin,
+        cairo_image_surface_get_width(cdc->surface) + margin * 2,
+        cairo_image_surface_get_height(cdc->surface) + margin * 2);
+
+    drawPolygonPaint(cr, &cdc->drawStyles);
+}
+
+
+void drawSubpixelShape(int shapeType, int nShapeId, const CGBox2D* drawRect, cairoDrawCtx* cdc)
+{
+    int x, y;
+    double DX = 0, DY = 0, coverage;
+    ub4 a, r, g, b;
+    const drawColorRGB *color;
+    cairoDrawDot *dot;
+
+    cairo_t* cr = cdc->cr;
+    cairo_surface_t* target = cairo_get_target(cr);
+    unsigned char* data = cairo_image_surface_get_data(target);
+
+    if (shapeType == SHAPE_TYPE_POLYGON) {
+        // fill color, envelope area as coverage
+        coverage = CGBoxGetDX((*drawRect)) * CGBoxGetDY((*drawRect));
+        color = &drawFillColor;
+    } else {
+        // stroke color, envelope diagonal as length of 1 dot wide line
+        coverage = sqrt(CGBoxGetDX((*drawRect)) * CGBoxGetDX((*drawRect)) + CGBoxGetDY((*drawRect)) * CGBoxGetDY((*drawRect)));
+        color = &drawStrokeColor;
+    }
+
+    // as cairo clamps source color to [0, 1]
+    r = (ub4) (CG_MAX(0, CG_MIN(color->red, 1.0)) * 255 + 0.5);
+    g = (ub4) (CG_MAX(0, CG_MIN(color->green, 1.0)) * 255 + 0.5);
+    b = (ub4) (CG_MAX(0, CG_MIN(color->blue, 1.0)) * 255 + 0.5);
+
+    a = (ub4) (CG_MIN(coverage, 1.0) * 255 + 0.5);
+    if (! a || ! data) {
+        return;
+    }
+
+    // offset of band surface (only translated)
+    cairo_user_to_device(cr, &DX, &DY);
+
+    x = (int) floor((drawRect->Xmin + drawRect->Xmax) * 0.5 + DX);
+    y = (int) floor((drawRect->Ymin + drawRect->Ymax) * 0.5 + DY);
+
+    if (x < 0 || y < 0 || x >= cairo_image_surface_get_width(target) || y >= cairo_image_surface_get_height(target)) {
+        return;
+    }
+
+    // dot joins path of features of the same block
+    drawBatchBegin(cdc, shapeType, nShapeId);
+
+    if (cdc->numBatchDots == cdc->batchDotsCapacity) {
+        cdc->batchDotsCapacity = CG_MAX(256, cdc->batchDotsCapacity * 2);
+        cdc->batchDots = (cairoDrawDot*) mem_realloc(cdc->batchDots, sizeof(cairoDrawDot) * cdc->batchDotsCapacity);
+    }
+
+    dot = &cdc->batchDots[cdc->numBatchDots++];
+    dot->x = x;
+    dot->y = y;
+    dot->argb = (a << 24) | ((r * a / 255) << 16) | ((g * a / 255) << 8) | (b * a / 255);
+
+    cdc->batchFeatures++;
+}
@@ -26,10 +26,10 @@
  *
  * @author mapaware@hotmail.com
  * @copyright © 2024-2030 mapaware.top All Rights Reserved.
- * @version 0.0.9
+ * @version 0.0.27
  *
  * @since 2024-10-13 22:24:17
- * @date 2024-10-16 22:41:24
+ * @date 2024-10-24 15:35:00
  *
  * @note
  *   https://github.com/pepstack/shapefile
@@ -52,38 +52,347 @@ extern "C" {
 // draw context
 #include "cairodrawctx.h"
 
+// zero-copy record reader
+#include "shpfilemap.h"
+
+// sidecar spatial index
+#include "shpindex.h"
+
+// envelopes of all records
+#include "shpenvtab.h"
+
+// read-ahead decoder thread
+#include "shpreadahead.h"
+
+// quantized columnar geometry cache
+#include "shpcompact.h"
+
+// LRU cache of decoded geometry
+#include "shpgeomcache.h"
+
+// simplified levels of geometry
+#include "shppyramid.h"
+
+// X/Y only reader of Z/M records
+#include "shpxyreader.h"
+
+
+// shapes probed at most, callers only tell none, one or more
+#define SHAPEFILE_PROBE_MAX     4
+
+
+typedef enum
+{
+    shp_readmode_file = 0,  // SHPReadObjectEx into a reusable SHPObjectEx
+    shp_readmode_mmap = 1   // views into mapped .shp/.shx pages
+} shapeReadMode;
+
+
+typedef struct
+{
+    shapeReadMode readMode;
+
+    // slots of read-ahead ring, 0 for no read-ahead
+    int readAhead;
+
+    // decoding threads, each with its own SHPHandle
+    int decoders;
+
+    // decoded geometry shared by all files, 0 for no cache
+    shpGeomCache *geomCache;
+
+    // never read Z/M of records (2D drawing needs X/Y only)
+    int xyOnly;
+} shapeReadOpts;
+
 
 typedef struct
 {
     SHPHandle hSHP;
     DBFHandle hDBF;
 
+    shapeReadOpts readOpts;
+
+    // shpAddr not null if opened with shp_readmode_mmap
+    shpFileMap fileMap;
+
+    // addr not null if sidecar index (.sti) found
+    shpIndex index;
+
+    // loaded in one pass if no sidecar index
+    shpEnvelopeTable envTable;
+
+    // addr not null if compact geometry (.shpc) found
+    shpcFile compact;
+
+    // addr not null if simplified pyramid (.shpp) found
+    shpPyramid pyramid;
+
+    // shxAddr not null if X/Y only reads (xyOnly and shp_readmode_file)
+    shpXYReader xyReader;
+
     int nEntities;
     int nShapeType;
     int nShpTypeMask;
 
     // Xmin, Ymin, Zmin, Mmin
     double minBounds[4];
-	double maxBounds[4];
+    double maxBounds[4];
 
     int hasZ;
     int hasM;
 
+    // key of geometry cache: (file id, mtime)
+    int cacheFileId;
+    sb8 mtime;
+
     char shapefile[256];
 } shapeFileInfo;
 
 
-void drawPolygonShape(const SHPObjectEx *hShpRef, cairoDrawCtx *cdc);
+typedef struct
+{
+    // buffer of SHPReadObjectEx
+    SHPObjectEx *shpObj;
+
+    // vertices decoded from .shpc or .shpp
+    shpcPointsBuf pointsBuf;
+
+    // part starts and X/Y read by xyReader, or copied out of mapped .shp
+    //   for alignment
+    shpXYReadBuf xyBuf;
+
+    // pyramid level to read, 0 for full resolution
+    int level;
+} shapeReadBuf;
+
+
+void drawPolygonShape(const shapeGeomView *geomView, cairoDrawCtx *cdc);
+
+/**
+ * add lines of shape to pending path, stroked by drawBatchFlush()
+ */
+void drawPolylineShape(const shapeGeomView *geomView, cairoDrawCtx *cdc);
+
+/**
+ * blit pre-rendered marker at every point of shape
+ */
+void drawPointShape(const shapeGeomView *geomView, cairoDrawCtx *cdc);
+
+/**
+ * paint pending path of batch mode, if any
+ */
+void drawBatchFlush(cairoDrawCtx *cdc);
+
+/**
+ * blend one dot for a polygon or line feature smaller than a pixel, given
+ *   its envelope in view. its alpha is the area (polygon) or length (line)
+ *   in pixels the feature would cover. the dot is pending in batch of the
+ *   shape type and blended over the path of it by drawBatchFlush().
+ */
+void drawSubpixelShape(int shapeType, int nShapeId, const CGBox2D *drawRect, cairoDrawCtx *cdc);
+
+/**
+ * paint whole surface as inside of a polygon larger than it, so that its
+ *   border is not seen.
+ */
+void drawPolygonCover(cairoDrawCtx *cdc);
 
 
 static void shapeFileInfoClose(shapeFileInfo *shpInfo)
 {
+    if (shpInfo->index.addr) {
+        shpIndexClose(&shpInfo->index);
+    }
+    if (shpInfo->envTable.Xmin) {
+        shpEnvelopeTableFree(&shpInfo->envTable);
+    }
+    if (shpInfo->fileMap.shpAddr) {
+        shpFileMapClose(&shpInfo->fileMap);
+    }
+    if (shpInfo->compact.addr) {
+        shpcFileClose(&shpInfo->compact);
+    }
+    if (shpInfo->pyramid.addr) {
+        shpPyramidClose(&shpInfo->pyramid);
+    }
+    if (shpInfo->xyReader.shxAddr) {
+        shpXYReaderClose(&shpInfo->xyReader);
+    }
     DBFClose(shpInfo->hDBF);
     SHPClose(shpInfo->hSHP);
 }
 
 
-static int shapeFileInfoOpen(shapeFileInfo *shpInfo, const char *shapefile)
+/**
+ * open a sidecar file into shpInfo and tell its records and shp type
+ *   (shp type of shpInfo if sidecar has none). returns 0 on success.
+ */
+typedef int (*shapeSidecarOpenFunc)(shapeFileInfo *shpInfo, const char *sidecarfile, int *nEntities, int *nShapeType);
+
+typedef void (*shapeSidecarCloseFunc)(shapeFileInfo *shpInfo);
+
+
+/**
+ * open sidecar (a.shp => a.sti, a.shpc, a.shpp) by openFunc if it exists,
+ *   is up to date and matches shp file
+ */
+static void shapeFileInfoOpenSidecar(shapeFileInfo *shpInfo, const char *shapefile, const char *sidecarExt, const char *sidecarName,
+    shapeSidecarOpenFunc openFunc, shapeSidecarCloseFunc closeFunc)
+{
+    int nEntities, nShapeType;
+    char sidecarfile[SHAPETOOL_PATHLEN_INVALID * 2];
+
+    if (shpFileSidecarPath(shapefile, sidecarExt, sidecarfile, sizeof(sidecarfile)) < 0 || !pathfile_exists(sidecarfile)) {
+        return;
+    }
+
+    if (shpFileGetMTime(sidecarfile) < shpFileGetMTime(shapefile)) {
+        printf("Warn: %s is older than shp file, ignored: %s\n", sidecarName, sidecarfile);
+        return;
+    }
+
+    if (openFunc(shpInfo, sidecarfile, &nEntities, &nShapeType) == 0) {
+        if (nEntities != shpInfo->nEntities || nShapeType != shpInfo->nShapeType) {
+            printf("Warn: %s mismatch shp file, ignored: %s\n", sidecarName, sidecarfile);
+            closeFunc(shpInfo);
+        }
+    }
+}
+
+
+static int shapeFileInfoOpenIndex(shapeFileInfo *shpInfo, const char *stifile, int *nEntities, int *nShapeType)
+{
+    if (shpIndexOpen(&shpInfo->index, stifile) != 0) {
+        return -1;
+    }
+    *nEntities = shpInfo->index.header->nEntities;
+
+    // index is built from envelopes of any shp type
+    *nShapeType = shpInfo->nShapeType;
+    return 0;
+}
+
+
+static void shapeFileInfoCloseIndex(shapeFileInfo *shpInfo)
+{
+    shpIndexClose(&shpInfo->index);
+}
+
+
+static int shapeFileInfoOpenCompact(shapeFileInfo *shpInfo, const char *shpcfile, int *nEntities, int *nShapeType)
+{
+    if (shpcFileOpen(&shpInfo->compact, shpcfile) != 0) {
+        return -1;
+    }
+    *nEntities = shpInfo->compact.header->nEntities;
+    *nShapeType = shpInfo->compact.header->nShapeType;
+    return 0;
+}
+
+
+static void shapeFileInfoCloseCompact(shapeFileInfo *shpInfo)
+{
+    shpcFileClose(&shpInfo->compact);
+}
+
+
+static int shapeFileInfoOpenPyramid(shapeFileInfo *shpInfo, const char *shppfile, int *nEntities, int *nShapeType)
+{
+    if (shpPyramidOpen(&shpInfo->pyramid, shppfile) != 0) {
+        return -1;
+    }
+    *nEntities = shpInfo->pyramid.header->nEntities;
+    *nShapeType = shpInfo->pyramid.header->nShapeType;
+    return 0;
+}
+
+
+static void shapeFileInfoClosePyramid(shapeFileInfo *shpInfo)
+{
+    shpPyramidClose(&shpInfo->pyramid);
+}
+
+
+/**
+ * shp file being built into a sidecar
+ */
+typedef struct
+{
+    const shpFileMap *fileMap;
+
+    int nEntities;
+    int nShapeType;
+    int nShpTypeMask;
+    int hasZ;
+    int hasM;
+
+    // layer bounds: Xmin, Ymin, Xmax, Ymax
+    double bounds[4];
+} shapeSidecarSource;
+
+
+/**
+ * write sidecarfile from source. returns 0 on success.
+ */
+typedef int (*shapeSidecarBuildFunc)(const char *sidecarfile, const shapeSidecarSource *source, void *buildArg);
+
+
+/**
+ * map shp file and build its sidecar (a.shp => a.sti, a.shpc, a.shpp) by
+ *   buildFunc. returns 0 on success.
+ */
+static int shapeFileBuildSidecar(const char *shapefile, const char *sidecarExt, shapeSidecarBuildFunc buildFunc, void *buildArg)
+{
+    int ret;
+    double minBounds[4], maxBounds[4];
+    char sidecarfile[SHAPETOOL_PATHLEN_INVALID * 2];
+
+    SHPHandle hSHP;
+    shpFileMap fileMap;
+    shapeSidecarSource source;
+
+    if (shpFileSidecarPath(shapefile, sidecarExt, sidecarfile, sizeof(sidecarfile)) < 0) {
+        printf("Error: Bad shp file: %s\n", shapefile);
+        return -1;
+    }
+
+    bzero(&source, sizeof(source));
+
+    // not shapeFileInfoOpen(): it would map the sidecar being rewritten
+    hSHP = SHPOpen(shapefile, "rb");
+    if (! hSHP) {
+        printf("Error: Cannot open shp file: %s\n", shapefile);
+        return -1;
+    }
+
+    SHPGetInfo(hSHP, &source.nEntities, &source.nShapeType, minBounds, maxBounds);
+    source.nShpTypeMask = SHPGetType(hSHP, &source.hasZ, &source.hasM);
+    SHPClose(hSHP);
+
+    if (shpFileMapOpen(&fileMap, shapefile) != 0) {
+        return -1;
+    }
+    if (fileMap.nEntities != source.nEntities) {
+        printf("Error: shx records(%d) mismatch: %s\n", fileMap.nEntities, shapefile);
+        shpFileMapClose(&fileMap);
+        return -1;
+    }
+
+    source.fileMap = &fileMap;
+    source.bounds[0] = minBounds[0];
+    source.bounds[1] = minBounds[1];
+    source.bounds[2] = maxBounds[0];
+    source.bounds[3] = maxBounds[1];
+
+    ret = buildFunc(sidecarfile, &source, buildArg);
+
+    shpFileMapClose(&fileMap);
+    return ret;
+}
+
+
+static int shapeFileInfoOpen(shapeFileInfo *shpInfo, const char *shapefile, const shapeReadOpts *readOpts)
 {
     bzero(shpInfo, sizeof(shapeFileInfo));
 
@@ -99,7 +408,7 @@ static int shapeFileInfoOpen(shapeFileInfo *shpInfo, const char *shapefile)
         return -1;
     }
 
-	SHPGetInfo(shpInfo->hSHP, &shpInfo->nEntities, &shpInfo->nShapeType, shpInfo->minBounds, shpInfo->maxBounds);
+    SHPGetInfo(shpInfo->hSHP, &shpInfo->nEntities, &shpInfo->nShapeType, shpInfo->minBounds, shpInfo->maxBounds);
 
     shpInfo->nShpTypeMask = SHPGetType(shpInfo->hSHP, &shpInfo->hasZ, &shpInfo->hasM);
     if (shpInfo->nShpTypeMask == SHAPE_TYPE_NIL) {
@@ -108,53 +417,503 @@ static int shapeFileInfoOpen(shapeFileInfo *shpInfo, const char *shapefile)
         return -1;
     }
 
+    shpInfo->readOpts = *readOpts;
+
+    shapeFileInfoOpenSidecar(shpInfo, shapefile, SHPCOMPACT_FILE_EXT, "compact file", shapeFileInfoOpenCompact, shapeFileInfoCloseCompact);
+
+    // .shp pages are not needed if compact geometry found
+    if (readOpts->readMode == shp_readmode_mmap && ! shpInfo->compact.addr) {
+        if (shpFileMapOpen(&shpInfo->fileMap, shapefile) != 0) {
+            shapeFileInfoClose(shpInfo);
+            return -1;
+        }
+        if (shpInfo->fileMap.nEntities != shpInfo->nEntities) {
+            printf("Error: shx records(%d) mismatch: %s\n", shpInfo->fileMap.nEntities, shapefile);
+            shapeFileInfoClose(shpInfo);
+            return -1;
+        }
+        if (readOpts->xyOnly && (shpInfo->hasZ || shpInfo->hasM)) {
+            shpFileMapAdviseXY(&shpInfo->fileMap);
+        }
+    }
+
+    // SHPReadObjectEx would copy Z/M of every record
+    if (readOpts->readMode == shp_readmode_file && readOpts->xyOnly && ! shpInfo->compact.addr) {
+        if (shpXYReaderOpen(&shpInfo->xyReader, shapefile) != 0) {
+            shapeFileInfoClose(shpInfo);
+            return -1;
+        }
+        if (shpInfo->xyReader.nEntities != shpInfo->nEntities) {
+            printf("Error: shx records(%d) mismatch: %s\n", shpInfo->xyReader.nEntities, shapefile);
+            shapeFileInfoClose(shpInfo);
+            return -1;
+        }
+    }
+
+    shapeFileInfoOpenSidecar(shpInfo, shapefile, SHPINDEX_FILE_EXT, "index", shapeFileInfoOpenIndex, shapeFileInfoCloseIndex);
+
+    shapeFileInfoOpenSidecar(shpInfo, shapefile, SHPPYRAMID_FILE_EXT, "pyramid file", shapeFileInfoOpenPyramid, shapeFileInfoClosePyramid);
+
+    if (shpInfo->compact.addr) {
+        // borrow envelope columns of .shpc
+        shpInfo->envTable.nEntities = shpInfo->nEntities;
+        shpInfo->envTable.borrowed = 1;
+        shpInfo->envTable.Xmin = (double *) shpInfo->compact.boxes[0];
+        shpInfo->envTable.Ymin = (double *) shpInfo->compact.boxes[1];
+        shpInfo->envTable.Xmax = (double *) shpInfo->compact.boxes[2];
+        shpInfo->envTable.Ymax = (double *) shpInfo->compact.boxes[3];
+    } else if (! shpInfo->index.addr) {
+        if (shpEnvelopeTableLoad(&shpInfo->envTable, shapefile, &shpInfo->fileMap, shpInfo->nEntities) != 0) {
+            printf("Warn: Failed to load envelopes: %s\n", shapefile);
+        }
+    }
+
+    snprintf(shpInfo->shapefile, sizeof(shpInfo->shapefile), "%s", shapefile);
+
+    if (readOpts->geomCache) {
+        shpInfo->cacheFileId = shpGeomCacheFileId(readOpts->geomCache, shapefile);
+        shpInfo->mtime = shpFileGetMTime(shapefile);
+    }
+
     // All success
     return 0;
 }
 
 
-static void shapeFileInfoDraw(shapeFileInfo *shpInfo, cairoDrawCtx *CDC)
+static void shapeReadBufInit(shapeReadBuf *readBuf)
 {
-    int nShapeId;
-
-    CGBox2D shapeEnv;   // data rect
-    CGBox2D drawRect;    // draw rect
+    bzero(readBuf, sizeof(shapeReadBuf));
 
-    SHPObjectEx * shapeReadRef = 0;
-    if (! SHPCreateObjectEx(&shapeReadRef)) {
+    if (! SHPCreateObjectEx(&readBuf->shpObj)) {
         // out of memory
         abort();
     }
+}
+
+
+static void shapeReadBufFree(shapeReadBuf *readBuf)
+{
+    SHPDestroyObjectEx(readBuf->shpObj);
+    shpcPointsBufFree(&readBuf->pointsBuf);
+    shpXYReadBufFree(&readBuf->xyBuf);
+    bzero(readBuf, sizeof(shapeReadBuf));
+}
+
+
+/**
+ * read bounding rect of shape. returns SHPT_NULL for null shape.
+ */
+STATIC_INLINE int shapeFileInfoReadEnvelope(shapeFileInfo *shpInfo, int nShapeId, CGBox2D *shapeEnv)
+{
+    if (shpInfo->envTable.Xmin) {
+        return (shpEnvelopeTableGet(&shpInfo->envTable, nShapeId, shapeEnv) ? shpInfo->nShapeType : SHPT_NULL);
+    }
+    if (shpInfo->fileMap.shpAddr) {
+        return shpFileMapGetEnvelope(&shpInfo->fileMap, nShapeId, shapeEnv);
+    }
+    if (shpInfo->xyReader.shxAddr) {
+        return shpXYReaderGetEnvelope(&shpInfo->xyReader, nShapeId, shapeEnv);
+    }
+    return SHPReadObjectEnvelope(shpInfo->hSHP, nShapeId, (SHPEnvelope *) shapeEnv, 0);
+}
 
-    int nShpTypeMask = shpInfo->nShpTypeMask;
 
-    for (nShapeId = 0; nShapeId < shpInfo->nEntities; nShapeId++) {
+/**
+ * read geometry of shape: pyramid level of readBuf first, then .shpc,
+ *   then mapped .shp, then X/Y only reader, then SHPReadObjectEx.
+ *   geomView is valid until next read with the same readBuf.
+ */
+STATIC_INLINE int shapeFileInfoReadGeom(shapeFileInfo *shpInfo, int nShapeId, shapeReadBuf *readBuf, shapeGeomView *geomView)
+{
+    if (readBuf->level > 0) {
+        return shpPyramidGetGeom(&shpInfo->pyramid, readBuf->level, nShapeId, &readBuf->pointsBuf, geomView);
+    }
+    if (shpInfo->compact.addr) {
+        return shpcFileGetGeom(&shpInfo->compact, nShapeId, &readBuf->pointsBuf, geomView);
+    }
+    if (shpInfo->fileMap.shpAddr) {
+        return shpFileMapGetGeom(&shpInfo->fileMap, nShapeId, &readBuf->xyBuf, geomView);
+    }
+    if (shpInfo->xyReader.shxAddr) {
+        return shpXYReaderGetGeom(&shpInfo->xyReader, nShapeId, &readBuf->xyBuf, geomView);
+    }
+    if (SHPReadObjectEx(shpInfo->hSHP, nShapeId, readBuf->shpObj)) {
+        shapeGeomViewFromObject(readBuf->shpObj, nShapeId, geomView);
+        return 1;
+    }
+    return 0;
+}
+
+
+/**
+ * search ids of shapes which may be visible in viewport.
+ *   returns -1 if neither index nor envelopes, then all shapes should be visited.
+ */
+static int shapeFileInfoCull(shapeFileInfo *shpInfo, const Viewport2D *vp, int **shapeIds, int *capacity)
+{
+    CGBox2D dataBox;
+    ViewToDataBox(vp, vp->viewBox, &dataBox);
+
+    if (shpInfo->index.addr) {
+        return shpIndexSearch(&shpInfo->index, &dataBox, shapeIds, capacity);
+    }
+    if (shpInfo->envTable.Xmin) {
+        return shpEnvelopeTableCull(&shpInfo->envTable, &dataBox, shapeIds, capacity);
+    }
+
+    return (-1);
+}
+
+
+/**
+ * count shapes whose envelopes overlap dataBox, up to maxFound. searches
+ *   stop once maxFound shapes are found. one of them is returned in firstId.
+ */
+static int shapeFileInfoProbe(shapeFileInfo *shpInfo, const CGBox2D *dataBox, int maxFound, int *firstId)
+{
+    int nShapeId, numFound = 0;
+    int probeIds[SHAPEFILE_PROBE_MAX];
+    CGBox2D shapeEnv;
+
+    maxFound = CG_MIN(maxFound, SHAPEFILE_PROBE_MAX);
+
+    if (shpInfo->index.addr) {
+        numFound = shpIndexProbe(&shpInfo->index, dataBox, maxFound, probeIds);
+    } else if (shpInfo->envTable.Xmin) {
+        numFound = shpEnvelopeTableProbe(&shpInfo->envTable, dataBox, maxFound, probeIds);
+    } else {
+        for (nShapeId = 0; nShapeId < shpInfo->nEntities && numFound < maxFound; nShapeId++) {
+            // inclusive as index search, so that points are found
+            if (shapeFileInfoReadEnvelope(shpInfo, nShapeId, &shapeEnv) != SHPT_NULL &&
+                shapeEnv.Xmin <= dataBox->Xmax && shapeEnv.Ymin <= dataBox->Ymax &&
+                shapeEnv.Xmax >= dataBox->Xmin && shapeEnv.Ymax >= dataBox->Ymin) {
+                probeIds[numFound++] = nShapeId;
+            }
+        }
+    }
+
+    if (numFound > 0) {
+        *firstId = probeIds[0];
+    }
+    return numFound;
+}
+
+
+/**
+ * test if polygon shape covers dataBox.
+ */
+static int shapeFileInfoCoversBox(shapeFileInfo *shpInfo, int nShapeId, const CGBox2D *dataBox)
+{
+    int covers = 0;
+    shapeReadBuf readBuf;
+    shapeGeomView geomView;
+
+    if (shpInfo->nShpTypeMask != SHAPE_TYPE_POLYGON) {
+        return 0;
+    }
+
+    shapeReadBufInit(&readBuf);
+
+    if (shapeFileInfoReadGeom(shpInfo, nShapeId, &readBuf, &geomView)) {
+        covers = shapeGeomViewCoversBox(&geomView, dataBox);
+    }
+
+    shapeReadBufFree(&readBuf);
+    return covers;
+}
+
+
+/**
+ * test if a feature of drawRect is counted by CDC: it is drawn by every
+ *   band or metatile it overlaps, but only counted by the one of its center.
+ */
+STATIC_INLINE int shapeFileInfoCountsBox(const cairoDrawCtx *CDC, const CGBox2D *drawRect)
+{
+    double X = (drawRect->Xmin + drawRect->Xmax) * 0.5;
+    double Y = (drawRect->Ymin + drawRect->Ymax) * 0.5;
+
+    return (X >= CDC->countBox.Xmin && X < CDC->countBox.Xmax && Y >= CDC->countBox.Ymin && Y < CDC->countBox.Ymax);
+}
+
+
+/**
+ * collect ids of shapes to draw in viewport of CDC, in record order.
+ *   features under CDC->subpixelPx are counted and not read: in mode
+ *   subpixel_dot they are listed as ~nShapeId (negative) and drawn as a dot
+ *   in their place, else they are not listed.
+ *   *shapeIds must be freed by caller. returns number of ids.
+ */
+static int shapeFileInfoDrawList(shapeFileInfo *shpInfo, cairoDrawCtx *CDC, int **shapeIds, int *capacity)
+{
+    int k, nShapeId, numShapes, numDraws = 0;
+
+    CGBox2D shapeEnv;   // data rect
+    CGBox2D drawRect;   // draw rect
+
+    const Viewport2D *vp = &CDC->viewport;
+
+    // sub-pixel points are still drawn as markers
+    const int subpixel = (CDC->subpixelMode != subpixel_draw && shpInfo->nShpTypeMask != SHAPE_TYPE_POINT);
+
+    int numCulled = shapeFileInfoCull(shpInfo, vp, shapeIds, capacity);
+    if (numCulled < 0) {
+        // visit all shapes
+        numShapes = shpInfo->nEntities;
+        if (*capacity < numShapes) {
+            *capacity = numShapes;
+            *shapeIds = (int *) mem_realloc(*shapeIds, sizeof(int) * numShapes);
+        }
+    } else {
+        numShapes = numCulled;
+    }
+
+    for (k = 0; k < numShapes; k++) {
+        nShapeId = (numCulled < 0 ? k : (*shapeIds)[k]);
+
         // read bounding rect of shape
-        if (SHPReadObjectEnvelope(shpInfo->hSHP, nShapeId, (SHPEnvelope *) &shapeEnv, 0) != SHPT_NULL) {
+        if (shapeFileInfoReadEnvelope(shpInfo, nShapeId, &shapeEnv) != SHPT_NULL) {
             // convert to canvas box
-            DataToViewBox(&CDC->viewport, shapeEnv, &drawRect);
+            DataToViewBox(vp, shapeEnv, &drawRect);
 
             // test if overlapped of canvas with shape
-            if (CGBoxIsOverlap(CDC->viewport.viewBox, drawRect)) {
-                if (nShpTypeMask == SHAPE_TYPE_POLYGON) {
+            if (CGBoxIsOverlap(vp->viewBox, drawRect)) {
+                if (subpixel && CGBoxGetDX(drawRect) < CDC->subpixelPx && CGBoxGetDY(drawRect) < CDC->subpixelPx) {
+                    // geometry of sub-pixel feature is never read
+                    if (shapeFileInfoCountsBox(CDC, &drawRect)) {
+                        CDC->numSubpixel++;
+                    }
+                    if (CDC->subpixelMode == subpixel_dot) {
+                        (*shapeIds)[numDraws++] = ~nShapeId;
+                    }
+                } else if (shpInfo->nShpTypeMask == SHAPE_TYPE_POLYGON) {
                     if (CGBoxGetDX(drawRect) > 0 && CGBoxGetDY(drawRect) > 0) {
                         // polygon shape is visible
-                        if (SHPReadObjectEx(shpInfo->hSHP, nShapeId, shapeReadRef)) {
-                            drawPolygonShape(shapeReadRef, CDC);
-                        } else {
-                            printf("Warn: SHPReadObjectEx() failed on shape#%d\n", nShapeId);
-                        }
+                        (*shapeIds)[numDraws++] = nShapeId;
                     }
-                } else if (nShpTypeMask == SHAPE_TYPE_LINE) {
+                } else {
+                    (*shapeIds)[numDraws++] = nShapeId;
+                }
+            }
+        }
+    }
+
+    return numDraws;
+}
+
+
+/**
+ * draw dot of sub-pixel feature listed as ~nShapeId
+ */
+STATIC_INLINE void shapeFileInfoDrawDot(shapeFileInfo *shpInfo, int nShapeId, cairoDrawCtx *CDC)
+{
+    CGBox2D shapeEnv, drawRect;
+
+    if (shapeFileInfoReadEnvelope(shpInfo, nShapeId, &shapeEnv) != SHPT_NULL) {
+        DataToViewBox(&CDC->viewport, shapeEnv, &drawRect);
+        drawSubpixelShape(shpInfo->nShpTypeMask, nShapeId, &drawRect, CDC);
+    }
+}
+
+
+STATIC_INLINE void shapeFileInfoDrawGeom(shapeFileInfo *shpInfo, const shapeGeomView *geomView, cairoDrawCtx *CDC)
+{
+    if (shpInfo->nShpTypeMask == SHAPE_TYPE_POLYGON) {
+        drawPolygonShape(geomView, CDC);
+    } else if (shpInfo->nShpTypeMask == SHAPE_TYPE_LINE) {
+        drawPolylineShape(geomView, CDC);
+    } else if (shpInfo->nShpTypeMask == SHAPE_TYPE_POINT) {
+        drawPointShape(geomView, CDC);
+    }
+}
+
+
+/**
+ * draw decoded geometry, keeping a copy in geometry cache if any
+ */
+STATIC_INLINE void shapeFileInfoDrawDecoded(shapeFileInfo *shpInfo, shpGeomCache *cache, const shapeGeomView *geomView, cairoDrawCtx *CDC)
+{
+    shapeGeomView cachedView;
+    const shpGeomCacheEntry *entry;
+
+    if (cache && (entry = shpGeomCachePut(cache, shpInfo->cacheFileId, shpInfo->mtime, geomView, &cachedView)) != 0) {
+        shapeFileInfoDrawGeom(shpInfo, &cachedView, CDC);
+        shpGeomCacheRelease(cache, entry);
+    } else {
+        shapeFileInfoDrawGeom(shpInfo, geomView, CDC);
+    }
+}
 
-                } else if (nShpTypeMask == SHAPE_TYPE_POINT) {
 
+/**
+ * decode shapes by read-ahead threads and draw them in order.
+ *   shapes found in geometry cache are not decoded again.
+ */
+static int shapeFileInfoDrawReadAhead(shapeFileInfo *shpInfo, const int *shapeIds, int numDraws, cairoDrawCtx *CDC)
+{
+    int k, numDecodes = numDraws;
+
+    shpReadAhead readAhead;
+    const shpReadAheadSlot *slot;
+    shapeGeomView geomView;
+
+    const shpGeomCacheEntry **hits = 0;
+    const int *decodeIds = shapeIds;
+    int *missIds = 0;
+
+    shpGeomCache *cache = shpInfo->readOpts.geomCache;
+
+    const int numWorkers = CG_MAX(1, shpInfo->readOpts.decoders);
+
+    // default ring keeps each decoder two full chunks ahead
+    const int numSlots = (shpInfo->readOpts.readAhead > 0 ? shpInfo->readOpts.readAhead : numWorkers * SHPREADAHEAD_CHUNK_MAX * 2);
+
+    if (cache) {
+        // pin hits and decode misses only
+        hits = (const shpGeomCacheEntry **) mem_alloc_zero(numDraws, sizeof(shpGeomCacheEntry *));
+    }
+
+    // first dot of sub-pixel feature if any
+    k = 0;
+    while (k < numDraws && shapeIds[k] >= 0) {
+        k++;
+    }
+
+    if (cache || k < numDraws) {
+        // dots and cache hits are not decoded
+        missIds = (int *) mem_alloc_unset(sizeof(int) * numDraws);
+        numDecodes = 0;
+
+        for (k = 0; k < numDraws; k++) {
+            if (shapeIds[k] < 0) {
+                continue;
+            }
+            if (cache) {
+                hits[k] = shpGeomCacheGet(cache, shpInfo->cacheFileId, shpInfo->mtime, shapeIds[k], &geomView);
+            }
+            if (! hits || ! hits[k]) {
+                missIds[numDecodes++] = shapeIds[k];
+            }
+        }
+        decodeIds = missIds;
+    }
+
+    if (shpReadAheadStart(&readAhead, shpInfo->shapefile, shpInfo->hSHP, decodeIds, numDecodes, numSlots, numWorkers) != 0) {
+        if (cache) {
+            for (k = 0; k < numDraws; k++) {
+                if (hits[k]) {
+                    shpGeomCacheRelease(cache, hits[k]);
                 }
             }
+            mem_free(hits);
+        }
+        if (missIds) {
+            mem_free(missIds);
         }
+        return (-1);
     }
 
-    SHPDestroyObjectEx(shapeReadRef);
+    for (k = 0; k < numDraws; k++) {
+        if (shapeIds[k] < 0) {
+            shapeFileInfoDrawDot(shpInfo, ~shapeIds[k], CDC);
+            continue;
+        }
+
+        if (hits && hits[k]) {
+            shpGeomCacheEntryView(hits[k], &geomView);
+            shapeFileInfoDrawGeom(shpInfo, &geomView, CDC);
+            shpGeomCacheRelease(cache, hits[k]);
+            continue;
+        }
+
+        slot = shpReadAheadNext(&readAhead);
+        if (! slot) {
+            break;
+        }
+
+        if (slot->decoded) {
+            shapeGeomViewFromObject(slot->shpObj, slot->nShapeId, &geomView);
+            shapeFileInfoDrawDecoded(shpInfo, cache, &geomView, CDC);
+        } else {
+            printf("Warn: SHPReadObjectEx() failed on shape#%d\n", slot->nShapeId);
+        }
+        shpReadAheadRelease(&readAhead, slot);
+    }
+
+    shpReadAheadFinish(&readAhead);
+
+    if (cache) {
+        mem_free(hits);
+    }
+    if (missIds) {
+        mem_free(missIds);
+    }
+    return 0;
+}
+
+
+/**
+ * read and draw one shape, through geometry cache if any
+ */
+STATIC_INLINE void shapeFileInfoDrawShape(shapeFileInfo *shpInfo, int nShapeId, shapeReadBuf *readBuf, cairoDrawCtx *CDC)
+{
+    shapeGeomView geomView;
+    const shpGeomCacheEntry *entry;
+
+    // mapped pages and simplified levels are never copied into cache
+    shpGeomCache *cache = (shpInfo->fileMap.shpAddr || readBuf->level > 0 ? 0 : shpInfo->readOpts.geomCache);
+
+    if (cache && (entry = shpGeomCacheGet(cache, shpInfo->cacheFileId, shpInfo->mtime, nShapeId, &geomView)) != 0) {
+        shapeFileInfoDrawGeom(shpInfo, &geomView, CDC);
+        shpGeomCacheRelease(cache, entry);
+        return;
+    }
+
+    if (shapeFileInfoReadGeom(shpInfo, nShapeId, readBuf, &geomView)) {
+        shapeFileInfoDrawDecoded(shpInfo, cache, &geomView, CDC);
+    } else {
+        printf("Warn: SHPReadObjectEx() failed on shape#%d\n", nShapeId);
+    }
+}
+
+
+static void shapeFileInfoDraw(shapeFileInfo *shpInfo, cairoDrawCtx *CDC)
+{
+    int k;
+
+    int *shapeIds = 0, capacity = 0;
+
+    int numDraws = shapeFileInfoDrawList(shpInfo, CDC, &shapeIds, &capacity);
+
+    // coarsest simplified level under half a pixel, 0 for full resolution
+    int level = (shpInfo->pyramid.addr ? shpPyramidSelectLevel(&shpInfo->pyramid, CDC->viewport.XScale) : 0);
+
+    // mapped pages and X/Y only reads need no read-ahead
+    if (numDraws > 0 && (shpInfo->readOpts.readAhead > 0 || shpInfo->readOpts.decoders > 1) &&
+        !shpInfo->fileMap.shpAddr && !shpInfo->compact.addr && !shpInfo->xyReader.shxAddr && !level) {
+        if (shapeFileInfoDrawReadAhead(shpInfo, shapeIds, numDraws, CDC) == 0) {
+            mem_free(shapeIds);
+            drawBatchFlush(CDC);
+            return;
+        }
+    }
+
+    shapeReadBuf readBuf;
+    shapeReadBufInit(&readBuf);
+
+    readBuf.level = level;
+
+    for (k = 0; k < numDraws; k++) {
+        if (shapeIds[k] < 0) {
+            shapeFileInfoDrawDot(shpInfo, ~shapeIds[k], CDC);
+        } else {
+            shapeFileInfoDrawShape(shpInfo, shapeIds[k], &readBuf, CDC);
+        }
+    }
+
+    shapeReadBufFree(&readBuf);
+    mem_free(shapeIds);
+
+    drawBatchFlush(CDC);
 }
 
 
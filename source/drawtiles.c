@@ -0,0 +1,1078 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file drawtiles.c
+ * @brief draw layers into a pyramid of XYZ tiles.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.9
+ *
+ * @since 2024-10-23 10:26:15
+ * @date 2024-10-24 15:20:00
+ *
+ * @note
+ *   tiles are written to: OUTDIR/z/x/y.png, or with --archive into one
+ *   .tiles file (see tilearchive.h)
+ */
+#include "shapetool-common.h"
+#include "drawtiles.h"
+#include "drawbands.h"
+#include "tilearchive.h"
+
+#include <common/timeut.h>
+#include <common/murmur3.h>
+
+#if defined(WIN32API)
+#   include <direct.h>
+#   define drawTilesMkdir(path)  _mkdir(path)
+#   define drawTilesLink(src, dst)  (CreateHardLinkA(dst, src, 0) ? 0 : -1)
+#else
+#   define drawTilesMkdir(path)  mkdir(path, 0755)
+#   define drawTilesLink(src, dst)  link(src, dst)
+#endif
+
+#define DRAWTILES_DEDUP_CAPACITY  4096
+
+
+typedef struct
+{
+    int x;
+    int y;
+} drawTileXY;
+
+
+typedef enum
+{
+    tilekind_draw = 0,
+    tilekind_empty,
+    tilekind_solid
+} drawTileKind;
+
+
+// png encoded in memory
+typedef struct
+{
+    ub1 *buf;
+    size_t len;
+    size_t cap;
+} drawTilePng;
+
+
+// first tile written of same pixels
+typedef struct
+{
+    // hash of pixels, 0 for free slot
+    ub8 hash[2];
+
+    // blob in archive
+    ub8 offset;
+    ub4 length;
+
+    // file z/x/y.png in dir
+    int z, x, y;
+} drawTileRef;
+
+
+// hash set of tiles written, shared by workers
+typedef struct
+{
+    pthread_mutex_t lock;
+
+    // open addressing, capacity is power of 2
+    drawTileRef *refs;
+    sb8 capacity;
+    sb8 count;
+} drawTilesDedup;
+
+
+// png of tiles never drawn: encoded once, written once, then referenced
+typedef struct
+{
+    drawTilePng png;
+
+    // first tile written, valid if written is 1
+    drawTileRef ref;
+    int written;
+} drawTileShared;
+
+
+struct drawTilesWorker_t;
+
+
+typedef struct
+{
+    // layers drawn in order of map
+    shapeLayer *layers;
+    int numLayers;
+
+    // box of tile 0/0/0
+    CGBox2D gridBox;
+
+    // merged extent of layers: tiles out of it are not drawn
+    CGBox2D dataBox;
+
+    int tileSize;
+    int minZoom;
+    int maxZoom;
+
+    // tiles are written to outDir/z/x/y.png, or into archive if given
+    const char *outDir;
+    tileArchiveWriter *archive;
+
+    // write identical tiles once if not null
+    drawTilesDedup *dedup;
+    sb8 numWritten;
+    sb8 numDupes;
+
+    // tiles without shapes, and tiles inside of one polygon
+    drawTileShared emptyTile;
+    drawTileShared solidTile;
+    pthread_mutex_t sharedLock;
+    int hasPolygons;
+    sb8 numEmpty;
+    sb8 numSolid;
+
+    // tiles per side of metatile and culling margin in dots
+    int metaTile;
+    int buffer;
+
+    const shapetool_options *options;
+
+    // current zoom: tiles [x0, x1] x [y0, y1] are written
+    int zoom;
+    int x0, y0, x1, y1;
+
+    // metatiles of current zoom, dealt to workers in runs of columns
+    int metaSize;
+    drawTileXY *metas;
+    int numMetas;
+
+    struct drawTilesWorker_t *workers;
+    int numWorkers;
+
+    uatomic_int failedCount;
+    sb8 numSubpixel;
+} drawTilesJob;
+
+
+typedef struct drawTilesWorker_t
+{
+    drawTilesJob *job;
+    pthread_t thread;
+    int started;
+
+    // own metatiles [head, tail) of job->metas: owner takes from head,
+    //   thieves take from tail
+    pthread_mutex_t lock;
+    int head;
+    int tail;
+
+    // draw context reused for all metatiles of same size
+    cairoDrawCtx CDC;
+    int ctxMetaSize;
+
+    // png of tile encoded for archive
+    drawTilePng png;
+
+    int numDrawn;
+    int numStolen;
+    int numDupes;
+    int numEmpty;
+    int numSolid;
+    sb8 numSubpixel;
+} drawTilesWorker;
+
+
+/**
+ * make directory and its parents if not exist. returns 0 on success.
+ */
+static int drawTilesMakeDirs(const char *dir)
+{
+    char path[SHAPETOOL_PATHLEN_INVALID * 2];
+    char *p;
+
+    int len = snprintf(path, sizeof(path), "%s", dir);
+    if (len <= 0 || len >= (int) sizeof(path)) {
+        printf("Error: bad tiles dir: %s\n", dir);
+        return (-1);
+    }
+
+    for (p = path + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (! pathfile_exists(path)) {
+                drawTilesMkdir(path);
+            }
+            *p = '/';
+        }
+    }
+
+    if (! pathfile_exists(path) && drawTilesMkdir(path) != 0) {
+        printf("Error: failed to make dir: %s\n", path);
+        return (-1);
+    }
+    return 0;
+}
+
+
+/**
+ * make draw context of metatile size for a worker.
+ */
+static int drawTileCtxInit(const drawTilesJob *job, cairoDrawCtx *CDC)
+{
+    const shapetool_options *options = job->options;
+
+    CGSize2D metaSize = { job->metaSize * job->tileSize, job->metaSize * job->tileSize };
+
+    if (cairoDrawCtxInit(CDC, job->gridBox, metaSize, dot_logical_px, (float) options->dpi, (cairoDrawQuality) options->quality)) {
+        return (-1);
+    }
+
+    CDC->batchMode = options->batch;
+    if (options->simplifypx >= 0) {
+        // else by quality
+        CDC->simplifyPx = options->simplifypx;
+    }
+    CDC->snapGrid = options->snap;
+    CDC->subpixelMode = (cairoSubpixelMode) options->subpixel;
+    CDC->subpixelPx = options->subpixelpx;
+
+    return 0;
+}
+
+
+/**
+ * clear draw context for next metatile: box of metatile maps exactly onto
+ *   the surface, and culling box is inflated by buffer.
+ */
+static void drawTileCtxReset(const drawTilesJob *job, const CGBox2D *metaBox, cairoDrawCtx *CDC)
+{
+    const int metaPx = job->metaSize * job->tileSize;
+
+    CGBox2D viewBox = { .Xmin = 0, .Ymin = 0, .Xmax = metaPx, .Ymax = metaPx };
+    CGSize2D tileDPI = { job->options->dpi, job->options->dpi };
+
+    ViewportInitExact(&CDC->viewport, *metaBox, viewBox, tileDPI);
+    CGBoxInflate(CDC->viewport.viewBox, job->buffer);
+
+    // features in buffer are counted by the metatile of their center
+    CDC->countBox = viewBox;
+
+    cairo_save(CDC->cr);
+    cairo_set_operator(CDC->cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(CDC->cr);
+    cairo_restore(CDC->cr);
+}
+
+
+static void drawTileHash(const unsigned char *pixels, int stride, int tileSize, ub8 hash[2])
+{
+    int row;
+    murmur3_128_t ctx;
+
+    murmur3_128_init(&ctx, 0);
+
+    // a row of ARGB32 tile is whole blocks: tileSize * 4 / 16
+    for (row = 0; row < tileSize; row++) {
+        murmur3_128_update(&ctx, pixels + (size_t) row * stride, (size_t) tileSize * 4 / MURMUR3_BLOCK_SIZE);
+    }
+
+    murmur3_128_final(&ctx, hash);
+
+    if (! hash[0] && ! hash[1]) {
+        // 0 is free slot
+        hash[0] = 1;
+    }
+}
+
+
+/**
+ * slot of hash in refs: either same hash or free.
+ */
+static drawTileRef * drawTilesDedupSlot(drawTileRef *refs, sb8 capacity, const ub8 hash[2])
+{
+    sb8 i = (sb8) (hash[0] & (capacity - 1));
+
+    while (refs[i].hash[0] || refs[i].hash[1]) {
+        if (refs[i].hash[0] == hash[0] && refs[i].hash[1] == hash[1]) {
+            break;
+        }
+        i = (i + 1) & (capacity - 1);
+    }
+    return &refs[i];
+}
+
+
+/**
+ * find first tile written with ref->hash. returns 0 if not found.
+ */
+static int drawTilesDedupFind(drawTilesDedup *dedup, drawTileRef *ref)
+{
+    int found = 0;
+    drawTileRef *slot;
+
+    pthread_mutex_lock(&dedup->lock);
+
+    slot = drawTilesDedupSlot(dedup->refs, dedup->capacity, ref->hash);
+    if (slot->hash[0] || slot->hash[1]) {
+        *ref = *slot;
+        found = 1;
+    }
+
+    pthread_mutex_unlock(&dedup->lock);
+    return found;
+}
+
+
+/**
+ * add tile written. if another worker added same hash meanwhile, its tile
+ *   is kept.
+ */
+static void drawTilesDedupAdd(drawTilesDedup *dedup, const drawTileRef *ref)
+{
+    sb8 i;
+    drawTileRef *slot, *refs;
+
+    pthread_mutex_lock(&dedup->lock);
+
+    if (dedup->count * 2 >= dedup->capacity) {
+        refs = (drawTileRef *) mem_alloc_zero((int) (dedup->capacity * 2), sizeof(drawTileRef));
+
+        for (i = 0; i < dedup->capacity; i++) {
+            if (dedup->refs[i].hash[0] || dedup->refs[i].hash[1]) {
+                *drawTilesDedupSlot(refs, dedup->capacity * 2, dedup->refs[i].hash) = dedup->refs[i];
+            }
+        }
+
+        mem_free(dedup->refs);
+        dedup->refs = refs;
+        dedup->capacity *= 2;
+    }
+
+    slot = drawTilesDedupSlot(dedup->refs, dedup->capacity, ref->hash);
+    if (! slot->hash[0] && ! slot->hash[1]) {
+        *slot = *ref;
+        dedup->count++;
+    }
+
+    pthread_mutex_unlock(&dedup->lock);
+}
+
+
+/**
+ * write tile z/x/y as a reference to first tile of same pixels: entry
+ *   sharing blob in archive, or hard link in dir. returns 0 on success.
+ */
+static int drawTileWriteRef(const drawTilesJob *job, const drawTileRef *ref, int x, int y)
+{
+    char srcfile[SHAPETOOL_PATHLEN_INVALID * 2];
+    char pngfile[SHAPETOOL_PATHLEN_INVALID * 2];
+
+    if (job->archive) {
+        return tileArchiveAppendRef(job->archive, job->zoom, x, y, ref->offset, ref->length);
+    }
+
+    snprintf(srcfile, sizeof(srcfile), "%s/%d/%d/%d.png", job->outDir, ref->z, ref->x, ref->y);
+    snprintf(pngfile, sizeof(pngfile), "%s/%d/%d/%d.png", job->outDir, job->zoom, x, y);
+
+    // tile of a previous run
+    remove(pngfile);
+
+    return drawTilesLink(srcfile, pngfile);
+}
+
+
+static cairo_status_t drawTilePngWrite(void *closure, const unsigned char *data, unsigned int length)
+{
+    drawTilePng *png = (drawTilePng *) closure;
+
+    if (png->len + length > png->cap) {
+        png->cap = CG_MAX(png->cap * 2, png->len + length);
+        png->buf = (ub1 *) mem_realloc(png->buf, png->cap);
+    }
+
+    memcpy(png->buf + png->len, data, length);
+    png->len += length;
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+
+/**
+ * encode png of shared tile once before workers start: transparent for
+ *   empty tiles, inside of a polygon for solid tiles.
+ */
+static int drawTileSharedInit(const drawTilesJob *job, drawTileShared *shared, int solid)
+{
+    cairoDrawCtx CDC;
+    cairo_status_t status;
+
+    const shapetool_options *options = job->options;
+
+    CGSize2D tileSize = { job->tileSize, job->tileSize };
+
+    if (cairoDrawCtxInit(&CDC, job->gridBox, tileSize, dot_logical_px, (float) options->dpi, (cairoDrawQuality) options->quality)) {
+        return (-1);
+    }
+
+    if (solid) {
+        drawPolygonCover(&CDC);
+    }
+    cairo_surface_flush(CDC.surface);
+
+    status = cairo_surface_write_to_png_stream(CDC.surface, drawTilePngWrite, &shared->png);
+
+    cairoDrawCtxFinal(&CDC);
+
+    if (status != CAIRO_STATUS_SUCCESS) {
+        printf("Error: failed to encode %s tile\n", solid ? "solid" : "empty");
+        return (-1);
+    }
+    return 0;
+}
+
+
+/**
+ * write png in memory as tile z/x/y. its blob or file is returned in ref.
+ */
+static int drawTileWritePng(const drawTilesJob *job, const drawTilePng *png, int x, int y, drawTileRef *ref)
+{
+    FILE *fp;
+    size_t len;
+    char pngfile[SHAPETOOL_PATHLEN_INVALID * 2];
+
+    ref->z = job->zoom;
+    ref->x = x;
+    ref->y = y;
+    ref->length = (ub4) png->len;
+
+    if (job->archive) {
+        return tileArchiveAppend(job->archive, job->zoom, x, y, png->buf, (ub4) png->len, &ref->offset);
+    }
+
+    snprintf(pngfile, sizeof(pngfile), "%s/%d/%d/%d.png", job->outDir, job->zoom, x, y);
+
+    // may be a hard link of a previous run
+    remove(pngfile);
+
+    fp = fopen(pngfile, "wb");
+    if (! fp) {
+        return (-1);
+    }
+    len = fwrite(png->buf, 1, png->len, fp);
+    if (fclose(fp) != 0 || len != png->len) {
+        return (-1);
+    }
+    return 0;
+}
+
+
+/**
+ * write tile z/x/y as shared tile: the first one is written in full, others
+ *   refer to it.
+ */
+static int drawTileWriteShared(drawTilesJob *job, drawTileShared *shared, int x, int y)
+{
+    int written, ret = 0;
+    drawTileRef ref;
+
+    pthread_mutex_lock(&job->sharedLock);
+
+    written = shared->written;
+    if (! written) {
+        ret = drawTileWritePng(job, &shared->png, x, y, &shared->ref);
+        shared->written = (ret == 0);
+    }
+    ref = shared->ref;
+
+    pthread_mutex_unlock(&job->sharedLock);
+
+    if (written && drawTileWriteRef(job, &ref, x, y) != 0) {
+        // no hard links on file system
+        ret = drawTileWritePng(job, &shared->png, x, y, &ref);
+    }
+
+    if (ret != 0) {
+        printf("Error: failed to write tile: %d/%d/%d\n", job->zoom, x, y);
+    }
+    return ret;
+}
+
+
+/**
+ * kind of tile by envelopes of shapes in tileBox: empty if none overlaps it
+ *   with buffer, solid if the only one is a polygon which covers it with
+ *   its strokes, else it is drawn. tileBox is tiles x tiles of zoom, so
+ *   that buffer and margin in dots are taken at the scale of zoom.
+ */
+static drawTileKind drawTileClassify(drawTilesJob *job, const CGBox2D *tileBox, int tiles)
+{
+    int j, num, hitLayer = 0, numFound = 0;
+    CGBox2D coverBox, probeBox = *tileBox;
+
+    // data units per dot
+    const double dot = (tileBox->Xmax - tileBox->Xmin) / ((double) job->tileSize * tiles);
+
+    CGBoxInflate(probeBox, job->buffer * dot);
+
+    for (j = 0; j < job->numLayers && numFound < 2; j++) {
+        num = shapeLayerProbe(&job->layers[j], &probeBox, 2 - numFound);
+        if (num > 0 && ! numFound) {
+            hitLayer = j;
+        }
+        numFound += num;
+    }
+
+    if (numFound == 0) {
+        return tilekind_empty;
+    }
+
+    if (numFound == 1 && job->layers[hitLayer].nShpTypeMask == SHAPE_TYPE_POLYGON) {
+        coverBox = *tileBox;
+        CGBoxInflate(coverBox, CG_MAX(job->buffer, DRAWTILES_MARGIN) * dot);
+
+        if (shapeLayerCoversBox(&job->layers[hitLayer], &probeBox, &coverBox)) {
+            return tilekind_solid;
+        }
+    }
+
+    return tilekind_draw;
+}
+
+
+/**
+ * write tile z/x/y at (col, row) of metatile surface. the tile shares
+ *   pixels of surface, nothing is copied.
+ */
+static int drawTileSliceToPng(drawTilesWorker *worker, int col, int row, int x, int y)
+{
+    cairo_surface_t *tile;
+    cairo_status_t status;
+    char pngfile[SHAPETOOL_PATHLEN_INVALID * 2];
+
+    drawTileRef ref;
+
+    const drawTilesJob *job = worker->job;
+
+    unsigned char *data = cairo_image_surface_get_data(worker->CDC.surface);
+    int stride = cairo_image_surface_get_stride(worker->CDC.surface);
+    unsigned char *pixels = data + (size_t) row * job->tileSize * stride + (size_t) col * job->tileSize * 4;
+
+    if (job->dedup) {
+        drawTileHash(pixels, stride, job->tileSize, ref.hash);
+
+        if (drawTilesDedupFind(job->dedup, &ref) && drawTileWriteRef(job, &ref, x, y) == 0) {
+            // not encoded again
+            worker->numDupes++;
+            return 0;
+        }
+    }
+
+    tile = cairo_image_surface_create_for_data(pixels, CAIRO_FORMAT_ARGB32, job->tileSize, job->tileSize, stride);
+
+    status = cairo_surface_status(tile);
+    if (status == CAIRO_STATUS_SUCCESS) {
+        if (job->archive) {
+            worker->png.len = 0;
+            status = cairo_surface_write_to_png_stream(tile, drawTilePngWrite, &worker->png);
+
+            if (status == CAIRO_STATUS_SUCCESS &&
+                tileArchiveAppend(job->archive, job->zoom, x, y, worker->png.buf, (ub4) worker->png.len, &ref.offset) != 0) {
+                status = CAIRO_STATUS_WRITE_ERROR;
+            }
+            ref.length = (ub4) worker->png.len;
+        } else {
+            snprintf(pngfile, sizeof(pngfile), "%s/%d/%d/%d.png", job->outDir, job->zoom, x, y);
+
+            // may be a hard link of a previous run
+            remove(pngfile);
+            status = cairo_surface_write_to_png(tile, pngfile);
+        }
+    }
+    cairo_surface_destroy(tile);
+
+    if (status != CAIRO_STATUS_SUCCESS) {
+        printf("Error: failed to write tile: %d/%d/%d\n", job->zoom, x, y);
+        return (-1);
+    }
+
+    if (job->dedup) {
+        ref.z = job->zoom;
+        ref.x = x;
+        ref.y = y;
+        drawTilesDedupAdd(job->dedup, &ref);
+    }
+    return 0;
+}
+
+
+/**
+ * draw metatile (mx, my) of current zoom and write its tiles in range.
+ *   tiles without shapes or inside of one polygon are written as shared
+ *   tiles, and the metatile is drawn only if some tile is left.
+ *   returns number of failed tiles.
+ */
+static int drawMetaTileToPng(drawTilesWorker *worker, int mx, int my)
+{
+    int j, x, y, failed = 0, numDraws = 0;
+    CGBox2D metaBox, lastBox, tileBox;
+
+    drawTileKind metaKind;
+    drawTileKind kinds[DRAWTILES_METATILE_MAX][DRAWTILES_METATILE_MAX];
+
+    drawTilesJob *job = worker->job;
+    cairoDrawCtx *CDC = &worker->CDC;
+
+    const int tx = mx * job->metaSize;
+    const int ty = my * job->metaSize;
+
+    const int x0 = CG_MAX(tx, job->x0);
+    const int y0 = CG_MAX(ty, job->y0);
+    const int x1 = CG_MIN(tx + job->metaSize - 1, job->x1);
+    const int y1 = CG_MIN(ty + job->metaSize - 1, job->y1);
+
+    drawTileBox(&job->gridBox, job->zoom, tx, ty, &metaBox);
+    drawTileBox(&job->gridBox, job->zoom, tx + job->metaSize - 1, ty + job->metaSize - 1, &lastBox);
+
+    metaBox.Xmax = lastBox.Xmax;
+    metaBox.Ymin = lastBox.Ymin;
+
+    // tiles of a metatile without shapes or inside of one polygon are not
+    //   probed one by one
+    metaKind = (job->metaSize > 1 ? drawTileClassify(job, &metaBox, job->metaSize) : tilekind_draw);
+
+    for (x = x0; x <= x1; x++) {
+        for (y = y0; y <= y1; y++) {
+            if (metaKind != tilekind_draw) {
+                kinds[x - tx][y - ty] = metaKind;
+                continue;
+            }
+
+            drawTileBox(&job->gridBox, job->zoom, x, y, &tileBox);
+
+            kinds[x - tx][y - ty] = drawTileClassify(job, &tileBox, 1);
+            if (kinds[x - tx][y - ty] == tilekind_draw) {
+                numDraws++;
+            }
+        }
+    }
+
+    if (numDraws > 0) {
+        drawTileCtxReset(job, &metaBox, CDC);
+
+        for (j = 0; j < job->numLayers; j++) {
+            shapeLayerDraw(&job->layers[j], CDC);
+        }
+
+        cairo_surface_flush(CDC->surface);
+    }
+
+    for (x = x0; x <= x1; x++) {
+        for (y = y0; y <= y1; y++) {
+            switch (kinds[x - tx][y - ty]) {
+            case tilekind_empty:
+                failed += (drawTileWriteShared(job, &job->emptyTile, x, y) != 0);
+                worker->numEmpty++;
+                break;
+
+            case tilekind_solid:
+                failed += (drawTileWriteShared(job, &job->solidTile, x, y) != 0);
+                worker->numSolid++;
+                break;
+
+            default:
+                failed += (drawTileSliceToPng(worker, x - tx, y - ty, x, y) != 0);
+                break;
+            }
+        }
+    }
+
+    return failed;
+}
+
+
+/**
+ * steal half of remaining tiles of the busiest worker. returns 0 if no
+ *   worker has tiles left. no two locks are ever held at once.
+ */
+static int drawTilesSteal(drawTilesWorker *thief)
+{
+    int i, head, tail, left, most;
+    drawTilesWorker *victim;
+    drawTilesJob *job = thief->job;
+
+    for (;;) {
+        victim = 0;
+        most = 0;
+
+        for (i = 0; i < job->numWorkers; i++) {
+            if (&job->workers[i] != thief) {
+                pthread_mutex_lock(&job->workers[i].lock);
+                left = job->workers[i].tail - job->workers[i].head;
+                pthread_mutex_unlock(&job->workers[i].lock);
+
+                if (left > most) {
+                    most = left;
+                    victim = &job->workers[i];
+                }
+            }
+        }
+
+        if (! victim) {
+            return 0;
+        }
+
+        pthread_mutex_lock(&victim->lock);
+        left = victim->tail - victim->head;
+        tail = victim->tail;
+        head = tail - (left + 1) / 2;
+        victim->tail = head;
+        pthread_mutex_unlock(&victim->lock);
+
+        if (head < tail) {
+            pthread_mutex_lock(&thief->lock);
+            thief->head = head;
+            thief->tail = tail;
+            pthread_mutex_unlock(&thief->lock);
+
+            thief->numStolen += tail - head;
+            return 1;
+        }
+
+        // victim ran dry meanwhile, look again
+    }
+}
+
+
+/**
+ * take next tile of worker, or steal if it has none. returns 0 when all
+ *   tiles of zoom are taken.
+ */
+static int drawTilesTake(drawTilesWorker *worker, int *index)
+{
+    do {
+        pthread_mutex_lock(&worker->lock);
+        if (worker->head < worker->tail) {
+            *index = worker->head++;
+            pthread_mutex_unlock(&worker->lock);
+            return 1;
+        }
+        pthread_mutex_unlock(&worker->lock);
+    } while (drawTilesSteal(worker));
+
+    return 0;
+}
+
+
+static void * drawTilesWorkerRun(void *arg)
+{
+    int index, failed;
+
+    drawTilesWorker *worker = (drawTilesWorker *) arg;
+    drawTilesJob *job = worker->job;
+
+    while (drawTilesTake(worker, &index)) {
+        if (worker->ctxMetaSize != job->metaSize) {
+            // metatiles of low zooms are smaller than the grid
+            if (worker->ctxMetaSize) {
+                worker->numSubpixel += worker->CDC.numSubpixel;
+                cairoDrawCtxFinal(&worker->CDC);
+                worker->ctxMetaSize = 0;
+            }
+
+            if (drawTileCtxInit(job, &worker->CDC) != 0) {
+                uatomic_int_add(&job->failedCount);
+                continue;
+            }
+            worker->ctxMetaSize = job->metaSize;
+        }
+
+        failed = drawMetaTileToPng(worker, job->metas[index].x, job->metas[index].y);
+        while (failed-- > 0) {
+            uatomic_int_add(&job->failedCount);
+        }
+
+        worker->numDrawn++;
+    }
+
+    return 0;
+}
+
+
+/**
+ * draw metatiles of job->zoom by workers. each worker starts with a run of
+ *   neighbouring metatiles and steals from others when done.
+ */
+static void drawTilesRunZoom(drawTilesJob *job)
+{
+    int i;
+    drawTilesWorker *workers = job->workers;
+
+    for (i = 0; i < job->numWorkers; i++) {
+        workers[i].head = (int) ((sb8) job->numMetas * i / job->numWorkers);
+        workers[i].tail = (int) ((sb8) job->numMetas * (i + 1) / job->numWorkers);
+        workers[i].numDrawn = 0;
+        workers[i].numStolen = 0;
+        workers[i].numDupes = 0;
+        workers[i].numEmpty = 0;
+        workers[i].numSolid = 0;
+    }
+
+    for (i = 1; i < job->numWorkers; i++) {
+        workers[i].started = 0;
+        if (pthread_create(&workers[i].thread, 0, drawTilesWorkerRun, &workers[i]) != 0) {
+            // its metatiles are stolen by running threads
+            printf("Warn: pthread_create() failed\n");
+            break;
+        }
+        workers[i].started = 1;
+    }
+
+    drawTilesWorkerRun(&workers[0]);
+
+    for (i = 1; i < job->numWorkers; i++) {
+        if (workers[i].started) {
+            pthread_join(workers[i].thread, 0);
+        }
+    }
+}
+
+
+static int drawTilesRun(drawTilesJob *job)
+{
+    int i, z, x, y, numTiles, numStolen, numDupes, numEmpty, numSolid;
+    sb8 elapsed;
+    struct timespec t0, t1;
+    char dir[SHAPETOOL_PATHLEN_INVALID * 2];
+
+    for (z = job->minZoom; z <= job->maxZoom; z++) {
+        if (! drawTileRange(&job->gridBox, z, &job->dataBox, &job->x0, &job->y0, &job->x1, &job->y1)) {
+            printf("Info: zoom %d: no tiles\n", z);
+            continue;
+        }
+
+        job->zoom = z;
+        job->metaSize = CG_MIN(job->metaTile, 1 << z);
+
+        for (x = job->x0; x <= job->x1 && ! job->archive; x++) {
+            snprintf(dir, sizeof(dir), "%s/%d/%d", job->outDir, z, x);
+            if (drawTilesMakeDirs(dir) != 0) {
+                return (-1);
+            }
+        }
+
+        numTiles = (job->x1 - job->x0 + 1) * (job->y1 - job->y0 + 1);
+
+        job->numMetas = 0;
+        job->metas = (drawTileXY *) mem_realloc(job->metas, sizeof(drawTileXY) *
+            (job->x1 / job->metaSize - job->x0 / job->metaSize + 1) * (job->y1 / job->metaSize - job->y0 / job->metaSize + 1));
+
+        for (x = job->x0 / job->metaSize; x <= job->x1 / job->metaSize; x++) {
+            for (y = job->y0 / job->metaSize; y <= job->y1 / job->metaSize; y++) {
+                job->metas[job->numMetas].x = x;
+                job->metas[job->numMetas].y = y;
+                job->numMetas++;
+            }
+        }
+
+        getnowtimeofday(&t0);
+
+        drawTilesRunZoom(job);
+
+        getnowtimeofday(&t1);
+        elapsed = CG_MAX(1, difftime_msec(&t0, &t1));
+
+        numStolen = 0;
+        numDupes = 0;
+        numEmpty = 0;
+        numSolid = 0;
+        for (i = 0; i < job->numWorkers; i++) {
+            numStolen += job->workers[i].numStolen;
+            numDupes += job->workers[i].numDupes;
+            numEmpty += job->workers[i].numEmpty;
+            numSolid += job->workers[i].numSolid;
+        }
+
+        job->numWritten += numTiles;
+        job->numDupes += numDupes;
+        job->numEmpty += numEmpty;
+        job->numSolid += numSolid;
+
+        printf("Info: zoom %d: %d tiles (x=%d-%d, y=%d-%d) of %d metatiles in %.3f s, %.1f tiles/sec, %d stolen, %d duplicates, %d empty, %d solid\n",
+            z, numTiles, job->x0, job->x1, job->y0, job->y1, job->numMetas, elapsed / 1000.0, numTiles * 1000.0 / elapsed, numStolen, numDupes, numEmpty, numSolid);
+
+        if (uatomic_int_get(&job->failedCount)) {
+            printf("Error: %d of %d tiles failed\n", (int) uatomic_int_get(&job->failedCount), numTiles);
+            return (-1);
+        }
+    }
+
+    return 0;
+}
+
+
+int layers2tiles(shapetool_flags *flags, shapetool_options *options)
+{
+    int ret = SHAPETOOL_RES_ERR;
+
+    drawTilesJob job;
+    tileArchiveWriter archive;
+    drawTilesDedup dedup;
+
+    shapeReadOpts readOpts = {
+        .readMode = (shapeReadMode) options->readmode,
+        .readAhead = options->readahead,
+        .decoders = options->decoders,
+        .geomCache = 0,
+        // positioned reads can be shared by threads, SHPReadObjectEx cannot
+        .xyOnly = (options->xyonly || options->threads > 1)
+    };
+
+    bzero(&job, sizeof(job));
+
+    if (flags->shpfile) {
+        // one layer: file:///path/to/some.shp, file:///path/to/some_*.shp or manifest
+        job.layers = (shapeLayer *) mem_alloc_zero(1, sizeof(shapeLayer));
+        if (shapeLayerOpen(job.layers, CSTR_FILE_URI_PATH(options->shpfile), &readOpts) == 0) {
+            job.numLayers = 1;
+        }
+    } else {
+        job.numLayers = maplayersOpen(CSTR_FILE_URI_PATH(options->layerscfg), options->mapid->str, options->mapid->len, &readOpts, &job.layers);
+    }
+
+    if (maplayersBounds(job.layers, job.numLayers, &job.dataBox) == 0) {
+        printf("Error: no layer to draw tiles\n");
+        maplayersClose(job.layers, job.numLayers);
+        return SHAPETOOL_RES_ERR;
+    }
+
+    if (options->geomcache > 0) {
+        readOpts.geomCache = shpGeomCacheCreate((size_t) options->geomcache * 1024 * 1024);
+        for (int j = 0; j < job.numLayers; j++) {
+            job.layers[j].readOpts.geomCache = readOpts.geomCache;
+        }
+    }
+
+    drawTileGridBox((drawTileGrid) options->tilegrid, &job.dataBox, &job.gridBox);
+
+    job.tileSize = options->tilesize;
+    job.metaTile = options->metatile;
+    job.buffer = options->tilebuffer;
+    job.minZoom = options->minzoom;
+    job.maxZoom = options->maxzoom;
+    job.outDir = (flags->outdir ? CSTR_FILE_URI_PATH(options->outdir) : 0);
+    job.options = options;
+
+    job.numWorkers = CG_MAX(1, CG_MIN(options->threads, DRAWBANDS_THREADS_MAX));
+    job.workers = (drawTilesWorker *) mem_alloc_zero(job.numWorkers, sizeof(drawTilesWorker));
+    for (int i = 0; i < job.numWorkers; i++) {
+        job.workers[i].job = &job;
+        pthread_mutex_init(&job.workers[i].lock, 0);
+    }
+    uatomic_int_zero(&job.failedCount);
+
+    if (options->dedupe) {
+        bzero(&dedup, sizeof(dedup));
+        pthread_mutex_init(&dedup.lock, 0);
+        dedup.capacity = DRAWTILES_DEDUP_CAPACITY;
+        dedup.refs = (drawTileRef *) mem_alloc_zero((int) dedup.capacity, sizeof(drawTileRef));
+        job.dedup = &dedup;
+    }
+
+    pthread_mutex_init(&job.sharedLock, 0);
+    for (int j = 0; j < job.numLayers; j++) {
+        if (job.layers[j].nShpTypeMask == SHAPE_TYPE_POLYGON) {
+            job.hasPolygons = 1;
+        }
+    }
+
+    if (job.numWorkers > 1) {
+        // open shards of grid ahead, so that workers do not wait to open them
+        Viewport2D gridVp;
+        CGBox2D gridView = { .Xmin = 0, .Ymin = 0, .Xmax = job.tileSize, .Ymax = job.tileSize };
+        CGSize2D gridDPI = { options->dpi, options->dpi };
+
+        ViewportInitExact(&gridVp, job.gridBox, gridView, gridDPI);
+        for (int j = 0; j < job.numLayers; j++) {
+            shapeLayerPrepare(&job.layers[j], &gridVp);
+        }
+    }
+
+    if (drawTileSharedInit(&job, &job.emptyTile, 0) != 0 ||
+        (job.hasPolygons && drawTileSharedInit(&job, &job.solidTile, 1) != 0)) {
+        ret = SHAPETOOL_RES_ERR;
+    } else if (flags->archive) {
+        if (tileArchiveCreate(&archive, CSTR_FILE_URI_PATH(options->archive), &job.gridBox, job.tileSize, job.minZoom, job.maxZoom) == 0) {
+            job.archive = &archive;
+
+            ret = (drawTilesRun(&job) == 0 ? SHAPETOOL_RES_SOK : SHAPETOOL_RES_ERR);
+
+            if (tileArchiveFinish(&archive, ret == SHAPETOOL_RES_SOK) != 0) {
+                ret = SHAPETOOL_RES_ERR;
+            }
+        }
+    } else if (drawTilesMakeDirs(job.outDir) == 0 && drawTilesRun(&job) == 0) {
+        ret = SHAPETOOL_RES_SOK;
+    }
+
+    for (int i = 0; i < job.numWorkers; i++) {
+        if (job.workers[i].ctxMetaSize) {
+            job.workers[i].numSubpixel += job.workers[i].CDC.numSubpixel;
+            cairoDrawCtxFinal(&job.workers[i].CDC);
+        }
+        job.numSubpixel += job.workers[i].numSubpixel;
+        mem_free(job.workers[i].png.buf);
+        pthread_mutex_destroy(&job.workers[i].lock);
+    }
+    mem_free(job.workers);
+    mem_free(job.metas);
+    mem_free(job.emptyTile.png.buf);
+    mem_free(job.solidTile.png.buf);
+    pthread_mutex_destroy(&job.sharedLock);
+
+    if (job.numEmpty || job.numSolid) {
+        printf("Info: %" PRId64 " empty and %" PRId64 " solid of %" PRId64 " tiles are not drawn\n",
+            job.numEmpty, job.numSolid, job.numWritten);
+    }
+
+    if (job.numSubpixel) {
+        printf("Info: %" PRId64 " sub-pixel features elided\n", job.numSubpixel);
+    }
+
+    if (job.dedup) {
+        printf("Info: dedupe: %" PRId64 " of %" PRId64 " tiles are duplicates (%.1f%%), %" PRId64 " unique\n",
+            job.numDupes, job.numWritten, job.numWritten ? job.numDupes * 100.0 / job.numWritten : 0.0, dedup.count);
+        mem_free(dedup.refs);
+        pthread_mutex_destroy(&dedup.lock);
+    }
+
+    maplayersClose(job.layers, job.numLayers);
+
+    if (readOpts.geomCache) {
+        shpGeomCachePrintStats(readOpts.geomCache);
+        shpGeomCacheDestroy(readOpts.geomCache);
+    }
+
+    return ret;
+}
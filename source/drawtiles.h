@@ -0,0 +1,157 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file drawtiles.h
+ * @brief draw layers into a pyramid of XYZ tiles.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.4
+ *
+ * @since 2024-10-23 10:26:15
+ * @date 2024-10-23 21:36:12
+ *
+ * @note
+ *   Tile 0/0/0 covers the whole grid box. Tile z/x/y is one of 2^z x 2^z
+ *   tiles, x from west to east, y from north to south:
+ *
+ *     tilegrid_data       square box around the extent of layers
+ *     tilegrid_mercator   web mercator (EPSG:3857), data must be in meters
+ *
+ *   Layers, styles and indexes are loaded once for all tiles.
+ *
+ *   With --threads N, tiles of a zoom are dealt to N workers in runs of
+ *   neighbouring tiles. Each worker reuses one draw context for its tiles,
+ *   and a worker out of tiles steals half of what the busiest one has left.
+ *
+ *   With --metatile M, M x M tiles are drawn as one surface and then sliced
+ *   into tiles, so shapes across inner tile edges are built into paths only
+ *   once. Metatiles are aligned to multiples of M (e.g. tiles x=8..15 make
+ *   up metatile 1 when M is 8) and are never larger than the zoom's grid.
+ *
+ *   Before drawing, envelopes of shapes are probed by the spatial index.
+ *   Tiles with no shape in tile and buffer are written as one shared empty
+ *   tile, and tiles inside of a single polygon as one shared solid tile,
+ *   without drawing or encoding. Shared tiles are written in full once and
+ *   then referenced: an entry of the same blob in archive, or a hard link.
+ */
+#ifndef DRAW_TILES_H__
+#define DRAW_TILES_H__
+
+#ifdef    __cplusplus
+extern "C" {
+#endif
+
+#include "drawlayers.h"
+
+
+#define DRAWTILES_ZOOM_MAX        22
+
+#define DRAWTILES_SIZE_DEFAULT    256
+
+// culling margin of tile in dots, so that strokes across tile edges are drawn
+#define DRAWTILES_MARGIN          16
+
+#define DRAWTILES_BUFFER_MAX      256
+
+// max tiles per side of metatile
+#define DRAWTILES_METATILE_MAX    16
+
+// half extent of web mercator in meters
+#define DRAWTILES_MERCATOR_HALF   20037508.342789244
+
+
+typedef enum
+{
+    tilegrid_data = 0,
+    tilegrid_mercator
+} drawTileGrid;
+
+
+/**
+ * box of tile 0/0/0 for extent of data
+ */
+STATIC_INLINE void drawTileGridBox(drawTileGrid grid, const CGBox2D *dataBox, CGBox2D *gridBox)
+{
+    double half;
+
+    if (grid == tilegrid_mercator) {
+        gridBox->Xmin = gridBox->Ymin = -DRAWTILES_MERCATOR_HALF;
+        gridBox->Xmax = gridBox->Ymax = DRAWTILES_MERCATOR_HALF;
+        return;
+    }
+
+    half = CG_MAX(dataBox->Xmax - dataBox->Xmin, dataBox->Ymax - dataBox->Ymin) * 0.5;
+    if (half <= 0) {
+        // a single point
+        half = 0.5;
+    }
+
+    gridBox->Xmin = (dataBox->Xmin + dataBox->Xmax) * 0.5 - half;
+    gridBox->Xmax = (dataBox->Xmin + dataBox->Xmax) * 0.5 + half;
+    gridBox->Ymin = (dataBox->Ymin + dataBox->Ymax) * 0.5 - half;
+    gridBox->Ymax = (dataBox->Ymin + dataBox->Ymax) * 0.5 + half;
+}
+
+
+/**
+ * data box of tile z/x/y
+ */
+STATIC_INLINE void drawTileBox(const CGBox2D *gridBox, int z, int x, int y, CGBox2D *tileBox)
+{
+    double size = ldexp(gridBox->Xmax - gridBox->Xmin, -z);
+
+    tileBox->Xmin = gridBox->Xmin + size * x;
+    tileBox->Xmax = gridBox->Xmin + size * (x + 1);
+    tileBox->Ymax = gridBox->Ymax - size * y;
+    tileBox->Ymin = gridBox->Ymax - size * (y + 1);
+}
+
+
+/**
+ * tiles [x0, x1] x [y0, y1] of zoom z which overlap dataBox.
+ *   returns 0 if dataBox is out of grid.
+ */
+STATIC_INLINE int drawTileRange(const CGBox2D *gridBox, int z, const CGBox2D *dataBox, int *x0, int *y0, int *x1, int *y1)
+{
+    const int n = 1 << z;
+    const double size = ldexp(gridBox->Xmax - gridBox->Xmin, -z);
+
+    // inclusive, so that single points are not lost
+    if (dataBox->Xmin > gridBox->Xmax || dataBox->Xmax < gridBox->Xmin ||
+        dataBox->Ymin > gridBox->Ymax || dataBox->Ymax < gridBox->Ymin) {
+        return 0;
+    }
+
+    *x0 = (int) CG_MAX(0, floor((dataBox->Xmin - gridBox->Xmin) / size));
+    *x1 = (int) CG_MIN(n - 1, floor((dataBox->Xmax - gridBox->Xmin) / size));
+    *y0 = (int) CG_MAX(0, floor((gridBox->Ymax - dataBox->Ymax) / size));
+    *y1 = (int) CG_MIN(n - 1, floor((gridBox->Ymax - dataBox->Ymin) / size));
+
+    return (*x0 <= *x1 && *y0 <= *y1);
+}
+
+#ifdef    __cplusplus
+}
+#endif
+#endif /* DRAW_TILES_H__ */
@@ -0,0 +1,149 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shapegeom.h
+ * @brief read-only geometry view of one shape record.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.4
+ *
+ * @since 2024-10-18 09:12:40
+ * @date 2024-10-24 14:05:00
+ *
+ * @note
+ *   A shapeGeomView never owns its arrays. They point either into a
+ *   SHPObjectEx read buffer or straight into the mapped .shp pages.
+ *
+ *   Records of .shp are only 2-byte aligned, so views read part starts and
+ *   X/Y through types of alignment 1. Targets which load unaligned words
+ *   (x86, x64, ARM64) read the mapped pages in place; the others get an
+ *   aligned copy from the readers (SHAPEGEOM_UNALIGNED_OK undefined).
+ */
+#ifndef SHAPE_GEOM_H__
+#define SHAPE_GEOM_H__
+
+#ifdef    __cplusplus
+extern "C" {
+#endif
+
+#include <shapefile/shapefile_api.h>
+
+#include <common/cgtypes.h>
+#include <common/cgclip.h>
+
+
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) || \
+    defined(_M_X64) || defined(_M_IX86) || defined(_M_ARM64)
+#   define SHAPEGEOM_UNALIGNED_OK   1
+#endif
+
+#if defined(_MSC_VER)
+#   define SHAPEGEOM_UNALIGNED      __unaligned
+typedef int shapeGeomInt;
+typedef SHPPointType shapeGeomPoint;
+#else
+#   define SHAPEGEOM_UNALIGNED
+typedef int shapeGeomInt __attribute__((aligned(1)));
+typedef SHPPointType shapeGeomPoint __attribute__((aligned(1)));
+#endif
+
+
+typedef struct
+{
+    int nShapeId;
+
+    int nParts;
+    int nPoints;
+
+    // start index of points for each part (nParts items)
+    const shapeGeomInt SHAPEGEOM_UNALIGNED *panPartStart;
+
+    // X,Y pairs of all parts (nPoints items)
+    const shapeGeomPoint SHAPEGEOM_UNALIGNED *pPoints;
+} shapeGeomView;
+
+
+/**
+ * end index (exclusive) of points of given part
+ */
+#define ShapeGeomPartEnd(view, part)  \
+    ((part) + 1 < (view)->nParts ? (view)->panPartStart[(part) + 1] : (view)->nPoints)
+
+
+/**
+ * make a view over a SHPObjectEx which read by SHPReadObjectEx()
+ */
+static void shapeGeomViewFromObject(const SHPObjectEx *hShpRef, int nShapeId, shapeGeomView *view)
+{
+    view->nShapeId = nShapeId;
+    view->nParts = hShpRef->nParts;
+    view->nPoints = (hShpRef->nParts > 0 ? hShpRef->panPartStart[hShpRef->nParts] : 0);
+    view->panPartStart = hShpRef->panPartStart;
+    view->pPoints = hShpRef->pPoints;
+}
+
+
+/**
+ * test if polygon covers box: no edge of rings touches box and center of
+ *   box is inside by even-odd rule. returns 0 if not. part starts of view
+ *   are trusted, readers check them by shpFileCheckPartStarts().
+ */
+static int shapeGeomViewCoversBox(const shapeGeomView *view, const CGBox2D *box)
+{
+    int part, k, start, end, inside = 0;
+    CGPoint2D A, B;
+
+    const double cx = (box->Xmin + box->Xmax) * 0.5;
+    const double cy = (box->Ymin + box->Ymax) * 0.5;
+
+    for (part = 0; part < view->nParts; part++) {
+        start = view->panPartStart[part];
+        end = ShapeGeomPartEnd(view, part);
+
+        for (k = start; k < end; k++) {
+            // closing edge of ring if last point is not first
+            const shapeGeomPoint SHAPEGEOM_UNALIGNED *P = &view->pPoints[k];
+            const shapeGeomPoint SHAPEGEOM_UNALIGNED *Q = &view->pPoints[k + 1 < end ? k + 1 : start];
+
+            A.X = P->x; A.Y = P->y;
+            B.X = Q->x; B.Y = Q->y;
+
+            if (CGClipSegmentToBox(&A, &B, box)) {
+                return 0;
+            }
+
+            // crossings of ray from center to +X
+            if ((P->y > cy) != (Q->y > cy) && cx < (Q->x - P->x) * (cy - P->y) / (Q->y - P->y) + P->x) {
+                inside = ! inside;
+            }
+        }
+    }
+
+    return inside;
+}
+
+#ifdef    __cplusplus
+}
+#endif
+#endif /* SHAPE_GEOM_H__ */
@@ -0,0 +1,491 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shapelayer.c
+ * @brief logical layer of one or many shape files (shards).
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.4
+ *
+ * @since 2024-10-20 17:26:40
+ * @date 2024-10-24 11:05:18
+ *
+ * @note
+ */
+#include "shapetool-common.h"
+#include "shapelayer.h"
+
+#include <common/memapi.h>
+
+#if defined(WIN32API)
+#   include <Windows.h>
+#else
+#   include <glob.h>
+#endif
+
+
+/**
+ * SHAPE_TYPE_* mask of shp type in file header
+ */
+static int shapeLayerTypeMask(int nShapeType)
+{
+    switch (nShapeType) {
+    case 1: case 11: case 21:
+    case 8: case 18: case 28:
+        return SHAPE_TYPE_POINT;
+
+    case 3: case 13: case 23:
+        return SHAPE_TYPE_LINE;
+
+    case 5: case 15: case 25:
+    case 31:
+        return SHAPE_TYPE_POLYGON;
+    }
+    return SHAPE_TYPE_NIL;
+}
+
+
+static int shapeLayerShardCompare(const void *a, const void *b)
+{
+    return strcmp(((const shapeLayerShard *) a)->shpfile, ((const shapeLayerShard *) b)->shpfile);
+}
+
+
+/**
+ * sort shards [first, numShards) added by one pattern by path, so that
+ *   draw order does not depend on directory listing or platform.
+ */
+static void shapeLayerSortShards(shapeLayer *layer, int first)
+{
+    if (layer->numShards - first > 1) {
+        qsort(layer->shards + first, layer->numShards - first, sizeof(shapeLayerShard), shapeLayerShardCompare);
+    }
+}
+
+
+/**
+ * read header of shard and append it. returns 0 on success.
+ */
+static int shapeLayerAddShard(shapeLayer *layer, const char *shpfile, int *capacity)
+{
+    shapeLayerShard *shard;
+    int typeMask;
+
+    if (layer->numShards == SHAPELAYER_SHARDS_MAX) {
+        printf("Error: too many shards: %s\n", shpfile);
+        return (-1);
+    }
+
+    if (layer->numShards == *capacity) {
+        *capacity = (*capacity < 64 ? 64 : *capacity * 2);
+        layer->shards = (shapeLayerShard *) mem_realloc(layer->shards, sizeof(shapeLayerShard) * (*capacity));
+    }
+
+    shard = &layer->shards[layer->numShards];
+    bzero(shard, sizeof(shapeLayerShard));
+
+    if (snprintf(shard->shpfile, sizeof(shard->shpfile), "%s", shpfile) >= (int) sizeof(shard->shpfile)) {
+        printf("Warn: path too long, shard ignored: %s\n", shpfile);
+        return 0;
+    }
+
+    if (shpFileReadHeader(shpfile, &shard->header) != 0) {
+        printf("Warn: shard ignored: %s\n", shpfile);
+        return 0;
+    }
+
+    typeMask = shapeLayerTypeMask(shard->header.nShapeType);
+    if (typeMask == SHAPE_TYPE_NIL) {
+        printf("Warn: bad shp type(%d), shard ignored: %s\n", shard->header.nShapeType, shpfile);
+        return 0;
+    }
+    if (layer->numShards > 0 && typeMask != layer->nShpTypeMask) {
+        printf("Warn: shp type(%d) mismatch layer, shard ignored: %s\n", shard->header.nShapeType, shpfile);
+        return 0;
+    }
+
+    layer->nShpTypeMask = typeMask;
+    layer->numShards++;
+
+    return 0;
+}
+
+
+#if defined(WIN32API)
+static int shapeLayerGlob(shapeLayer *layer, const char *pattern, int *capacity)
+{
+    WIN32_FIND_DATAA fd;
+    HANDLE hFind;
+    char pathbuf[260];
+    int first = layer->numShards;
+
+    // directory part of pattern
+    const char *slash = strrchr(pattern, '/');
+    const char *bslash = strrchr(pattern, '\\');
+    int dirlen = (int) (CG_MAX(slash, bslash) ? CG_MAX(slash, bslash) - pattern + 1 : 0);
+
+    hFind = FindFirstFileA(pattern, &fd);
+    if (hFind == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    do {
+        if (! (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            snprintf(pathbuf, sizeof(pathbuf), "%.*s%s", dirlen, pattern, fd.cFileName);
+            if (shapeLayerAddShard(layer, pathbuf, capacity) != 0) {
+                FindClose(hFind);
+                return (-1);
+            }
+        }
+    } while (FindNextFileA(hFind, &fd));
+
+    FindClose(hFind);
+
+    // FindFirstFile lists in directory order
+    shapeLayerSortShards(layer, first);
+    return 0;
+}
+#else
+static int shapeLayerGlob(shapeLayer *layer, const char *pattern, int *capacity)
+{
+    size_t i;
+    glob_t gl;
+    int first = layer->numShards;
+
+    int ret = glob(pattern, 0, 0, &gl);
+    if (ret == GLOB_NOMATCH) {
+        return 0;
+    }
+    if (ret != 0) {
+        printf("Error: glob() failed(%d): %s\n", ret, pattern);
+        return (-1);
+    }
+
+    for (i = 0; i < gl.gl_pathc; i++) {
+        if (shapeLayerAddShard(layer, gl.gl_pathv[i], capacity) != 0) {
+            globfree(&gl);
+            return (-1);
+        }
+    }
+
+    globfree(&gl);
+
+    // glob() sorts by collation of locale
+    shapeLayerSortShards(layer, first);
+    return 0;
+}
+#endif
+
+
+static int shapeLayerReadManifest(shapeLayer *layer, const char *manifest, int *capacity)
+{
+    char line[260], pathbuf[520];
+    char *path, *end;
+    int dirlen;
+
+    const char *slash = strrchr(manifest, '/');
+    const char *bslash = strrchr(manifest, '\\');
+
+    FILE *fp = fopen(manifest, "r");
+    if (! fp) {
+        printf("Error: Cannot open manifest: %s\n", manifest);
+        return (-1);
+    }
+
+    dirlen = (int) (CG_MAX(slash, bslash) ? CG_MAX(slash, bslash) - manifest + 1 : 0);
+
+    while (fgets(line, sizeof(line), fp)) {
+        // trim spaces
+        path = line;
+        while (*path && isspace((ub1) *path)) {
+            path++;
+        }
+        end = path + strlen(path);
+        while (end > path && isspace((ub1) end[-1])) {
+            *--end = '\0';
+        }
+
+        if (*path == '\0' || *path == '#') {
+            continue;
+        }
+
+        if (path[0] == '/' || path[0] == '\\' || (isalpha((ub1) path[0]) && path[1] == ':')) {
+            snprintf(pathbuf, sizeof(pathbuf), "%s", path);
+        } else {
+            snprintf(pathbuf, sizeof(pathbuf), "%.*s%s", dirlen, manifest, path);
+        }
+
+        if (shapeLayerIsPattern(pathbuf)) {
+            if (shapeLayerGlob(layer, pathbuf, capacity) != 0) {
+                fclose(fp);
+                return (-1);
+            }
+        } else if (shapeLayerAddShard(layer, pathbuf, capacity) != 0) {
+            fclose(fp);
+            return (-1);
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+
+int shapeLayerOpen(shapeLayer *layer, const char *filespec, const shapeReadOpts *readOpts)
+{
+    int i, ret, capacity = 0;
+    int len = (int) strlen(filespec);
+
+    bzero(layer, sizeof(shapeLayer));
+    pthread_mutex_init(&layer->lock, 0);
+    layer->readOpts = *readOpts;
+
+    if (shapeLayerIsPattern(filespec)) {
+        ret = shapeLayerGlob(layer, filespec, &capacity);
+    } else if (len > 4 && (!strcmp(filespec + len - 4, ".shp") || !strcmp(filespec + len - 4, ".SHP"))) {
+        ret = shapeLayerAddShard(layer, filespec, &capacity);
+    } else {
+        ret = shapeLayerReadManifest(layer, filespec, &capacity);
+    }
+
+    if (ret != 0 || layer->numShards == 0) {
+        if (ret == 0) {
+            printf("Error: no shp file found: %s\n", filespec);
+        }
+        shapeLayerClose(layer);
+        return (-1);
+    }
+
+    layer->bounds.Xmin = layer->bounds.Ymin = DBL_MAX;
+    layer->bounds.Xmax = layer->bounds.Ymax = -DBL_MAX;
+
+    for (i = 0; i < layer->numShards; i++) {
+        const shpFileHeader *header = &layer->shards[i].header;
+
+        layer->nEntities += header->nEntities;
+
+        if (header->nEntities > 0) {
+            layer->bounds.Xmin = CG_MIN(layer->bounds.Xmin, header->minBounds[0]);
+            layer->bounds.Ymin = CG_MIN(layer->bounds.Ymin, header->minBounds[1]);
+            layer->bounds.Xmax = CG_MAX(layer->bounds.Xmax, header->maxBounds[0]);
+            layer->bounds.Ymax = CG_MAX(layer->bounds.Ymax, header->maxBounds[1]);
+        }
+    }
+
+    if (layer->bounds.Xmin > layer->bounds.Xmax) {
+        // all shards are empty
+        bzero(&layer->bounds, sizeof(layer->bounds));
+    }
+
+    if (layer->numShards > 1) {
+        printf("Info: layer of %d shards (records=%d): %s\n", layer->numShards, layer->nEntities, filespec);
+    }
+    return 0;
+}
+
+
+void shapeLayerClose(shapeLayer *layer)
+{
+    int i;
+
+    for (i = 0; i < layer->numShards; i++) {
+        if (layer->shards[i].shpInfo) {
+            shapeFileInfoClose(layer->shards[i].shpInfo);
+            mem_free(layer->shards[i].shpInfo);
+        }
+    }
+
+    if (layer->shards) {
+        mem_free(layer->shards);
+    }
+
+    pthread_mutex_destroy(&layer->lock);
+    bzero(layer, sizeof(shapeLayer));
+}
+
+
+/**
+ * close least recently used shard which no draw is using. caller holds
+ *   layer->lock. returns 0 if every open shard is in use.
+ */
+static int shapeLayerCloseIdle(shapeLayer *layer)
+{
+    int i;
+    shapeLayerShard *lru = 0;
+
+    for (i = 0; i < layer->numShards; i++) {
+        shapeLayerShard *shard = &layer->shards[i];
+
+        if (shard->shpInfo && ! shard->users && (! lru || shard->lastUsed < lru->lastUsed)) {
+            lru = shard;
+        }
+    }
+
+    if (! lru) {
+        return 0;
+    }
+
+    shapeFileInfoClose(lru->shpInfo);
+    mem_free(lru->shpInfo);
+    lru->shpInfo = 0;
+    layer->numOpen--;
+
+    return 1;
+}
+
+
+/**
+ * open shard if it overlaps dataBox and hold it open until
+ *   shapeLayerReleaseShard. returns 0 if not visible or failed.
+ */
+static shapeFileInfo * shapeLayerAcquireShard(shapeLayer *layer, shapeLayerShard *shard, const CGBox2D *dataBox)
+{
+    shapeFileInfo *shpInfo;
+    const shpFileHeader *header = &shard->header;
+
+    if (header->nEntities == 0) {
+        return 0;
+    }
+
+    // inclusive test so that single point shards are not lost
+    if (header->minBounds[0] > dataBox->Xmax || header->minBounds[1] > dataBox->Ymax ||
+        header->maxBounds[0] < dataBox->Xmin || header->maxBounds[1] < dataBox->Ymin) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&layer->lock);
+
+    if (! shard->shpInfo && ! shard->failed) {
+        if (layer->numOpen >= SHAPELAYER_OPEN_MAX) {
+            // more than max stay open if all are in use
+            shapeLayerCloseIdle(layer);
+        }
+
+        shard->shpInfo = (shapeFileInfo *) mem_alloc_zero(1, sizeof(shapeFileInfo));
+
+        if (shapeFileInfoOpen(shard->shpInfo, shard->shpfile, &layer->readOpts) != 0) {
+            mem_free(shard->shpInfo);
+            shard->shpInfo = 0;
+            shard->failed = 1;
+        } else {
+            layer->numOpen++;
+            layer->numOpened++;
+        }
+    }
+
+    shpInfo = shard->shpInfo;
+    if (shpInfo) {
+        shard->users++;
+        shard->lastUsed = ++layer->useTick;
+    }
+
+    pthread_mutex_unlock(&layer->lock);
+
+    return shpInfo;
+}
+
+
+static void shapeLayerReleaseShard(shapeLayer *layer, shapeLayerShard *shard)
+{
+    pthread_mutex_lock(&layer->lock);
+    shard->users--;
+    pthread_mutex_unlock(&layer->lock);
+}
+
+
+int shapeLayerPrepare(shapeLayer *layer, const Viewport2D *vp)
+{
+    int i, numOpen = 0;
+    CGBox2D dataBox;
+
+    ViewToDataBox(vp, vp->viewBox, &dataBox);
+
+    for (i = 0; i < layer->numShards && numOpen < SHAPELAYER_OPEN_MAX; i++) {
+        if (shapeLayerAcquireShard(layer, &layer->shards[i], &dataBox)) {
+            shapeLayerReleaseShard(layer, &layer->shards[i]);
+            numOpen++;
+        }
+    }
+
+    return numOpen;
+}
+
+
+int shapeLayerProbe(shapeLayer *layer, const CGBox2D *dataBox, int maxFound)
+{
+    int i, nShapeId, numFound = 0;
+    shapeFileInfo *shpInfo;
+
+    for (i = 0; i < layer->numShards && numFound < maxFound; i++) {
+        shpInfo = shapeLayerAcquireShard(layer, &layer->shards[i], dataBox);
+        if (shpInfo) {
+            numFound += shapeFileInfoProbe(shpInfo, dataBox, maxFound - numFound, &nShapeId);
+            shapeLayerReleaseShard(layer, &layer->shards[i]);
+        }
+    }
+
+    return numFound;
+}
+
+
+int shapeLayerCoversBox(shapeLayer *layer, const CGBox2D *dataBox, const CGBox2D *coverBox)
+{
+    int i, nShapeId, covers = 0;
+    shapeFileInfo *shpInfo;
+
+    for (i = 0; i < layer->numShards; i++) {
+        shpInfo = shapeLayerAcquireShard(layer, &layer->shards[i], dataBox);
+        if (shpInfo) {
+            if (shapeFileInfoProbe(shpInfo, dataBox, 1, &nShapeId) > 0) {
+                covers = shapeFileInfoCoversBox(shpInfo, nShapeId, coverBox);
+                shapeLayerReleaseShard(layer, &layer->shards[i]);
+                break;
+            }
+            shapeLayerReleaseShard(layer, &layer->shards[i]);
+        }
+    }
+
+    return covers;
+}
+
+
+int shapeLayerDraw(shapeLayer *layer, cairoDrawCtx *CDC)
+{
+    int i, numDrawn = 0;
+    CGBox2D dataBox;
+    shapeFileInfo *shpInfo;
+
+    ViewToDataBox(&CDC->viewport, CDC->viewport.viewBox, &dataBox);
+
+    for (i = 0; i < layer->numShards; i++) {
+        shpInfo = shapeLayerAcquireShard(layer, &layer->shards[i], &dataBox);
+        if (shpInfo) {
+            shapeFileInfoDraw(shpInfo, CDC);
+            shapeLayerReleaseShard(layer, &layer->shards[i]);
+            numDrawn++;
+        }
+    }
+
+    return numDrawn;
+}
@@ -0,0 +1,154 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shapelayer.h
+ * @brief logical layer of one or many shape files (shards).
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.4
+ *
+ * @since 2024-10-20 17:26:40
+ * @date 2024-10-24 11:05:18
+ *
+ * @note
+ *   A layer file spec may be:
+ *     /path/to/a.shp           one shape file
+ *     /path/to/states_*.shp    all shape files matching the glob pattern
+ *     /path/to/shards.txt      manifest: one shp path or pattern per line,
+ *                              '#' comments, relative to manifest dir
+ *
+ *   Only the 100-byte headers of .shp/.shx are read when the layer opens.
+ *   A shard is opened at its first draw whose viewport overlaps its header
+ *   bounds, so shards out of view are never opened. At most
+ *   SHAPELAYER_OPEN_MAX shards are kept open: beyond it the least recently
+ *   used shard which no draw is using is closed, and opened again if it is
+ *   drawn later. Shards are opened, used and closed under the layer lock,
+ *   so threads may draw the same layer.
+ */
+#ifndef SHAPE_LAYER_H__
+#define SHAPE_LAYER_H__
+
+#ifdef    __cplusplus
+extern "C" {
+#endif
+
+#include "drawshape.h"
+
+
+#define SHAPELAYER_SHARDS_MAX   65536
+
+// shards kept open at once, unless more are being drawn at the same time
+#define SHAPELAYER_OPEN_MAX     64
+
+
+typedef struct
+{
+    char shpfile[256];
+
+    shpFileHeader header;
+
+    // not null once opened
+    shapeFileInfo *shpInfo;
+
+    // 1 if open failed, never retried
+    int failed;
+
+    // draws using shpInfo now: never closed while > 0
+    int users;
+
+    // tick of layer at last use, least recently used is closed first
+    sb8 lastUsed;
+} shapeLayerShard;
+
+
+typedef struct
+{
+    shapeReadOpts readOpts;
+
+    int nShpTypeMask;
+
+    // records of all shards
+    int nEntities;
+
+    // merged extent of shards from headers
+    CGBox2D bounds;
+
+    int numShards;
+    shapeLayerShard *shards;
+
+    // guards opening, closing and users of shards
+    pthread_mutex_t lock;
+    sb8 useTick;
+
+    // shards open now, and opened so far
+    int numOpen;
+    int numOpened;
+} shapeLayer;
+
+
+/**
+ * test if file spec of layer is a pattern of shape files
+ */
+STATIC_INLINE int shapeLayerIsPattern(const char *filespec)
+{
+    return (strpbrk(filespec, "*?") ? 1 : 0);
+}
+
+/**
+ * open layer from file spec. only headers of shards are read.
+ * returns 0 on success.
+ */
+extern int shapeLayerOpen(shapeLayer *layer, const char *filespec, const shapeReadOpts *readOpts);
+
+extern void shapeLayerClose(shapeLayer *layer);
+
+/**
+ * open shards which overlap viewport ahead of drawing, up to
+ *   SHAPELAYER_OPEN_MAX, so that threads do not wait on each other to
+ *   open them. returns number of shards open in viewport.
+ */
+extern int shapeLayerPrepare(shapeLayer *layer, const Viewport2D *vp);
+
+/**
+ * draw shards which overlap viewport of CDC, in order of shards.
+ * returns number of shards drawn.
+ */
+extern int shapeLayerDraw(shapeLayer *layer, cairoDrawCtx *CDC);
+
+/**
+ * count shapes of layer whose envelopes overlap dataBox, up to maxFound,
+ *   without reading geometry. shards are opened as by shapeLayerDraw.
+ */
+extern int shapeLayerProbe(shapeLayer *layer, const CGBox2D *dataBox, int maxFound);
+
+/**
+ * test if first shape of layer whose envelope overlaps dataBox is a
+ *   polygon which covers coverBox.
+ */
+extern int shapeLayerCoversBox(shapeLayer *layer, const CGBox2D *dataBox, const CGBox2D *coverBox);
+
+#ifdef    __cplusplus
+}
+#endif
+#endif /* SHAPE_LAYER_H__ */
@@ -26,10 +26,10 @@
  *
  * @author mapaware@hotmail.com
  * @copyright © 2024-2030 mapaware.top All Rights Reserved.
- * @version 0.0.14
+ * @version 0.0.33
  *
  * @since 2024-10-16 22:13:24
- * @date 2024-10-17 01:22:30
+ * @date 2024-10-24 09:18:27
  *
  * @note
  */
@@ -77,6 +77,9 @@ extern "C" {
 #define SHAPETOOL_NAMELEN_MAX       30
 #define SHAPETOOL_PATHLEN_INVALID  256
 
+// max crops of canvas written besides outpng
+#define SHAPETOOL_OUTBOX_MAX        16
+
 
 #define FILE_URI_PREFIX  "file://"
 #define FILE_URI_PREFIX_LEN      7      // strlen("file://")
@@ -91,6 +94,11 @@ extern "C" {
 static const char* commands[] = {
     "drawshape",
     "drawlayers",
+    "buildindex",
+    "compact",
+    "pyramid",
+    "drawtiles",
+    "tileget",
     0
 };
 
@@ -98,6 +106,11 @@ typedef enum {
     command_first_pos = 0,
     command_drawshape = command_first_pos,
     command_drawlayers,
+    command_buildindex,
+    command_compact,
+    command_pyramid,
+    command_drawtiles,
+    command_tileget,
     command_end_npos
 } shapetool_command;
 
@@ -111,7 +124,31 @@ typedef enum {
     optarg_height,         // height in dots
     optarg_dpi,            // dots per inch
     optarg_styleclass,     // style class names
-    optarg_stylecss        // style css file (/path/to/style.css)
+    optarg_stylecss,       // style css file (/path/to/style.css)
+    optarg_readmode,       // shp read mode: file | mmap
+    optarg_readahead,      // slots of read-ahead decoder, 0 for none
+    optarg_decoders,       // number of decoding threads
+    optarg_geomcache,      // budget of decoded geometry cache in MB, 0 for none
+    optarg_levels,         // levels of simplified pyramid
+    optarg_xyonly,         // never read Z/M of records
+    optarg_threads,        // threads drawing bands of canvas or tiles
+    optarg_batch,          // one path for consecutive features of same style
+    optarg_simplifypx,     // tolerance of view space simplification in dots
+    optarg_snap,           // snap view points to grid of 1/N dot
+    optarg_subpixel,       // sub-pixel features: draw | skip | dot
+    optarg_subpixelpx,     // size in dots of sub-pixel features
+    optarg_quality,        // rendering profile: draft | normal | best
+    optarg_minzoom,        // first zoom of tiles
+    optarg_maxzoom,        // last zoom of tiles
+    optarg_tilesize,       // tile size in dots: 256 | 512
+    optarg_outdir,         // output dir of tiles
+    optarg_tilegrid,       // grid of tile 0/0/0: data | mercator
+    optarg_metatile,       // tiles per side of metatile drawn at once
+    optarg_tilebuffer,     // dots around (meta)tile whose shapes are drawn
+    optarg_archive,        // tile archive file (/path/to/tiles.tiles)
+    optarg_tile,           // tile to get: z/x/y
+    optarg_dedupe,         // write identical tiles once
+    optarg_outbox          // crop of canvas to png: X,Y,W,H:PNGFILE
 } shapetool_optarg;
 
 
@@ -124,6 +161,30 @@ typedef struct {
     unsigned int dpi : 1;
     unsigned int styleclass : 1;
     unsigned int style : 1;
+    unsigned int readmode : 1;
+    unsigned int readahead : 1;
+    unsigned int decoders : 1;
+    unsigned int geomcache : 1;
+    unsigned int levels : 1;
+    unsigned int xyonly : 1;
+    unsigned int threads : 1;
+    unsigned int batch : 1;
+    unsigned int simplifypx : 1;
+    unsigned int snap : 1;
+    unsigned int subpixel : 1;
+    unsigned int subpixelpx : 1;
+    unsigned int quality : 1;
+    unsigned int minzoom : 1;
+    unsigned int maxzoom : 1;
+    unsigned int tilesize : 1;
+    unsigned int outdir : 1;
+    unsigned int tilegrid : 1;
+    unsigned int metatile : 1;
+    unsigned int tilebuffer : 1;
+    unsigned int archive : 1;
+    unsigned int tile : 1;
+    unsigned int dedupe : 1;
+    unsigned int outbox : 1;
 } shapetool_flags;
 
 
@@ -132,6 +193,8 @@ typedef struct {
     cstrbuf mapid;
     cstrbuf shpfile;
     cstrbuf outpng;
+    cstrbuf outdir;
+    cstrbuf archive;
 
     cstrbuf styleclass;  // style class names
     CssKeyArray cssStyleKeys; // css parsed keys
@@ -139,6 +202,34 @@ typedef struct {
     float   width;      // width in dots
     float   height;     // height in dots
     int     dpi;
+
+    int     readmode;   // shapeReadMode
+    int     readahead;  // slots of read-ahead ring
+    int     decoders;   // decoding threads
+    int     geomcache;  // geometry cache in MB
+    int     levels;     // pyramid levels
+    int     xyonly;     // read X/Y only
+    int     threads;    // drawing threads
+    int     batch;      // style-batched paths
+    float   simplifypx; // simplify tolerance in dots, 0 for none, -1 by quality
+    int     snap;       // subdivisions of dot for snapping, 0 for none
+    int     subpixel;   // cairoSubpixelMode
+    float   subpixelpx; // size of sub-pixel features in dots
+    int     quality;    // cairoDrawQuality
+    int     minzoom;    // first zoom of tiles
+    int     maxzoom;    // last zoom of tiles
+    int     tilesize;   // tile size in dots
+    int     tilegrid;   // drawTileGrid
+    int     metatile;   // tiles per side of metatile, 1 for none
+    int     tilebuffer; // culling margin of (meta)tile in dots
+    int     tilez;      // tile to get: z/x/y
+    int     tilex;
+    int     tiley;
+    int     dedupe;     // hash pixels of tiles to write duplicates once
+
+    int     numoutbox;  // crops written from the same canvas
+    CGBox2D outbox[SHAPETOOL_OUTBOX_MAX];   // crop in dots from top left
+    cstrbuf outboxpng[SHAPETOOL_OUTBOX_MAX];
 } shapetool_options;
 
 
@@ -146,6 +237,16 @@ int shpfile2png(shapetool_flags *flags, shapetool_options* options);
 
 int maplayers2png(shapetool_flags* flags, shapetool_options* options);
 
+int shpfile2index(shapetool_flags* flags, shapetool_options* options);
+
+int shpfile2compact(shapetool_flags* flags, shapetool_options* options);
+
+int shpfile2pyramid(shapetool_flags* flags, shapetool_options* options);
+
+int layers2tiles(shapetool_flags* flags, shapetool_options* options);
+
+int tilearchive2png(shapetool_flags* flags, shapetool_options* options);
+
 #ifdef    __cplusplus
 }
 #endif
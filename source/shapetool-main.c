@@ -26,14 +26,18 @@
  *
  * @author mapaware@hotmail.com
  * @copyright © 2024-2030 mapaware.top All Rights Reserved.
- * @version 0.0.13
+ * @version 0.0.36
  *
  * @since 2024-10-03 00:05:20
- * @date 2024-10-17 03:01:17
+ * @date 2024-10-24 12:41:00
  *
  * @note
  */
 #include "shapetool-common.h"
+#include "shapelayer.h"
+#include "drawbands.h"
+#include "drawtiles.h"
+#include "tilearchive.h"
 
 shapetool_flags flags = { 0 };
 shapetool_options options = { 0 };
@@ -47,7 +51,13 @@ static void onexit_cleanup(void)
     cstrbufFree(&options.mapid);
     cstrbufFree(&options.shpfile);
     cstrbufFree(&options.outpng);
+    cstrbufFree(&options.outdir);
+    cstrbufFree(&options.archive);
     cstrbufFree(&options.styleclass);
+
+    for (int i = 0; i < options.numoutbox; i++) {
+        cstrbufFree(&options.outboxpng[i]);
+    }
 }
 
 
@@ -55,25 +65,25 @@ static int check_pathfile_arg(char *filearg, const char *fileext, int existflag)
 {
     int blen = cstr_length(filearg, SHAPETOOL_PATHLEN_INVALID);
     if (blen == SHAPETOOL_PATHLEN_INVALID) {
-        printf("Error: invalid path file: %s\n", optarg);
+        printf("Error: invalid path file: %s\n", filearg);
         exit(1);
     }
     if (! cstr_endwith(filearg, blen, fileext, (int)strlen(fileext))) {
-        printf("Error: file type mismatch(%s): %s\n", fileext, optarg);
+        printf("Error: file type mismatch(%s): %s\n", fileext, filearg);
         exit(1);
     }
 
-    int found = pathfile_exists(optarg);
+    int found = pathfile_exists(filearg);
     if (existflag > 0) {
         // 1: file must be exist
         if (! found) {
-            printf("Error: file not found: %s\n", optarg);
+            printf("Error: file not found: %s\n", filearg);
             exit(1);
         }
     } else if (existflag < 0) {
         // -1: file must be NOT exist
         if (found) {
-            printf("Error: file exists: %s\n", optarg);
+            printf("Error: file exists: %s\n", filearg);
             exit(1);
         }
     }
@@ -82,6 +92,23 @@ static int check_pathfile_arg(char *filearg, const char *fileext, int existflag)
 }
 
 
+/**
+ * every crop of --outbox must be inside of canvas
+ */
+static void check_outbox_args(void)
+{
+    for (int i = 0; i < options.numoutbox; i++) {
+        const CGBox2D *box = &options.outbox[i];
+
+        if (box->Xmin < 0 || box->Ymin < 0 || box->Xmax > options.width || box->Ymax > options.height) {
+            printf("Error: outbox (%g,%g,%g,%g) is out of canvas %.0fx%.0f: %s\n", box->Xmin, box->Ymin,
+                box->Xmax - box->Xmin, box->Ymax - box->Ymin, options.width, options.height, CBSTR(options.outboxpng[i]));
+            exit(1);
+        }
+    }
+}
+
+
 static cstrbuf set_options_file(char* optargstr, int argchlen, cstrbuf* pathfile)
 {
     cstrbuf cstr = 0;
@@ -119,7 +146,55 @@ static void print_usage()
  *
  *   $ shapetool drawshape --shpfile ../../../shps/area.shp --outpng ../../../output/area2.png --stylecss ".polygon { border: 3 solid #000FFF; fill: 1 solid #CFF000}"
  *
+ *   $ shapetool drawshape --shpfile ../../../shps/area.shp --outpng ../../../output/area3.png --readmode mmap
+ *
+ *   $ shapetool drawshape --shpfile ../../../shps/area.shp --outpng ../../../output/area4.png --readahead 64
+ *
+ *   $ shapetool drawshape --shpfile ../../../shps/area.shp --outpng ../../../output/area5.png --decoders 8
+ *
+ *   $ shapetool drawshape --shpfile ../../../shps/survey3d.shp --outpng ../../../output/survey3d.png --xyonly
+ *
+ *   $ shapetool drawshape --shpfile "/path/to/USA/states_*.shp" --outpng ../../../output/usa.png
+ *
+ *   $ shapetool drawshape --shpfile ../../../shps/area.shp --outpng ../../../output/area6.png --width 16384 --height 16384 --dpi 1200 --threads 16
+ *
+ *   $ shapetool drawshape --shpfile ../../../shps/area.shp --outpng ../../../output/area7.png --batch
+ *
+ *   $ shapetool drawshape --shpfile ../../../shps/area.shp --outpng ../../../output/area8.png --simplify-px 0.7
+ *
+ *   $ shapetool drawshape --shpfile ../../../shps/area.shp --outpng ../../../output/area9.png --snap 4
+ *
+ *   $ shapetool drawshape --shpfile ../../../shps/area.shp --outpng ../../../output/area10.png --width 1024 --height 768 --subpixel dot --subpixel-px 1.5
+ *
+ *   $ shapetool drawshape --shpfile ../../../shps/area.shp --outpng ../../../output/area11.png --width 1024 --height 768 --quality draft
+ *
+ *   $ shapetool drawshape --shpfile ../../../shps/area.shp --outpng ../../../output/area12.png --outbox 0,0,256,256:../../../output/area12-nw.png --outbox 384,256,256,256:../../../output/area12-c.png
+ *
+ *   $ shapetool drawlayers --layerscfg map-layers.cfg --mapid default --outpng ../../../output/map-default.png --geomcache 256
+ *
  *   $ shapetool drawlayers --layerscfg map-layers.cfg --mapid default --outpng ../../../output/map-default.png
+ *
+ *   $ shapetool drawlayers --layerscfg map-layers.cfg --mapid default --outpng ../../../output/map-default.png --outbox 100,80,320,240:../../../output/map-inset.png
+ *
+ *   $ shapetool buildindex --shpfile ../../../shps/area.shp
+ *
+ *   $ shapetool compact --shpfile ../../../shps/area.shp
+ *
+ *   $ shapetool pyramid --shpfile ../../../shps/area.shp --levels 6
+ *
+ *   $ shapetool drawtiles --shpfile ../../../shps/area.shp --outdir ../../../output/tiles --minzoom 0 --maxzoom 5
+ *
+ *   $ shapetool drawtiles --layerscfg map-layers.cfg --mapid default --outdir ../../../output/tiles --minzoom 10 --maxzoom 14 --tilesize 512 --tilegrid mercator
+ *
+ *   $ shapetool drawtiles --shpfile ../../../shps/area.shp --outdir ../../../output/tiles --minzoom 0 --maxzoom 12 --threads 16
+ *
+ *   $ shapetool drawtiles --shpfile ../../../shps/area.shp --outdir ../../../output/tiles --minzoom 8 --maxzoom 14 --metatile 8 --tilebuffer 32
+ *
+ *   $ shapetool drawtiles --shpfile ../../../shps/area.shp --archive ../../../output/area.tiles --minzoom 0 --maxzoom 14 --threads 16
+ *
+ *   $ shapetool drawtiles --shpfile ../../../shps/area.shp --archive ../../../output/area.tiles --minzoom 0 --maxzoom 16 --threads 16 --dedupe
+ *
+ *   $ shapetool tileget --archive ../../../output/area.tiles --tile 3/5/2 --outpng ../../../output/area-3-5-2.png
  */
 int main(int argc, char* argv[])
 {
@@ -145,6 +220,30 @@ int main(int argc, char* argv[])
         ,{"dpi", required_argument, &flag, optarg_dpi}
         ,{"styleclass", required_argument, &flag, optarg_styleclass}
         ,{"stylecss", required_argument, &flag, optarg_stylecss}
+        ,{"readmode", required_argument, &flag, optarg_readmode}
+        ,{"readahead", required_argument, &flag, optarg_readahead}
+        ,{"decoders", required_argument, &flag, optarg_decoders}
+        ,{"geomcache", required_argument, &flag, optarg_geomcache}
+        ,{"levels", required_argument, &flag, optarg_levels}
+        ,{"xyonly", no_argument, &flag, optarg_xyonly}
+        ,{"threads", required_argument, &flag, optarg_threads}
+        ,{"batch", no_argument, &flag, optarg_batch}
+        ,{"simplify-px", required_argument, &flag, optarg_simplifypx}
+        ,{"snap", required_argument, &flag, optarg_snap}
+        ,{"subpixel", required_argument, &flag, optarg_subpixel}
+        ,{"subpixel-px", required_argument, &flag, optarg_subpixelpx}
+        ,{"quality", required_argument, &flag, optarg_quality}
+        ,{"minzoom", required_argument, &flag, optarg_minzoom}
+        ,{"maxzoom", required_argument, &flag, optarg_maxzoom}
+        ,{"tilesize", required_argument, &flag, optarg_tilesize}
+        ,{"outdir", required_argument, &flag, optarg_outdir}
+        ,{"tilegrid", required_argument, &flag, optarg_tilegrid}
+        ,{"metatile", required_argument, &flag, optarg_metatile}
+        ,{"tilebuffer", required_argument, &flag, optarg_tilebuffer}
+        ,{"archive", required_argument, &flag, optarg_archive}
+        ,{"tile", required_argument, &flag, optarg_tile}
+        ,{"dedupe", no_argument, &flag, optarg_dedupe}
+        ,{"outbox", required_argument, &flag, optarg_outbox}
         ,{0, 0, 0, 0}
     };
 
@@ -200,7 +299,15 @@ int main(int argc, char* argv[])
                 options.mapid = cstrbufDup(options.mapid, optarg, cstrbuf_error_size_len);
                 break;
             case optarg_shpfile:
-                blen = check_pathfile_arg(optarg, ".shp", 1);
+                if (shapeLayerIsPattern(optarg)) {
+                    // shards: /path/to/dir/a_*.shp
+                    blen = check_pathfile_arg(optarg, ".shp", 0);
+                } else if (cstr_endwith(optarg, cstr_length(optarg, SHAPETOOL_PATHLEN_INVALID), ".txt", 4)) {
+                    // manifest of shards
+                    blen = check_pathfile_arg(optarg, ".txt", 1);
+                } else {
+                    blen = check_pathfile_arg(optarg, ".shp", 1);
+                }
                 if (set_options_file(optarg, blen, &options.shpfile)) {
                     flags.shpfile = 1;
                 }
@@ -258,11 +365,231 @@ int main(int argc, char* argv[])
                     flags.style = 1;
                 }
                 break;
+            case optarg_readmode:
+                if (!strcmp(optarg, "file")) {
+                    options.readmode = 0;
+                } else if (!strcmp(optarg, "mmap")) {
+                    options.readmode = 1;
+                } else {
+                    printf("Error: invalid readmode=%s (file|mmap)\n", optarg);
+                    exit(1);
+                }
+                flags.readmode = 1;
+                break;
+            case optarg_readahead:
+                options.readahead = atoi(optarg);
+                if (options.readahead < 0 || options.readahead > SHPREADAHEAD_SLOTS_MAX) {
+                    printf("Error: invalid readahead=%d (0-%d)\n", options.readahead, SHPREADAHEAD_SLOTS_MAX);
+                    exit(1);
+                }
+                flags.readahead = 1;
+                break;
+            case optarg_decoders:
+                options.decoders = atoi(optarg);
+                if (options.decoders < 1 || options.decoders > SHPREADAHEAD_WORKERS_MAX) {
+                    printf("Error: invalid decoders=%d (1-%d)\n", options.decoders, SHPREADAHEAD_WORKERS_MAX);
+                    exit(1);
+                }
+                flags.decoders = 1;
+                break;
+            case optarg_geomcache:
+                options.geomcache = atoi(optarg);
+                if (options.geomcache < 0 || options.geomcache > 65536) {
+                    printf("Error: invalid geomcache=%d (0-65536 MB)\n", options.geomcache);
+                    exit(1);
+                }
+                flags.geomcache = 1;
+                break;
+            case optarg_levels:
+                options.levels = atoi(optarg);
+                if (options.levels < SHPPYRAMID_LEVELS_MIN || options.levels > SHPPYRAMID_LEVELS_MAX) {
+                    printf("Error: invalid levels=%d (%d-%d)\n", options.levels, SHPPYRAMID_LEVELS_MIN, SHPPYRAMID_LEVELS_MAX);
+                    exit(1);
+                }
+                flags.levels = 1;
+                break;
+            case optarg_xyonly:
+                options.xyonly = 1;
+                flags.xyonly = 1;
+                break;
+            case optarg_threads:
+                options.threads = atoi(optarg);
+                if (options.threads < 1 || options.threads > DRAWBANDS_THREADS_MAX) {
+                    printf("Error: invalid threads=%d (1-%d)\n", options.threads, DRAWBANDS_THREADS_MAX);
+                    exit(1);
+                }
+                flags.threads = 1;
+                break;
+            case optarg_batch:
+                options.batch = 1;
+                flags.batch = 1;
+                break;
+            case optarg_simplifypx:
+                options.simplifypx = (float) atof(optarg);
+                if (options.simplifypx < 0 || options.simplifypx > CAIRO_DRAW_SIMPLIFY_MAX) {
+                    printf("Error: invalid simplify-px=%s (0-%.0f)\n", optarg, CAIRO_DRAW_SIMPLIFY_MAX);
+                    exit(1);
+                }
+                flags.simplifypx = 1;
+                break;
+            case optarg_snap:
+                options.snap = atoi(optarg);
+                if (options.snap < 0 || options.snap > CAIRO_DRAW_SNAP_MAX) {
+                    printf("Error: invalid snap=%d (0-%d)\n", options.snap, CAIRO_DRAW_SNAP_MAX);
+                    exit(1);
+                }
+                flags.snap = 1;
+                break;
+            case optarg_subpixel:
+                if (!strcmp(optarg, "draw")) {
+                    options.subpixel = subpixel_draw;
+                } else if (!strcmp(optarg, "skip")) {
+                    options.subpixel = subpixel_skip;
+                } else if (!strcmp(optarg, "dot")) {
+                    options.subpixel = subpixel_dot;
+                } else {
+                    printf("Error: invalid subpixel=%s (draw|skip|dot)\n", optarg);
+                    exit(1);
+                }
+                flags.subpixel = 1;
+                break;
+            case optarg_subpixelpx:
+                options.subpixelpx = (float) atof(optarg);
+                if (options.subpixelpx <= 0 || options.subpixelpx > CAIRO_DRAW_SUBPIXEL_MAX) {
+                    printf("Error: invalid subpixel-px=%s (0-%.0f)\n", optarg, CAIRO_DRAW_SUBPIXEL_MAX);
+                    exit(1);
+                }
+                flags.subpixelpx = 1;
+                break;
+            case optarg_quality:
+                if (!strcmp(optarg, "normal")) {
+                    options.quality = quality_normal;
+                } else if (!strcmp(optarg, "draft")) {
+                    options.quality = quality_draft;
+                } else if (!strcmp(optarg, "best")) {
+                    options.quality = quality_best;
+                } else {
+                    printf("Error: invalid quality=%s (draft|normal|best)\n", optarg);
+                    exit(1);
+                }
+                flags.quality = 1;
+                break;
+            case optarg_minzoom:
+                options.minzoom = atoi(optarg);
+                if (options.minzoom < 0 || options.minzoom > DRAWTILES_ZOOM_MAX) {
+                    printf("Error: invalid minzoom=%d (0-%d)\n", options.minzoom, DRAWTILES_ZOOM_MAX);
+                    exit(1);
+                }
+                flags.minzoom = 1;
+                break;
+            case optarg_maxzoom:
+                options.maxzoom = atoi(optarg);
+                if (options.maxzoom < 0 || options.maxzoom > DRAWTILES_ZOOM_MAX) {
+                    printf("Error: invalid maxzoom=%d (0-%d)\n", options.maxzoom, DRAWTILES_ZOOM_MAX);
+                    exit(1);
+                }
+                flags.maxzoom = 1;
+                break;
+            case optarg_tilesize:
+                options.tilesize = atoi(optarg);
+                if (options.tilesize != 256 && options.tilesize != 512) {
+                    printf("Error: invalid tilesize=%d (256|512)\n", options.tilesize);
+                    exit(1);
+                }
+                flags.tilesize = 1;
+                break;
+            case optarg_outdir:
+                blen = cstr_length(optarg, SHAPETOOL_PATHLEN_INVALID);
+                if (blen == 0 || blen == SHAPETOOL_PATHLEN_INVALID) {
+                    printf("Error: invalid outdir: %s\n", optarg);
+                    exit(1);
+                }
+                if (set_options_file(optarg, blen, &options.outdir)) {
+                    flags.outdir = 1;
+                }
+                break;
+            case optarg_tilegrid:
+                if (!strcmp(optarg, "data")) {
+                    options.tilegrid = tilegrid_data;
+                } else if (!strcmp(optarg, "mercator")) {
+                    options.tilegrid = tilegrid_mercator;
+                } else {
+                    printf("Error: invalid tilegrid=%s (data|mercator)\n", optarg);
+                    exit(1);
+                }
+                flags.tilegrid = 1;
+                break;
+            case optarg_metatile:
+                options.metatile = atoi(optarg);
+                if (options.metatile < 1 || options.metatile > DRAWTILES_METATILE_MAX) {
+                    printf("Error: invalid metatile=%d (1-%d)\n", options.metatile, DRAWTILES_METATILE_MAX);
+                    exit(1);
+                }
+                flags.metatile = 1;
+                break;
+            case optarg_tilebuffer:
+                options.tilebuffer = atoi(optarg);
+                if (options.tilebuffer < 0 || options.tilebuffer > DRAWTILES_BUFFER_MAX) {
+                    printf("Error: invalid tilebuffer=%d (0-%d)\n", options.tilebuffer, DRAWTILES_BUFFER_MAX);
+                    exit(1);
+                }
+                flags.tilebuffer = 1;
+                break;
+            case optarg_archive:
+                blen = check_pathfile_arg(optarg, TILEARCHIVE_FILE_EXT, 0);
+                if (set_options_file(optarg, blen, &options.archive)) {
+                    flags.archive = 1;
+                }
+                break;
+            case optarg_tile:
+                blen = 0;
+                if (sscanf(optarg, "%d/%d/%d%n", &options.tilez, &options.tilex, &options.tiley, &blen) != 3 || optarg[blen] ||
+                    options.tilez < 0 || options.tilez > DRAWTILES_ZOOM_MAX ||
+                    options.tilex < 0 || options.tilex >= (1 << options.tilez) ||
+                    options.tiley < 0 || options.tiley >= (1 << options.tilez)) {
+                    printf("Error: invalid tile=%s (z/x/y)\n", optarg);
+                    exit(1);
+                }
+                flags.tile = 1;
+                break;
+            case optarg_dedupe:
+                options.dedupe = 1;
+                flags.dedupe = 1;
+                break;
+            case optarg_outbox:
+                if (options.numoutbox == SHAPETOOL_OUTBOX_MAX) {
+                    printf("Error: too many outbox (max %d)\n", SHAPETOOL_OUTBOX_MAX);
+                    exit(1);
+                } else {
+                    float x, y, w, h;
+                    CGBox2D *box = &options.outbox[options.numoutbox];
+
+                    blen = 0;
+                    if (sscanf(optarg, "%f,%f,%f,%f:%n", &x, &y, &w, &h, &blen) != 4 || ! blen || w <= 0 || h <= 0) {
+                        printf("Error: invalid outbox=%s (X,Y,W,H:PNGFILE)\n", optarg);
+                        exit(1);
+                    }
+                    box->Xmin = x;
+                    box->Ymin = y;
+                    box->Xmax = x + w;
+                    box->Ymax = y + h;
+
+                    if (set_options_file(optarg + blen, check_pathfile_arg(optarg + blen, ".png", -1), &options.outboxpng[options.numoutbox])) {
+                        options.numoutbox++;
+                        flags.outbox = 1;
+                    }
+                }
+                break;
             }
             break;
         }
     }
 
+    if (! flags.quality) {
+        // draft dpi implies draft unless quality is given
+        options.quality = quality_auto;
+    }
+
     // exec command
     if (command == command_drawshape) {
         if (! flags.shpfile) {
@@ -275,7 +602,14 @@ int main(int argc, char* argv[])
             exit(1);
         }
 
-        if (! flags.style) {
+        if (flags.geomcache) {
+            printf("Warn: geomcache is not used by drawshape\n");
+        }
+
+        if (! flags.style && shapeLayerIsPattern(CBSTR(options.shpfile))) {
+            printf("Info: no default style css for shards: %s\n", CBSTR(options.shpfile));
+        }
+        else if (! flags.style) {
             // If both stylecss not given:
             //   set 'a.shp' with default style css file: 'a.css'
             cstrbuf cssPathfile = cstrbufCat(0, "%.*s.css", CBSTRLEN(options.shpfile) - 4, CBSTR(options.shpfile));
@@ -306,9 +640,20 @@ int main(int argc, char* argv[])
             // set default dpi if no dpi specified
             options.dpi = dpi_high_display;
         }
+        if (!flags.subpixelpx) {
+            options.subpixelpx = 1.0f;
+        }
+        if (!flags.simplifypx) {
+            options.simplifypx = -1;
+        }
+        check_outbox_args();
 
         printf("Info: shpfile2png: %s => %s\n", CBSTR(options.shpfile), CBSTR(options.outpng));
         printf("      png: width=%.0f, height=%.0f, dpi=%d\n", options.width, options.height, options.dpi);
+        for (int i = 0; i < options.numoutbox; i++) {
+            printf("      crop: (%g, %g, %g, %g) => %s\n", options.outbox[i].Xmin, options.outbox[i].Ymin,
+                options.outbox[i].Xmax, options.outbox[i].Ymax, CBSTR(options.outboxpng[i]));
+        }
 
         shpfile2png(&flags, &options);
     }
@@ -327,7 +672,130 @@ int main(int argc, char* argv[])
             options.mapid = cstrbufDup(options.mapid, "default", 7);
         }
 
-        maplayers2png(&flags, &options);
+        // default settings for view canvas
+        if (!flags.width) {
+            options.width = CAIRO_DRAW_WIDTH_DEFAULT;
+        }
+        if (!flags.height) {
+            options.height = CAIRO_DRAW_HEIGHT_DEFAULT;
+        }
+        if (!flags.dpi) {
+            options.dpi = dpi_high_display;
+        }
+        if (!flags.subpixelpx) {
+            options.subpixelpx = 1.0f;
+        }
+        if (!flags.simplifypx) {
+            options.simplifypx = -1;
+        }
+        check_outbox_args();
+
+        if (maplayers2png(&flags, &options) != SHAPETOOL_RES_SOK) {
+            exit(1);
+        }
+    }
+    else if (command == command_buildindex) {
+        if (!flags.shpfile) {
+            printf("Error: no input shp file specified (use: --shpfile SHPFILE).\n");
+            exit(1);
+        }
+
+        printf("Info: shpfile2index: %s\n", CBSTR(options.shpfile));
+
+        if (shpfile2index(&flags, &options) != SHAPETOOL_RES_SOK) {
+            exit(1);
+        }
+    }
+    else if (command == command_compact) {
+        if (!flags.shpfile) {
+            printf("Error: no input shp file specified (use: --shpfile SHPFILE).\n");
+            exit(1);
+        }
+
+        printf("Info: shpfile2compact: %s\n", CBSTR(options.shpfile));
+
+        if (shpfile2compact(&flags, &options) != SHAPETOOL_RES_SOK) {
+            exit(1);
+        }
+    }
+    else if (command == command_pyramid) {
+        if (!flags.shpfile) {
+            printf("Error: no input shp file specified (use: --shpfile SHPFILE).\n");
+            exit(1);
+        }
+
+        printf("Info: shpfile2pyramid: %s\n", CBSTR(options.shpfile));
+
+        if (shpfile2pyramid(&flags, &options) != SHAPETOOL_RES_SOK) {
+            exit(1);
+        }
+    }
+    else if (command == command_drawtiles) {
+        if (!flags.shpfile && !flags.layerscfg) {
+            printf("Error: no input specified (use: --shpfile SHPFILE or --layerscfg CFGFILE).\n");
+            exit(1);
+        }
+        if (!flags.outdir && !flags.archive) {
+            printf("Error: no output of tiles specified (use: --outdir TILESDIR or --archive TILESFILE)\n");
+            exit(1);
+        }
+        if (!flags.shpfile && !options.mapid) {
+            printf("Warn: no mapid specified (use: --mapid MAPID). so we use [map:default])\n");
+            options.mapid = cstrbufDup(options.mapid, "default", 7);
+        }
+
+        if (!flags.maxzoom) {
+            options.maxzoom = options.minzoom;
+        }
+        if (options.minzoom > options.maxzoom) {
+            printf("Error: minzoom(%d) > maxzoom(%d)\n", options.minzoom, options.maxzoom);
+            exit(1);
+        }
+        if (!flags.tilesize) {
+            options.tilesize = DRAWTILES_SIZE_DEFAULT;
+        }
+        if (!flags.metatile) {
+            options.metatile = 1;
+        }
+        if (!flags.tilebuffer) {
+            options.tilebuffer = DRAWTILES_MARGIN;
+        }
+        if (!flags.dpi) {
+            options.dpi = dpi_low_display;
+        }
+        if (!flags.subpixelpx) {
+            options.subpixelpx = 1.0f;
+        }
+        if (!flags.simplifypx) {
+            options.simplifypx = -1;
+        }
+
+        printf("Info: layers2tiles: %s => %s (zoom=%d-%d, tilesize=%d, metatile=%d)\n",
+            CBSTR(flags.shpfile ? options.shpfile : options.layerscfg), CBSTR(flags.archive ? options.archive : options.outdir), options.minzoom, options.maxzoom, options.tilesize, options.metatile);
+
+        if (layers2tiles(&flags, &options) != SHAPETOOL_RES_SOK) {
+            exit(1);
+        }
+    }
+    else if (command == command_tileget) {
+        if (!flags.archive) {
+            printf("Error: no tile archive specified (use: --archive TILESFILE).\n");
+            exit(1);
+        }
+        if (!flags.tile) {
+            printf("Error: no tile specified (use: --tile Z/X/Y).\n");
+            exit(1);
+        }
+        if (!flags.outpng) {
+            printf("Error: no output png file specified (use: --outpng PNGFILE)\n");
+            exit(1);
+        }
+
+        printf("Info: tilearchive2png: %s => %s\n", CBSTR(options.archive), CBSTR(options.outpng));
+
+        if (tilearchive2png(&flags, &options) != SHAPETOOL_RES_SOK) {
+            exit(1);
+        }
     }
 
     // TODO: others
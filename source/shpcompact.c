@@ -0,0 +1,454 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shpcompact.c
+ * @brief quantized columnar geometry cache (.shpc) of shp file.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.5
+ *
+ * @since 2024-10-20 09:12:30
+ * @date 2024-10-24 14:35:00
+ *
+ * @note
+ */
+#include "shpcompact.h"
+
+#include <common/memapi.h>
+
+
+#define SHPCOMPACT_VERSION      2
+
+// ESRI: any value less than -10^38 is no data
+#define SHPCOMPACT_NODATA       (-1.0e+39)
+
+// bytes of varint of a zigzag coded int32
+#define SHPCOMPACT_VARINT_MAX   5
+
+
+/**
+ * zigzag code delta (small magnitudes to small values) and put it as
+ *   varint: 7 bits per byte, low bits first, high bit set if more follow.
+ * returns bytes put.
+ */
+STATIC_INLINE int shpcPutVarDelta(ub1 *out, sb4 delta)
+{
+    int n = 0;
+    ub4 v = ((ub4) delta << 1) ^ (delta < 0 ? 0xFFFFFFFFU : 0);
+
+    while (v >= 0x80) {
+        out[n++] = (ub1) (v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (ub1) v;
+    return n;
+}
+
+
+/**
+ * write a column and pad it to 8 bytes
+ */
+int shpcWriteColumn(FILE *fp, const void *data, sb8 bytes)
+{
+    static const ub1 zeros[8] = { 0 };
+    sb8 padding = SHPC_ALIGN8(bytes) - bytes;
+
+    if (bytes > 0 && fwrite(data, (size_t) bytes, 1, fp) != 1) {
+        return (-1);
+    }
+    if (padding > 0 && fwrite(zeros, (size_t) padding, 1, fp) != 1) {
+        return (-1);
+    }
+    return 0;
+}
+
+
+int shpcFileBuild(const char *shpcfile, const shpFileMap *fileMap, int nShapeType, const double bounds[4], int hasZ, int hasM)
+{
+    int i, k, ret;
+    sb8 numParts = 0, numPoints = 0, numBytes, offset;
+
+    const int nEntities = fileMap->nEntities;
+    const size_t n = (size_t) nEntities;
+
+    shpcHeader header;
+    shapeGeomView view;
+    shpRecordBuf alignBuf;
+    CGBox2D env;
+    FILE *fp;
+
+    sb4 *recParts, *recPoints, *parts;
+    sb8 *recBytes;
+    ub1 *xy;
+    double *boxes, *zs = 0, *ms = 0;
+
+    bzero(&alignBuf, sizeof(alignBuf));
+
+    // count parts and points
+    for (i = 0; i < nEntities; i++) {
+        if (shpFileMapGetEnvelope(fileMap, i, &env) != SHPT_NULL && shpFileMapGetGeom(fileMap, i, &alignBuf, &view)) {
+            numParts += view.nParts;
+            numPoints += view.nPoints;
+        }
+    }
+
+    if (numParts > INT_MAX || numPoints > INT_MAX / 2) {
+        printf("Error: too many points(%" PRId64 ") for compact file: %s\n", (int64_t) numPoints, shpcfile);
+        shpRecordBufFree(&alignBuf);
+        return -1;
+    }
+
+    bzero(&header, sizeof(header));
+    memcpy(header.magic, SHPCOMPACT_MAGIC, sizeof(header.magic));
+    header.version = SHPCOMPACT_VERSION;
+    header.nShapeType = nShapeType;
+    header.nEntities = nEntities;
+    header.flags = (hasZ ? SHPC_FLAG_HASZ : 0) | (hasM ? SHPC_FLAG_HASM : 0);
+    header.numParts = (sb4) numParts;
+    header.numPoints = (sb4) numPoints;
+
+    for (k = 0; k < 4; k++) {
+        header.bounds[k] = bounds[k];
+    }
+    header.scale[0] = (bounds[2] > bounds[0] ? (bounds[2] - bounds[0]) / SHPCOMPACT_QUANT_MAX : 1.0);
+    header.scale[1] = (bounds[3] > bounds[1] ? (bounds[3] - bounds[1]) / SHPCOMPACT_QUANT_MAX : 1.0);
+
+    recParts = (sb4 *) mem_alloc_unset(sizeof(sb4) * (n + 1));
+    recPoints = (sb4 *) mem_alloc_unset(sizeof(sb4) * (n + 1));
+    recBytes = (sb8 *) mem_alloc_unset(sizeof(sb8) * (n + 1));
+    parts = (sb4 *) mem_alloc_unset(sizeof(sb4) * (size_t) (numParts > 0 ? numParts : 1));
+    boxes = (double *) mem_alloc_unset(sizeof(double) * 4 * (n > 0 ? n : 1));
+    xy = (ub1 *) mem_alloc_unset(SHPCOMPACT_VARINT_MAX * 2 * (size_t) (numPoints > 0 ? numPoints : 1));
+    if (hasZ) {
+        zs = (double *) mem_alloc_unset(sizeof(double) * (size_t) (numPoints > 0 ? numPoints : 1));
+    }
+    if (hasM) {
+        ms = (double *) mem_alloc_unset(sizeof(double) * (size_t) (numPoints > 0 ? numPoints : 1));
+    }
+
+    numParts = 0;
+    numPoints = 0;
+    numBytes = 0;
+
+    for (i = 0; i < nEntities; i++) {
+        recParts[i] = (sb4) numParts;
+        recPoints[i] = (sb4) numPoints;
+        recBytes[i] = numBytes;
+
+        // empty envelope for null or bad records
+        boxes[i] = boxes[n + i] = DBL_MAX;
+        boxes[2 * n + i] = boxes[3 * n + i] = -DBL_MAX;
+
+        if (shpFileMapGetEnvelope(fileMap, i, &env) != SHPT_NULL && shpFileMapGetGeom(fileMap, i, &alignBuf, &view)) {
+            const ub1 *zValues, *mValues;
+            sb4 qx, qy, px = 0, py = 0;
+
+            boxes[i] = env.Xmin;
+            boxes[n + i] = env.Ymin;
+            boxes[2 * n + i] = env.Xmax;
+            boxes[3 * n + i] = env.Ymax;
+
+            for (k = 0; k < view.nParts; k++) {
+                parts[numParts + k] = view.panPartStart[k];
+            }
+
+            for (k = 0; k < view.nPoints; k++) {
+                qx = shpcQuantize(view.pPoints[k].x, header.bounds[0], header.scale[0]);
+                qy = shpcQuantize(view.pPoints[k].y, header.bounds[1], header.scale[1]);
+                numBytes += shpcPutVarDelta(xy + numBytes, qx - px);
+                numBytes += shpcPutVarDelta(xy + numBytes, qy - py);
+                px = qx;
+                py = qy;
+            }
+
+            if (hasZ || hasM) {
+                shpFileMapGetZM(fileMap, i, &zValues, &mValues);
+                for (k = 0; k < view.nPoints; k++) {
+                    if (zs) {
+                        zs[numPoints + k] = (zValues ? shpBytesLittleDouble(zValues + k * 8) : 0);
+                    }
+                    if (ms) {
+                        ms[numPoints + k] = (mValues ? shpBytesLittleDouble(mValues + k * 8) : SHPCOMPACT_NODATA);
+                    }
+                }
+            }
+
+            numParts += view.nParts;
+            numPoints += view.nPoints;
+        }
+    }
+
+    recParts[n] = (sb4) numParts;
+    recPoints[n] = (sb4) numPoints;
+    recBytes[n] = numBytes;
+
+    header.xyBytes = numBytes;
+
+    offset = sizeof(shpcHeader);
+    header.recPartsOffset = offset;
+    offset += SHPC_ALIGN8(sizeof(sb4) * (sb8) (n + 1));
+    header.recPointsOffset = offset;
+    offset += SHPC_ALIGN8(sizeof(sb4) * (sb8) (n + 1));
+    header.recBytesOffset = offset;
+    offset += sizeof(sb8) * (sb8) (n + 1);
+    header.partsOffset = offset;
+    offset += SHPC_ALIGN8(sizeof(sb4) * numParts);
+    header.boxesOffset = offset;
+    offset += sizeof(double) * 4 * (sb8) n;
+    header.xyOffset = offset;
+    offset += SHPC_ALIGN8(numBytes);
+    if (hasZ) {
+        header.zOffset = offset;
+        offset += sizeof(double) * numPoints;
+    }
+    if (hasM) {
+        header.mOffset = offset;
+        offset += sizeof(double) * numPoints;
+    }
+    header.fileSize = offset;
+
+
+    ret = -1;
+
+    fp = fopen(shpcfile, "wb");
+    if (! fp) {
+        printf("Error: Cannot create compact file: %s\n", shpcfile);
+    } else {
+        if (fwrite(&header, sizeof(header), 1, fp) != 1 ||
+            shpcWriteColumn(fp, recParts, sizeof(sb4) * (sb8) (n + 1)) ||
+            shpcWriteColumn(fp, recPoints, sizeof(sb4) * (sb8) (n + 1)) ||
+            shpcWriteColumn(fp, recBytes, sizeof(sb8) * (sb8) (n + 1)) ||
+            shpcWriteColumn(fp, parts, sizeof(sb4) * numParts) ||
+            shpcWriteColumn(fp, boxes, sizeof(double) * 4 * (sb8) n) ||
+            shpcWriteColumn(fp, xy, numBytes) ||
+            (zs && shpcWriteColumn(fp, zs, sizeof(double) * numPoints)) ||
+            (ms && shpcWriteColumn(fp, ms, sizeof(double) * numPoints))) {
+            printf("Error: Failed to write compact file: %s\n", shpcfile);
+            fclose(fp);
+            remove(shpcfile);
+        } else {
+            fclose(fp);
+            ret = 0;
+        }
+    }
+
+    shpRecordBufFree(&alignBuf);
+    mem_free(recParts);
+    mem_free(recPoints);
+    mem_free(recBytes);
+    mem_free(parts);
+    mem_free(boxes);
+    mem_free(xy);
+    if (zs) {
+        mem_free(zs);
+    }
+    if (ms) {
+        mem_free(ms);
+    }
+
+    if (ret == 0) {
+        printf("Info: compact file built: %s (records=%d, parts=%d, points=%d, xy bytes=%" PRId64 ", bytes=%" PRId64 ")\n",
+            shpcfile, nEntities, header.numParts, header.numPoints, (int64_t) header.xyBytes, (int64_t) header.fileSize);
+    }
+    return ret;
+}
+
+
+STATIC_INLINE int shpcColumnValid(const shpcFile *shpc, sb8 offset, sb8 bytes)
+{
+    return (offset >= (sb8) sizeof(shpcHeader) && (offset & 7) == 0 && offset + bytes <= (sb8) shpc->size);
+}
+
+
+int shpcFileOpen(shpcFile *shpc, const char *shpcfile)
+{
+    int i;
+    sb8 n, numParts, numPoints;
+    const shpcHeader *header;
+
+    bzero(shpc, sizeof(shpcFile));
+
+    shpc->addr = shpFileMapBytes(shpcfile, &shpc->size);
+    if (! shpc->addr) {
+        return -1;
+    }
+
+    header = (const shpcHeader *) shpc->addr;
+
+    if (shpc->size < sizeof(shpcHeader) ||
+        memcmp(header->magic, SHPCOMPACT_MAGIC, sizeof(header->magic)) ||
+        header->fileSize != (sb8) shpc->size ||
+        header->nEntities < 0 || header->numParts < 0 || header->numPoints < 0) {
+        printf("Error: Bad compact file: %s\n", shpcfile);
+        shpcFileClose(shpc);
+        return -1;
+    }
+
+    if (header->version != SHPCOMPACT_VERSION) {
+        printf("Warn: compact file version %d is not %d, build it again: %s\n", header->version, SHPCOMPACT_VERSION, shpcfile);
+        shpcFileClose(shpc);
+        return -1;
+    }
+
+    n = header->nEntities;
+    numParts = header->numParts;
+    numPoints = header->numPoints;
+
+    if (! shpcColumnValid(shpc, header->recPartsOffset, sizeof(sb4) * (n + 1)) ||
+        ! shpcColumnValid(shpc, header->recPointsOffset, sizeof(sb4) * (n + 1)) ||
+        ! shpcColumnValid(shpc, header->recBytesOffset, sizeof(sb8) * (n + 1)) ||
+        ! shpcColumnValid(shpc, header->partsOffset, sizeof(sb4) * numParts) ||
+        ! shpcColumnValid(shpc, header->boxesOffset, sizeof(double) * 4 * n) ||
+        header->xyBytes < 0 || ! shpcColumnValid(shpc, header->xyOffset, header->xyBytes) ||
+        ((header->flags & SHPC_FLAG_HASZ) && ! shpcColumnValid(shpc, header->zOffset, sizeof(double) * numPoints)) ||
+        ((header->flags & SHPC_FLAG_HASM) && ! shpcColumnValid(shpc, header->mOffset, sizeof(double) * numPoints))) {
+        printf("Error: Bad compact file columns: %s\n", shpcfile);
+        shpcFileClose(shpc);
+        return -1;
+    }
+
+    shpc->header = header;
+    shpc->recParts = (const sb4 *) (shpc->addr + header->recPartsOffset);
+    shpc->recPoints = (const sb4 *) (shpc->addr + header->recPointsOffset);
+    shpc->recBytes = (const sb8 *) (shpc->addr + header->recBytesOffset);
+    shpc->parts = (const sb4 *) (shpc->addr + header->partsOffset);
+    shpc->boxes[0] = (const double *) (shpc->addr + header->boxesOffset);
+    shpc->boxes[1] = shpc->boxes[0] + n;
+    shpc->boxes[2] = shpc->boxes[1] + n;
+    shpc->boxes[3] = shpc->boxes[2] + n;
+    shpc->xy = shpc->addr + header->xyOffset;
+    shpc->z = ((header->flags & SHPC_FLAG_HASZ) ? (const double *) (shpc->addr + header->zOffset) : 0);
+    shpc->m = ((header->flags & SHPC_FLAG_HASM) ? (const double *) (shpc->addr + header->mOffset) : 0);
+
+    // record offsets must be ascending so that no record reads out of columns
+    if (shpc->recParts[0] != 0 || shpc->recPoints[0] != 0 || shpc->recBytes[0] != 0 ||
+        shpc->recParts[n] != numParts || shpc->recPoints[n] != numPoints || shpc->recBytes[n] != header->xyBytes) {
+        printf("Error: Bad compact file records: %s\n", shpcfile);
+        shpcFileClose(shpc);
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        if (shpc->recParts[i] > shpc->recParts[i + 1] || shpc->recPoints[i] > shpc->recPoints[i + 1] ||
+            shpc->recBytes[i] > shpc->recBytes[i + 1]) {
+            printf("Error: Bad compact file records: %s\n", shpcfile);
+            shpcFileClose(shpc);
+            return -1;
+        }
+    }
+
+    // part starts index points of views, they are checked once here
+    for (i = 0; i < n; i++) {
+        if (! shpFileCheckPartStarts(shpc->parts + shpc->recParts[i], shpc->recParts[i + 1] - shpc->recParts[i],
+                shpc->recPoints[i + 1] - shpc->recPoints[i], i)) {
+            printf("Error: Bad compact file parts: %s\n", shpcfile);
+            shpcFileClose(shpc);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+void shpcFileClose(shpcFile *shpc)
+{
+    shpFileUnmapBytes(shpc->addr, shpc->size);
+    bzero(shpc, sizeof(shpcFile));
+}
+
+
+int shpcFileGetGeom(const shpcFile *shpc, int nShapeId, shpcPointsBuf *pointsBuf, shapeGeomView *view)
+{
+    int nParts, nPoints;
+
+    if (nShapeId < 0 || nShapeId >= shpc->header->nEntities) {
+        return 0;
+    }
+
+    nParts = shpc->recParts[nShapeId + 1] - shpc->recParts[nShapeId];
+    nPoints = shpc->recPoints[nShapeId + 1] - shpc->recPoints[nShapeId];
+    if (nParts < 1) {
+        return 0;
+    }
+
+    if (! shpcDecodeVarPoints(shpc->xy + shpc->recBytes[nShapeId], shpc->recBytes[nShapeId + 1] - shpc->recBytes[nShapeId],
+            nPoints, shpc->header->bounds, shpc->header->scale, pointsBuf)) {
+        printf("Warn: bad points of shape#%d\n", nShapeId);
+        return 0;
+    }
+
+    view->nShapeId = nShapeId;
+    view->nParts = nParts;
+    view->nPoints = nPoints;
+    view->panPartStart = shpc->parts + shpc->recParts[nShapeId];
+    view->pPoints = pointsBuf->pPoints;
+
+    return 1;
+}
+
+
+int shpcDecodeVarPoints(const ub1 *bytes, sb8 numBytes, int nPoints, const double origin[2], const double scale[2], shpcPointsBuf *pointsBuf)
+{
+    int k, c, shift;
+    ub4 v, q[2] = { 0, 0 };
+    SHPPointType *pts;
+
+    const ub1 *end = bytes + numBytes;
+
+    if (pointsBuf->capacity < nPoints) {
+        pointsBuf->capacity = CG_MAX(nPoints, CG_MAX(256, pointsBuf->capacity * 2));
+        pointsBuf->pPoints = (SHPPointType *) mem_realloc(pointsBuf->pPoints, sizeof(SHPPointType) * pointsBuf->capacity);
+    }
+
+    pts = pointsBuf->pPoints;
+
+    for (k = 0; k < nPoints; k++) {
+        for (c = 0; c < 2; c++) {
+            v = 0;
+            shift = 0;
+            do {
+                if (bytes == end || shift >= 7 * SHPCOMPACT_VARINT_MAX) {
+                    return 0;
+                }
+                v |= (ub4) (*bytes & 0x7F) << shift;
+                shift += 7;
+            } while (*bytes++ & 0x80);
+
+            // unzigzag, wraps as int32
+            q[c] += (v >> 1) ^ (0U - (v & 1));
+        }
+        pts[k].x = origin[0] + (sb4) q[0] * scale[0];
+        pts[k].y = origin[1] + (sb4) q[1] * scale[1];
+    }
+    return 1;
+}
+
+
+void shpcPointsBufFree(shpcPointsBuf *pointsBuf)
+{
+    if (pointsBuf->pPoints) {
+        mem_free(pointsBuf->pPoints);
+    }
+    bzero(pointsBuf, sizeof(shpcPointsBuf));
+}
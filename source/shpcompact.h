@@ -0,0 +1,210 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shpcompact.h
+ * @brief quantized columnar geometry cache (.shpc) of shp file.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.4
+ *
+ * @since 2024-10-20 09:12:30
+ * @date 2024-10-24 14:35:00
+ *
+ * @note
+ *   X, Y of all vertices are quantized to a 30-bit grid over the layer bounds
+ *   and stored as deltas to the previous vertex of the same record (first
+ *   vertex of record is absolute). Deltas are zigzag coded into varints of
+ *   1 to 5 bytes per coordinate, instead of 16 bytes per vertex (32 with Z
+ *   and M) as in .shp, and Z/M pages are never touched by drawing.
+ *
+ *   .shpc file layout (little-endian, every column 8-byte aligned):
+ *     shpcHeader                    160 bytes
+ *     sb4 recParts[nEntities + 1]   first part of record
+ *     sb4 recPoints[nEntities + 1]  first point of record
+ *     sb8 recBytes[nEntities + 1]   first byte of record in xy
+ *     sb4 parts[numParts]           start point of part within record
+ *     double Xmin[nEntities], Ymin[nEntities], Xmax[nEntities], Ymax[nEntities]
+ *     ub1 xy[xyBytes]               varints of delta X, Y of quantized vertices
+ *     double z[numPoints]           only if SHPC_FLAG_HASZ
+ *     double m[numPoints]           only if SHPC_FLAG_HASM
+ */
+#ifndef SHP_COMPACT_H__
+#define SHP_COMPACT_H__
+
+#ifdef    __cplusplus
+extern "C" {
+#endif
+
+#include "shpfilemap.h"
+
+
+#define SHPCOMPACT_FILE_EXT     ".shpc"
+#define SHPCOMPACT_MAGIC        "SHPCMP\0\1"
+
+// quantized X, Y are in [0, SHPCOMPACT_QUANT_MAX]
+#define SHPCOMPACT_QUANT_MAX    0x3FFFFFFF
+
+#define SHPC_FLAG_HASZ          1
+#define SHPC_FLAG_HASM          2
+
+#define SHPC_ALIGN8(bytes)      (((bytes) + 7) & ~((sb8) 7))
+
+
+typedef struct
+{
+    char magic[8];
+
+    sb4 version;
+    sb4 nShapeType;
+    sb4 nEntities;
+    sb4 flags;
+    sb4 numParts;
+    sb4 numPoints;
+    sb8 xyBytes;
+
+    // Xmin, Ymin, Xmax, Ymax of quantization grid (layer bounds)
+    double bounds[4];
+
+    // X = bounds[0] + qx * scale[0], Y = bounds[1] + qy * scale[1]
+    double scale[2];
+
+    // byte offsets of columns from start of file (0 if absent)
+    sb8 recPartsOffset;
+    sb8 recPointsOffset;
+    sb8 recBytesOffset;
+    sb8 partsOffset;
+    sb8 boxesOffset;
+    sb8 xyOffset;
+    sb8 zOffset;
+    sb8 mOffset;
+    sb8 fileSize;
+} shpcHeader;
+
+
+typedef struct
+{
+    // mapped .shpc file
+    const ub1 *addr;
+    size_t size;
+
+    const shpcHeader *header;
+
+    const sb4 *recParts;
+    const sb4 *recPoints;
+    const sb8 *recBytes;
+    const sb4 *parts;
+
+    // Xmin, Ymin, Xmax, Ymax columns
+    const double *boxes[4];
+
+    const ub1 *xy;
+    const double *z;
+    const double *m;
+} shpcFile;
+
+
+/**
+ * decode buffer of vertices, grows on demand
+ */
+typedef struct
+{
+    SHPPointType *pPoints;
+    int capacity;
+} shpcPointsBuf;
+
+
+/**
+ * convert mapped shp file into .shpc.
+ *   bounds: Xmin, Ymin, Xmax, Ymax of layer used as quantization grid.
+ * returns 0 on success.
+ */
+extern int shpcFileBuild(const char *shpcfile, const shpFileMap *fileMap, int nShapeType, const double bounds[4], int hasZ, int hasM);
+
+/**
+ * open (mmap) a .shpc file. returns 0 on success.
+ */
+extern int shpcFileOpen(shpcFile *shpc, const char *shpcfile);
+
+extern void shpcFileClose(shpcFile *shpc);
+
+/**
+ * decode vertices of shape into pointsBuf and make a view of it.
+ *   part starts of view point into mapped file, checked at open.
+ * returns 1 on success, 0 on null or bad record.
+ */
+extern int shpcFileGetGeom(const shpcFile *shpc, int nShapeId, shpcPointsBuf *pointsBuf, shapeGeomView *view);
+
+extern void shpcPointsBufFree(shpcPointsBuf *pointsBuf);
+
+
+/**
+ * decode nPoints varint coded vertices of numBytes into pointsBuf
+ *   (grows it on demand).
+ *   origin, scale: bounds[0..1] and scale[0..1] of quantization grid.
+ * returns 1 on success, 0 if bytes end before nPoints.
+ */
+extern int shpcDecodeVarPoints(const ub1 *bytes, sb8 numBytes, int nPoints, const double origin[2], const double scale[2], shpcPointsBuf *pointsBuf);
+
+/**
+ * write a column and pad it to 8 bytes. returns 0 on success.
+ */
+extern int shpcWriteColumn(FILE *fp, const void *data, sb8 bytes);
+
+
+STATIC_INLINE sb4 shpcQuantize(double v, double origin, double scale)
+{
+    double q = floor((v - origin) / scale + 0.5);
+    return (sb4) (q < 0 ? 0 : (q > SHPCOMPACT_QUANT_MAX ? SHPCOMPACT_QUANT_MAX : q));
+}
+
+
+/**
+ * get envelope of shape. returns shp type or SHPT_NULL for null shape.
+ */
+STATIC_INLINE int shpcFileGetEnvelope(const shpcFile *shpc, int nShapeId, CGBox2D *envelope)
+{
+    envelope->Xmin = shpc->boxes[0][nShapeId];
+    envelope->Ymin = shpc->boxes[1][nShapeId];
+    envelope->Xmax = shpc->boxes[2][nShapeId];
+    envelope->Ymax = shpc->boxes[3][nShapeId];
+    return (envelope->Xmin <= envelope->Xmax ? shpc->header->nShapeType : SHPT_NULL);
+}
+
+/**
+ * Z or M values of shape (nPoints items), 0 if layer has none.
+ */
+STATIC_INLINE const double * shpcFileGetZ(const shpcFile *shpc, int nShapeId)
+{
+    return (shpc->z ? shpc->z + shpc->recPoints[nShapeId] : 0);
+}
+
+STATIC_INLINE const double * shpcFileGetM(const shpcFile *shpc, int nShapeId)
+{
+    return (shpc->m ? shpc->m + shpc->recPoints[nShapeId] : 0);
+}
+
+#ifdef    __cplusplus
+}
+#endif
+#endif /* SHP_COMPACT_H__ */
@@ -0,0 +1,397 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shpenvtab.c
+ * @brief structure-of-arrays table of shape envelopes with SIMD culling.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.4
+ *
+ * @since 2024-10-19 10:11:45
+ * @date 2024-10-24 13:40:00
+ *
+ * @note
+ *   Cull kernels are selected at runtime: AVX, SSE2 or scalar.
+ */
+#include "shpenvtab.h"
+
+#include <common/misc.h>
+
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#   define SHPENVTAB_SIMD_X86   1
+#   include <immintrin.h>
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#   endif
+#endif
+
+#if defined(__GNUC__)
+#   define SHPENVTAB_TARGET(isa)  __attribute__((target(isa)))
+#else
+#   define SHPENVTAB_TARGET(isa)
+#endif
+
+
+// bytes read from .shp per chunk
+#define SHPENVTAB_CHUNK_SIZE   0x400000
+
+// record header + shape type + box
+#define SHPENVTAB_RECORD_HEAD  (SHPFILE_RECHDR_SIZE + 36)
+
+
+typedef int (*shpEnvelopeCullFunc)(const shpEnvelopeTable *, const CGBox2D *, int *);
+
+
+/**
+ * set envelope of a record from its content. content must have 36 bytes
+ *   at least except for null and point records.
+ */
+static void shpEnvelopeTableSetRecord(shpEnvelopeTable *table, int nShapeId, const ub1 *content, int avail)
+{
+    int shptype;
+
+    if (nShapeId < 0 || nShapeId >= table->nEntities || avail < 4) {
+        return;
+    }
+
+    shptype = shpBytesLittleInt32(content);
+
+    switch (shptype) {
+    case 1: case 11: case 21:
+        if (avail >= 20) {
+            table->Xmin[nShapeId] = table->Xmax[nShapeId] = shpBytesLittleDouble(content + 4);
+            table->Ymin[nShapeId] = table->Ymax[nShapeId] = shpBytesLittleDouble(content + 12);
+        }
+        break;
+
+    case 3: case 13: case 23:
+    case 5: case 15: case 25:
+    case 8: case 18: case 28:
+    case 31:
+        if (avail >= 36) {
+            table->Xmin[nShapeId] = shpBytesLittleDouble(content + 4);
+            table->Ymin[nShapeId] = shpBytesLittleDouble(content + 12);
+            table->Xmax[nShapeId] = shpBytesLittleDouble(content + 20);
+            table->Ymax[nShapeId] = shpBytesLittleDouble(content + 28);
+        }
+        break;
+    }
+}
+
+
+/**
+ * one sequential pass over .shp by big chunks. records are identified
+ *   by their record numbers, so .shx is not needed.
+ */
+static int shpEnvelopeTableReadFile(shpEnvelopeTable *table, const char *shpfile)
+{
+    sb8 pos = SHPFILE_HEADER_SIZE, chunkPos = 0;
+    int chunkLen = 0, avail, contentBytes, ret = 0;
+    const ub1 *rec;
+
+    filehandle_t hf = file_open_read(shpfile);
+    if (hf == filehandle_invalid) {
+        printf("Error: Cannot open shp file: %s\n", shpfile);
+        return -1;
+    }
+
+    ub1 *chunk = (ub1 *) mem_alloc_unset(SHPENVTAB_CHUNK_SIZE);
+
+    for (;;) {
+        if (pos + SHPENVTAB_RECORD_HEAD > chunkPos + chunkLen) {
+            // refill chunk from current record
+            if (file_seek(hf, pos, fseek_pos_set) != pos ||
+                (chunkLen = file_readbytes(hf, (char *) chunk, SHPENVTAB_CHUNK_SIZE)) < 0) {
+                // a table missing records would cull shapes away
+                printf("Error: Failed to read shp file: %s\n", shpfile);
+                ret = -1;
+                break;
+            }
+            chunkPos = pos;
+        }
+
+        avail = (int) (chunkPos + chunkLen - pos);
+        if (avail < SHPFILE_RECHDR_SIZE + 4) {
+            // end of file
+            break;
+        }
+
+        rec = chunk + (pos - chunkPos);
+        contentBytes = shpBytesBigInt32(rec + 4) * 2;
+        if (contentBytes < 4) {
+            printf("Warn: bad record at offset %" PRId64 ": %s\n", (int64_t) pos, shpfile);
+            break;
+        }
+
+        // record number starts with 1
+        shpEnvelopeTableSetRecord(table, shpBytesBigInt32(rec) - 1, rec + SHPFILE_RECHDR_SIZE, CG_MIN(avail - SHPFILE_RECHDR_SIZE, contentBytes));
+
+        pos += SHPFILE_RECHDR_SIZE + contentBytes;
+    }
+
+    mem_free(chunk);
+    file_close(&hf);
+    return ret;
+}
+
+
+int shpEnvelopeTableLoad(shpEnvelopeTable *table, const char *shpfile, const shpFileMap *fileMap, int nEntities)
+{
+    int i, ret = 0;
+    size_t n = (size_t) (nEntities > 0 ? nEntities : 1);
+
+    bzero(table, sizeof(shpEnvelopeTable));
+
+    table->nEntities = nEntities;
+    table->Xmin = (double *) mem_alloc_unset(sizeof(double) * n);
+    table->Ymin = (double *) mem_alloc_unset(sizeof(double) * n);
+    table->Xmax = (double *) mem_alloc_unset(sizeof(double) * n);
+    table->Ymax = (double *) mem_alloc_unset(sizeof(double) * n);
+
+    // empty envelope for null or missing records
+    for (i = 0; i < nEntities; i++) {
+        table->Xmin[i] = table->Ymin[i] = DBL_MAX;
+        table->Xmax[i] = table->Ymax[i] = -DBL_MAX;
+    }
+
+    if (fileMap && fileMap->shpAddr) {
+        CGBox2D env;
+        for (i = 0; i < nEntities; i++) {
+            if (shpFileMapGetEnvelope(fileMap, i, &env) != SHPT_NULL) {
+                table->Xmin[i] = env.Xmin;
+                table->Ymin[i] = env.Ymin;
+                table->Xmax[i] = env.Xmax;
+                table->Ymax[i] = env.Ymax;
+            }
+        }
+    } else {
+        ret = shpEnvelopeTableReadFile(table, shpfile);
+    }
+
+    if (ret != 0) {
+        shpEnvelopeTableFree(table);
+    }
+    return ret;
+}
+
+
+void shpEnvelopeTableFree(shpEnvelopeTable *table)
+{
+    if (! table->borrowed) {
+        mem_free(table->Xmin);
+        mem_free(table->Ymin);
+        mem_free(table->Xmax);
+        mem_free(table->Ymax);
+    }
+    bzero(table, sizeof(shpEnvelopeTable));
+}
+
+
+/**
+ * cull kernels: shapeIds must hold nEntities items
+ */
+static int shpEnvelopeCullScalar(const shpEnvelopeTable *table, const CGBox2D *dataBox, int *shapeIds)
+{
+    int i, count = 0;
+
+    for (i = 0; i < table->nEntities; i++) {
+        shapeIds[count] = i;
+        count += (table->Xmin[i] <= dataBox->Xmax) & (table->Ymin[i] <= dataBox->Ymax) &
+                 (table->Xmax[i] >= dataBox->Xmin) & (table->Ymax[i] >= dataBox->Ymin);
+    }
+
+    return count;
+}
+
+
+#ifdef SHPENVTAB_SIMD_X86
+
+SHPENVTAB_TARGET("sse2")
+static int shpEnvelopeCullSSE2(const shpEnvelopeTable *table, const CGBox2D *dataBox, int *shapeIds)
+{
+    int i, bits, count = 0;
+    const int n = table->nEntities;
+
+    const __m128d qXmin = _mm_set1_pd(dataBox->Xmin);
+    const __m128d qYmin = _mm_set1_pd(dataBox->Ymin);
+    const __m128d qXmax = _mm_set1_pd(dataBox->Xmax);
+    const __m128d qYmax = _mm_set1_pd(dataBox->Ymax);
+
+    for (i = 0; i + 2 <= n; i += 2) {
+        __m128d m = _mm_and_pd(_mm_cmple_pd(_mm_loadu_pd(table->Xmin + i), qXmax),
+                               _mm_cmple_pd(_mm_loadu_pd(table->Ymin + i), qYmax));
+        m = _mm_and_pd(m, _mm_cmpge_pd(_mm_loadu_pd(table->Xmax + i), qXmin));
+        m = _mm_and_pd(m, _mm_cmpge_pd(_mm_loadu_pd(table->Ymax + i), qYmin));
+
+        bits = _mm_movemask_pd(m);
+
+        shapeIds[count] = i;
+        count += (bits & 1);
+        shapeIds[count] = i + 1;
+        count += ((bits >> 1) & 1);
+    }
+
+    for (; i < n; i++) {
+        shapeIds[count] = i;
+        count += (table->Xmin[i] <= dataBox->Xmax) & (table->Ymin[i] <= dataBox->Ymax) &
+                 (table->Xmax[i] >= dataBox->Xmin) & (table->Ymax[i] >= dataBox->Ymin);
+    }
+
+    return count;
+}
+
+
+SHPENVTAB_TARGET("avx")
+static int shpEnvelopeCullAVX(const shpEnvelopeTable *table, const CGBox2D *dataBox, int *shapeIds)
+{
+    int i, bits, count = 0;
+    const int n = table->nEntities;
+
+    const __m256d qXmin = _mm256_set1_pd(dataBox->Xmin);
+    const __m256d qYmin = _mm256_set1_pd(dataBox->Ymin);
+    const __m256d qXmax = _mm256_set1_pd(dataBox->Xmax);
+    const __m256d qYmax = _mm256_set1_pd(dataBox->Ymax);
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m256d m = _mm256_and_pd(_mm256_cmp_pd(_mm256_loadu_pd(table->Xmin + i), qXmax, _CMP_LE_OQ),
+                                  _mm256_cmp_pd(_mm256_loadu_pd(table->Ymin + i), qYmax, _CMP_LE_OQ));
+        m = _mm256_and_pd(m, _mm256_cmp_pd(_mm256_loadu_pd(table->Xmax + i), qXmin, _CMP_GE_OQ));
+        m = _mm256_and_pd(m, _mm256_cmp_pd(_mm256_loadu_pd(table->Ymax + i), qYmin, _CMP_GE_OQ));
+
+        bits = _mm256_movemask_pd(m);
+
+        shapeIds[count] = i;
+        count += (bits & 1);
+        shapeIds[count] = i + 1;
+        count += ((bits >> 1) & 1);
+        shapeIds[count] = i + 2;
+        count += ((bits >> 2) & 1);
+        shapeIds[count] = i + 3;
+        count += ((bits >> 3) & 1);
+    }
+
+    for (; i < n; i++) {
+        shapeIds[count] = i;
+        count += (table->Xmin[i] <= dataBox->Xmax) & (table->Ymin[i] <= dataBox->Ymax) &
+                 (table->Xmax[i] >= dataBox->Xmin) & (table->Ymax[i] >= dataBox->Ymin);
+    }
+
+    return count;
+}
+
+
+static int cpuHasAVX(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    // OSXSAVE and AVX, and OS saves YMM registers
+    if ((info[2] & (1 << 27)) && (info[2] & (1 << 28))) {
+        return ((_xgetbv(0) & 6) == 6);
+    }
+    return 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+#endif
+}
+
+
+static int cpuHasSSE2(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return ((info[3] & (1 << 26)) != 0);
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+#endif /* SHPENVTAB_SIMD_X86 */
+
+
+static shpEnvelopeCullFunc cullFunc = 0;
+
+static pthread_once_t cullFuncOnce = PTHREAD_ONCE_INIT;
+
+
+static void shpEnvelopeCullInit(void)
+{
+#ifdef SHPENVTAB_SIMD_X86
+    if (cpuHasAVX()) {
+        cullFunc = shpEnvelopeCullAVX;
+    } else if (cpuHasSSE2()) {
+        cullFunc = shpEnvelopeCullSSE2;
+    } else {
+        cullFunc = shpEnvelopeCullScalar;
+    }
+#else
+    cullFunc = shpEnvelopeCullScalar;
+#endif
+}
+
+
+/**
+ * kernel is selected once by the first caller, culling threads wait for it
+ */
+static shpEnvelopeCullFunc shpEnvelopeCullSelect(void)
+{
+    pthread_once(&cullFuncOnce, shpEnvelopeCullInit);
+    return cullFunc;
+}
+
+
+int shpEnvelopeTableCull(const shpEnvelopeTable *table, const CGBox2D *dataBox, int **shapeIds, int *capacity)
+{
+    if (table->nEntities <= 0) {
+        return 0;
+    }
+
+    if (*capacity < table->nEntities) {
+        *capacity = table->nEntities;
+        *shapeIds = (int *) mem_realloc(*shapeIds, sizeof(int) * (*capacity));
+    }
+
+    return shpEnvelopeCullSelect()(table, dataBox, *shapeIds);
+}
+
+
+int shpEnvelopeTableProbe(const shpEnvelopeTable *table, const CGBox2D *dataBox, int maxFound, int *shapeIds)
+{
+    int i, count = 0;
+
+    // a few hits are wanted, no kernel pays off
+    for (i = 0; i < table->nEntities && count < maxFound; i++) {
+        if (table->Xmin[i] <= dataBox->Xmax && table->Ymin[i] <= dataBox->Ymax &&
+            table->Xmax[i] >= dataBox->Xmin && table->Ymax[i] >= dataBox->Ymin) {
+            shapeIds[count++] = i;
+        }
+    }
+
+    return count;
+}
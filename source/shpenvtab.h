@@ -0,0 +1,101 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shpenvtab.h
+ * @brief structure-of-arrays table of shape envelopes with SIMD culling.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.3
+ *
+ * @since 2024-10-19 10:11:45
+ * @date 2024-10-24 13:02:00
+ *
+ * @note
+ *   Envelopes of all records are read in one sequential pass over .shp.
+ *   Null shapes get an empty envelope (Xmin > Xmax) and never overlap.
+ */
+#ifndef SHP_ENVELOPE_TABLE_H__
+#define SHP_ENVELOPE_TABLE_H__
+
+#ifdef    __cplusplus
+extern "C" {
+#endif
+
+#include "shpfilemap.h"
+
+
+typedef struct
+{
+    int nEntities;
+
+    // arrays are borrowed from a mapped .shpc file, not owned
+    int borrowed;
+
+    double *Xmin;
+    double *Ymin;
+    double *Xmax;
+    double *Ymax;
+} shpEnvelopeTable;
+
+
+/**
+ * load envelopes of all records.
+ *   if fileMap is mapped, it is used instead of reading shpfile.
+ * returns 0 on success.
+ */
+extern int shpEnvelopeTableLoad(shpEnvelopeTable *table, const char *shpfile, const shpFileMap *fileMap, int nEntities);
+
+extern void shpEnvelopeTableFree(shpEnvelopeTable *table);
+
+/**
+ * collect ids of shapes whose envelopes overlap the dataBox (inclusive).
+ *   *shapeIds is (re)allocated by mem_realloc and must be freed by caller.
+ * returns number of ids in ascending order.
+ */
+extern int shpEnvelopeTableCull(const shpEnvelopeTable *table, const CGBox2D *dataBox, int **shapeIds, int *capacity);
+
+/**
+ * as shpEnvelopeTableCull, but stops once maxFound ids are put in shapeIds,
+ *   which must hold maxFound items.
+ * returns number of ids in ascending order, at most maxFound.
+ */
+extern int shpEnvelopeTableProbe(const shpEnvelopeTable *table, const CGBox2D *dataBox, int maxFound, int *shapeIds);
+
+
+/**
+ * get envelope of shape. returns 0 for null shape.
+ */
+STATIC_INLINE int shpEnvelopeTableGet(const shpEnvelopeTable *table, int nShapeId, CGBox2D *envelope)
+{
+    envelope->Xmin = table->Xmin[nShapeId];
+    envelope->Ymin = table->Ymin[nShapeId];
+    envelope->Xmax = table->Xmax[nShapeId];
+    envelope->Ymax = table->Ymax[nShapeId];
+    return (envelope->Xmin <= envelope->Xmax);
+}
+
+#ifdef    __cplusplus
+}
+#endif
+#endif /* SHP_ENVELOPE_TABLE_H__ */
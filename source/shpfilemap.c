@@ -0,0 +1,546 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shpfilemap.c
+ * @brief memory-mapped zero-copy reader for .shp/.shx file pair.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.7
+ *
+ * @since 2024-10-18 09:30:05
+ * @date 2024-10-24 14:05:00
+ *
+ * @note
+ */
+#include "shpfilemap.h"
+
+#include <common/memapi.h>
+
+#if defined(WIN32API)
+#   include <io.h>
+#   include <fcntl.h>
+#   include <sys/stat.h>
+#   include <common/win32/mman.h>
+
+#   define shpmap_open_rdonly(path)   _open((path), _O_RDONLY | _O_BINARY)
+#   define shpmap_close(fd)           _close(fd)
+
+typedef struct __stat64 shpmap_stat_t;
+#   define shpmap_stat(path, st)      _stat64((path), (st))
+
+STATIC_INLINE sb8 shpmap_filesize(int fd)
+{
+    struct __stat64 st;
+    if (_fstat64(fd, &st) == 0) {
+        return (sb8) st.st_size;
+    }
+    return (-1);
+}
+#else
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/stat.h>
+#   include <sys/mman.h>
+
+#   define shpmap_open_rdonly(path)   open((path), O_RDONLY)
+#   define shpmap_close(fd)           close(fd)
+
+typedef struct stat shpmap_stat_t;
+#   define shpmap_stat(path, st)      stat((path), (st))
+
+STATIC_INLINE sb8 shpmap_filesize(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        return (sb8) st.st_size;
+    }
+    return (-1);
+}
+#endif
+
+
+// start index of the only part of point and multipoint records
+static const int shpPointPartStart[1] = { 0 };
+
+
+int shpFileSidecarPath(const char *shpfile, const char *sidecarExt, char *pathbuf, int bufsize)
+{
+    int i, upper;
+    int len = (int) strlen(shpfile);
+    int extlen = (int) strlen(sidecarExt);
+
+    if (len < 4 || shpfile[len - 4] != '.' || extlen < 2 || sidecarExt[0] != '.' || len - 4 + extlen >= bufsize) {
+        return (-1);
+    }
+
+    // a.shp => a.shx, A.SHP => A.SHX
+    upper = isupper((ub1)shpfile[len - 3]);
+
+    memcpy(pathbuf, shpfile, len - 4);
+    for (i = 0; i < extlen; i++) {
+        pathbuf[len - 4 + i] = (upper ? toupper((ub1)sidecarExt[i]) : sidecarExt[i]);
+    }
+    pathbuf[len - 4 + extlen] = '\0';
+
+    return len - 4 + extlen;
+}
+
+
+sb8 shpFileGetMTime(const char *pathfile)
+{
+    shpmap_stat_t st;
+    if (shpmap_stat(pathfile, &st) == 0) {
+        return (sb8) st.st_mtime;
+    }
+    return (-1);
+}
+
+
+/**
+ * read first 100 bytes of file. returns 0 on success.
+ */
+static int shpFileReadHeaderBytes(const char *pathfile, ub1 *buf)
+{
+    size_t n;
+
+    FILE *fp = fopen(pathfile, "rb");
+    if (! fp) {
+        printf("Error: Cannot open file: %s\n", pathfile);
+        return (-1);
+    }
+
+    n = fread(buf, 1, SHPFILE_HEADER_SIZE, fp);
+    fclose(fp);
+
+    // file code: 9994
+    if (n != SHPFILE_HEADER_SIZE || shpBytesBigInt32(buf) != 9994) {
+        printf("Error: Bad file header: %s\n", pathfile);
+        return (-1);
+    }
+    return 0;
+}
+
+
+int shpFileReadHeader(const char *shpfile, shpFileHeader *header)
+{
+    ub1 buf[SHPFILE_HEADER_SIZE];
+    char shxfile[260];
+    sb8 shxLength;
+
+    if (shpFileSidecarPath(shpfile, ".shx", shxfile, sizeof(shxfile)) < 0) {
+        printf("Error: Bad shp file: %s\n", shpfile);
+        return (-1);
+    }
+
+    if (shpFileReadHeaderBytes(shxfile, buf) != 0) {
+        return (-1);
+    }
+
+    // file length in 16-bit words
+    shxLength = (sb8)(ub4) shpBytesBigInt32(buf + 24) * 2;
+    if (shxLength < SHPFILE_HEADER_SIZE) {
+        printf("Error: Bad shx file length: %s\n", shxfile);
+        return (-1);
+    }
+    header->nEntities = (int)((shxLength - SHPFILE_HEADER_SIZE) / 8);
+
+    if (shpFileReadHeaderBytes(shpfile, buf) != 0) {
+        return (-1);
+    }
+
+    header->nShapeType = shpBytesLittleInt32(buf + 32);
+
+    // Xmin, Ymin, Xmax, Ymax, Zmin, Zmax, Mmin, Mmax
+    header->minBounds[0] = shpBytesLittleDouble(buf + 36);
+    header->minBounds[1] = shpBytesLittleDouble(buf + 44);
+    header->maxBounds[0] = shpBytesLittleDouble(buf + 52);
+    header->maxBounds[1] = shpBytesLittleDouble(buf + 60);
+    header->minBounds[2] = shpBytesLittleDouble(buf + 68);
+    header->maxBounds[2] = shpBytesLittleDouble(buf + 76);
+    header->minBounds[3] = shpBytesLittleDouble(buf + 84);
+    header->maxBounds[3] = shpBytesLittleDouble(buf + 92);
+
+    return 0;
+}
+
+
+const ub1 * shpFileMapBytes(const char *pathfile, size_t *mapsize)
+{
+    void *addr;
+    sb8 fsize;
+
+    int fd = shpmap_open_rdonly(pathfile);
+    if (fd == -1) {
+        printf("Error: Cannot open file: %s\n", pathfile);
+        return 0;
+    }
+
+    fsize = shpmap_filesize(fd);
+    if (fsize <= 0) {
+        printf("Error: Bad file size(%" PRId64 "): %s\n", (int64_t) fsize, pathfile);
+        shpmap_close(fd);
+        return 0;
+    }
+
+    addr = mmap(0, (size_t) fsize, PROT_READ, MAP_SHARED, fd, 0);
+
+    // mapping keeps a reference to file
+    shpmap_close(fd);
+
+    if (addr == MAP_FAILED) {
+        printf("Error: mmap() failed: %s\n", pathfile);
+        return 0;
+    }
+
+    *mapsize = (size_t) fsize;
+    return (const ub1 *) addr;
+}
+
+
+void shpFileUnmapBytes(const ub1 *addr, size_t mapsize)
+{
+    if (addr) {
+        munmap((void *) addr, mapsize);
+    }
+}
+
+
+int shpFileMapOpen(shpFileMap *fmap, const char *shpfile)
+{
+    char shxfile[260];
+
+    bzero(fmap, sizeof(shpFileMap));
+
+    if (shpFileSidecarPath(shpfile, ".shx", shxfile, sizeof(shxfile)) < 0) {
+        printf("Error: Bad shp file: %s\n", shpfile);
+        return -1;
+    }
+
+    fmap->shpAddr = shpFileMapBytes(shpfile, &fmap->shpSize);
+    if (! fmap->shpAddr) {
+        return -1;
+    }
+
+    fmap->shxAddr = shpFileMapBytes(shxfile, &fmap->shxSize);
+    if (! fmap->shxAddr || fmap->shxSize < SHPFILE_HEADER_SIZE || fmap->shpSize < SHPFILE_HEADER_SIZE) {
+        printf("Error: Bad shp or shx file: %s\n", shpfile);
+        shpFileMapClose(fmap);
+        return -1;
+    }
+
+    fmap->nEntities = (int)((fmap->shxSize - SHPFILE_HEADER_SIZE) / 8);
+
+    // All success
+    return 0;
+}
+
+
+void shpFileMapClose(shpFileMap *fmap)
+{
+    shpFileUnmapBytes(fmap->shxAddr, fmap->shxSize);
+    shpFileUnmapBytes(fmap->shpAddr, fmap->shpSize);
+    bzero(fmap, sizeof(shpFileMap));
+}
+
+
+void shpFileMapAdviseXY(const shpFileMap *fmap)
+{
+#if !defined(WIN32API)
+    // no read-around: only pages addressed by views are faulted in
+    if (fmap->shpAddr && madvise((void *) fmap->shpAddr, fmap->shpSize, MADV_RANDOM) != 0) {
+        printf("Warn: madvise() failed on shp file\n");
+    }
+#endif
+}
+
+
+/**
+ * get content of record and its length in bytes. returns 0 if bad record.
+ */
+STATIC_INLINE const ub1 * shpFileMapRecord(const shpFileMap *fmap, int nShapeId, int *contentLength)
+{
+    const ub1 *shxrec;
+    size_t offset, length;
+
+    if (nShapeId < 0 || nShapeId >= fmap->nEntities) {
+        return 0;
+    }
+
+    shxrec = fmap->shxAddr + SHPFILE_HEADER_SIZE + (size_t) nShapeId * 8;
+
+    // offset and content length are in 16-bit words
+    offset = (size_t)(ub4) shpBytesBigInt32(shxrec) * 2 + SHPFILE_RECHDR_SIZE;
+    length = (size_t)(ub4) shpBytesBigInt32(shxrec + 4) * 2;
+
+    if (length < 4 || offset + length > fmap->shpSize) {
+        return 0;
+    }
+
+    *contentLength = (int) length;
+    return fmap->shpAddr + offset;
+}
+
+
+int shpFileMapGetEnvelope(const shpFileMap *fmap, int nShapeId, CGBox2D *envelope)
+{
+    int length;
+
+    const ub1 *content = shpFileMapRecord(fmap, nShapeId, &length);
+    if (! content) {
+        return SHPT_NULL;
+    }
+
+    return shpFileRecordEnvelope(content, length, envelope);
+}
+
+
+int shpFileRecordEnvelope(const ub1 *content, int length, CGBox2D *envelope)
+{
+    int shptype;
+
+    shptype = shpBytesLittleInt32(content);
+
+    switch (shptype) {
+    case 1: case 11: case 21:
+        // Point, PointZ, PointM: X, Y
+        if (length < 20) {
+            return SHPT_NULL;
+        }
+        envelope->Xmin = envelope->Xmax = shpBytesLittleDouble(content + 4);
+        envelope->Ymin = envelope->Ymax = shpBytesLittleDouble(content + 12);
+        break;
+
+    case 3: case 13: case 23:
+    case 5: case 15: case 25:
+    case 8: case 18: case 28:
+    case 31:
+        // Xmin, Ymin, Xmax, Ymax
+        if (length < 36) {
+            return SHPT_NULL;
+        }
+        envelope->Xmin = shpBytesLittleDouble(content + 4);
+        envelope->Ymin = shpBytesLittleDouble(content + 12);
+        envelope->Xmax = shpBytesLittleDouble(content + 20);
+        envelope->Ymax = shpBytesLittleDouble(content + 28);
+        break;
+
+    default:
+        return SHPT_NULL;
+    }
+
+    return shptype;
+}
+
+
+int shpFileRecordLayout(const ub1 *content, int length, int nShapeId, int *nParts, int *nPoints, int *partsOffset, int *pointsOffset)
+{
+    int partBytes;
+    sb8 endOffset;
+
+    switch (shpBytesLittleInt32(content)) {
+    case 1: case 11: case 21:
+        *nParts = 1;
+        *nPoints = 1;
+        *partsOffset = 4;
+        partBytes = 0;
+        break;
+
+    case 8: case 18: case 28:
+        *nParts = 1;
+        *nPoints = (length < 40 ? -1 : shpBytesLittleInt32(content + 36));
+        *partsOffset = 40;
+        partBytes = 0;
+        break;
+
+    case 3: case 13: case 23:
+    case 5: case 15: case 25:
+        *nParts = (length < 44 ? -1 : shpBytesLittleInt32(content + 36));
+        *nPoints = (length < 44 ? -1 : shpBytesLittleInt32(content + 40));
+        *partsOffset = 44;
+        partBytes = 4;
+        break;
+
+    case 31:
+        // MultiPatch has part types after part starts
+        *nParts = (length < 44 ? -1 : shpBytesLittleInt32(content + 36));
+        *nPoints = (length < 44 ? -1 : shpBytesLittleInt32(content + 40));
+        *partsOffset = 44;
+        partBytes = 8;
+        break;
+
+    default:
+        return 0;
+    }
+
+    if (*nParts < 1 || *nPoints < 0 || *nParts > length / 4 || *nPoints > length / 16) {
+        printf("Warn: bad record of shape#%d\n", nShapeId);
+        return 0;
+    }
+
+    endOffset = *partsOffset + (sb8) partBytes * (*nParts) + (sb8) (*nPoints) * 16;
+    if (endOffset > (sb8) length) {
+        printf("Warn: bad record of shape#%d\n", nShapeId);
+        return 0;
+    }
+
+    *pointsOffset = *partsOffset + partBytes * (*nParts);
+    return 1;
+}
+
+
+int shpFileMapGetGeom(const shpFileMap *fmap, int nShapeId, shpRecordBuf *alignBuf, shapeGeomView *view)
+{
+    int length, nParts, nPoints, partsOffset, pointsOffset, partBytes;
+    const ub1 *parts;
+
+    const ub1 *content = shpFileMapRecord(fmap, nShapeId, &length);
+    if (! content) {
+        return 0;
+    }
+
+    if (! shpFileRecordLayout(content, length, nShapeId, &nParts, &nPoints, &partsOffset, &pointsOffset)) {
+        return 0;
+    }
+
+    partBytes = pointsOffset - partsOffset;
+    parts = content + partsOffset;
+
+#ifndef SHAPEGEOM_UNALIGNED_OK
+    // records are only 2-byte aligned: part starts are 4-byte aligned
+    //   whenever X/Y are 8-byte aligned
+    if (((uintptr_t) (content + pointsOffset) & 7) != 0) {
+        // keep X/Y 8-byte aligned after an odd number of part starts
+        int pad = (partBytes & 7);
+        int bytes = partBytes + nPoints * 16;
+
+        parts = shpRecordBufReserve(alignBuf, pad + bytes) + pad;
+        memcpy((ub1 *) parts, content + partsOffset, bytes);
+    }
+#else
+    (void) alignBuf;
+#endif
+
+    view->nShapeId = nShapeId;
+    view->nParts = nParts;
+    view->nPoints = nPoints;
+    view->panPartStart = (partBytes > 0 ? (const shapeGeomInt *) parts : shpPointPartStart);
+    view->pPoints = (const shapeGeomPoint *) (parts + partBytes);
+
+    return shpFileCheckPartStarts(view->panPartStart, nParts, nPoints, nShapeId);
+}
+
+
+int shpFileCheckPartStarts(const shapeGeomInt SHAPEGEOM_UNALIGNED *panPartStart, int nParts, int nPoints, int nShapeId)
+{
+    int i;
+
+    for (i = 0; i < nParts; i++) {
+        if (panPartStart[i] < (i > 0 ? panPartStart[i - 1] : 0) || panPartStart[i] > nPoints) {
+            printf("Warn: bad part start of shape#%d\n", nShapeId);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+ub1 * shpRecordBufReserve(shpRecordBuf *buf, int bytes)
+{
+    if (buf->capacity < bytes) {
+        buf->capacity = CG_MAX(bytes, CG_MAX(4096, buf->capacity * 2));
+        buf->bytes = (ub1 *) mem_realloc(buf->bytes, (size_t) buf->capacity);
+    }
+    return buf->bytes;
+}
+
+
+void shpRecordBufFree(shpRecordBuf *buf)
+{
+    if (buf->bytes) {
+        mem_free(buf->bytes);
+    }
+    bzero(buf, sizeof(shpRecordBuf));
+}
+
+
+int shpFileMapGetZM(const shpFileMap *fmap, int nShapeId, const ub1 **zValues, const ub1 **mValues)
+{
+    int length, shptype, nParts, nPoints, partsOffset, pointsOffset;
+    sb8 offset;
+
+    const ub1 *content = shpFileMapRecord(fmap, nShapeId, &length);
+
+    *zValues = 0;
+    *mValues = 0;
+
+    if (! content) {
+        return 0;
+    }
+
+    if (! shpFileRecordLayout(content, length, nShapeId, &nParts, &nPoints, &partsOffset, &pointsOffset)) {
+        return 0;
+    }
+
+    shptype = shpBytesLittleInt32(content);
+    offset = pointsOffset + (sb8) nPoints * 16;
+
+    switch (shptype) {
+    case 11:
+        // PointZ: X, Y, Z [, M]
+        *zValues = content + 20;
+        if (length >= 36) {
+            *mValues = content + 28;
+        }
+        break;
+
+    case 21:
+        // PointM: X, Y, M
+        if (length >= 28) {
+            *mValues = content + 20;
+        }
+        break;
+
+    case 13: case 15: case 18: case 31:
+        // Zmin, Zmax, Z[nPoints] [, Mmin, Mmax, M[nPoints]]
+        if (offset + 16 + (sb8) nPoints * 8 > (sb8) length) {
+            printf("Warn: bad record of shape#%d\n", nShapeId);
+            return 0;
+        }
+        *zValues = content + offset + 16;
+        offset += 16 + (sb8) nPoints * 8;
+        if (offset + 16 + (sb8) nPoints * 8 <= (sb8) length) {
+            *mValues = content + offset + 16;
+        }
+        break;
+
+    case 23: case 25: case 28:
+        // Mmin, Mmax, M[nPoints]
+        if (offset + 16 + (sb8) nPoints * 8 <= (sb8) length) {
+            *mValues = content + offset + 16;
+        }
+        break;
+    }
+
+    return nPoints;
+}
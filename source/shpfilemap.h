@@ -0,0 +1,206 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shpfilemap.h
+ * @brief memory-mapped zero-copy reader for .shp/.shx file pair.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.7
+ *
+ * @since 2024-10-18 09:30:05
+ * @date 2024-10-24 14:05:00
+ *
+ * @note
+ *   ESRI Shapefile Technical Description (July 1998).
+ *   Records are handed out as shapeGeomView whose pPoints and panPartStart
+ *   point into the mapped pages. Only little-endian hosts are supported.
+ */
+#ifndef SHP_FILE_MAP_H__
+#define SHP_FILE_MAP_H__
+
+#ifdef    __cplusplus
+extern "C" {
+#endif
+
+#include <common/basetype.h>
+
+#include "shapegeom.h"
+
+
+// shp file header size in bytes
+#define SHPFILE_HEADER_SIZE    100
+
+// record header of .shp: record number and content length
+#define SHPFILE_RECHDR_SIZE    8
+
+
+typedef struct
+{
+    int nShapeType;
+
+    // number of records from size of .shx
+    int nEntities;
+
+    // Xmin, Ymin, Zmin, Mmin
+    double minBounds[4];
+    double maxBounds[4];
+} shpFileHeader;
+
+
+typedef struct
+{
+    // mapped .shp file
+    const ub1 *shpAddr;
+    size_t shpSize;
+
+    // mapped .shx file
+    const ub1 *shxAddr;
+    size_t shxSize;
+
+    int nEntities;
+} shpFileMap;
+
+
+/**
+ * bytes of a record copied out of file, or out of mapping on targets of
+ *   strict alignment, so that part starts and X/Y are aligned. grows on
+ *   demand.
+ */
+typedef struct
+{
+    ub1 *bytes;
+    int capacity;
+} shpRecordBuf;
+
+
+/**
+ * make path of sidecar file: "a.shp" + ".shx" => "a.shx", "a.shp" + ".shpc" => "a.shpc".
+ * returns length of sidecar path or -1 on error.
+ */
+extern int shpFileSidecarPath(const char *shpfile, const char *sidecarExt, char *pathbuf, int bufsize);
+
+/**
+ * last modification time of file in seconds. returns -1 on error.
+ */
+extern sb8 shpFileGetMTime(const char *pathfile);
+
+/**
+ * read 100-byte headers of .shp and .shx without opening records.
+ * returns 0 on success.
+ */
+extern int shpFileReadHeader(const char *shpfile, shpFileHeader *header);
+
+/**
+ * map whole file as read only. returns 0 on error.
+ */
+extern const ub1 * shpFileMapBytes(const char *pathfile, size_t *mapsize);
+
+extern void shpFileUnmapBytes(const ub1 *addr, size_t mapsize);
+
+/**
+ * map both the .shp and the .shx of shpfile. returns 0 on success.
+ */
+extern int shpFileMapOpen(shpFileMap *fmap, const char *shpfile);
+
+extern void shpFileMapClose(shpFileMap *fmap);
+
+/**
+ * advise that only X/Y of records will be read, so that Z/M pages of
+ *   PolygonZ/PolygonM files are not read around and faulted in.
+ */
+extern void shpFileMapAdviseXY(const shpFileMap *fmap);
+
+/**
+ * get bounding box of a shape record.
+ * returns shp type of record, 0 (SHPT_NULL) for null or bad record.
+ */
+extern int shpFileMapGetEnvelope(const shpFileMap *fmap, int nShapeId, CGBox2D *envelope);
+
+/**
+ * get view of a shape record: zero-copy into mapping, except on targets of
+ *   strict alignment where a record whose X/Y are not 8-byte aligned is
+ *   copied into alignBuf. returns 1 on success, 0 on null or bad record.
+ */
+extern int shpFileMapGetGeom(const shpFileMap *fmap, int nShapeId, shpRecordBuf *alignBuf, shapeGeomView *view);
+
+/**
+ * get bounding box from record content (at least min(length, 36) bytes).
+ * returns shp type of record, 0 (SHPT_NULL) for null or bad record.
+ */
+extern int shpFileRecordEnvelope(const ub1 *content, int length, CGBox2D *envelope);
+
+/**
+ * get counts of parts and points and where they start in record content.
+ *   content: at least min(length, 44) bytes of record content
+ *   length: content length of record from .shx
+ * returns 1 on success, 0 on null or bad record.
+ */
+extern int shpFileRecordLayout(const ub1 *content, int length, int nShapeId, int *nParts, int *nPoints, int *partsOffset, int *pointsOffset);
+
+/**
+ * test that part starts of a record read from file are ascending and in
+ *   [0, nPoints], so that parts never index out of points.
+ * returns 1 if valid.
+ */
+extern int shpFileCheckPartStarts(const shapeGeomInt SHAPEGEOM_UNALIGNED *panPartStart, int nParts, int nPoints, int nShapeId);
+
+/**
+ * make room for bytes in buf. returns buf->bytes.
+ */
+extern ub1 * shpRecordBufReserve(shpRecordBuf *buf, int bytes);
+
+extern void shpRecordBufFree(shpRecordBuf *buf);
+
+/**
+ * get Z and M values of a shape record as unaligned little-endian doubles.
+ *   *zValues or *mValues is 0 if the record has no Z or M.
+ * returns number of points, 0 on null or bad record.
+ */
+extern int shpFileMapGetZM(const shpFileMap *fmap, int nShapeId, const ub1 **zValues, const ub1 **mValues);
+
+
+/**
+ * read int32 from unaligned memory of .shp/.shx
+ */
+STATIC_INLINE int shpBytesBigInt32(const ub1 *b)
+{
+    return (int)(((ub4)b[0] << 24) | ((ub4)b[1] << 16) | ((ub4)b[2] << 8) | (ub4)b[3]);
+}
+
+STATIC_INLINE int shpBytesLittleInt32(const ub1 *b)
+{
+    return (int)(((ub4)b[3] << 24) | ((ub4)b[2] << 16) | ((ub4)b[1] << 8) | (ub4)b[0]);
+}
+
+STATIC_INLINE double shpBytesLittleDouble(const ub1 *b)
+{
+    double d;
+    memcpy(&d, b, sizeof(d));
+    return d;
+}
+
+#ifdef    __cplusplus
+}
+#endif
+#endif /* SHP_FILE_MAP_H__ */
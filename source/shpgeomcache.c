@@ -0,0 +1,347 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shpgeomcache.c
+ * @brief LRU cache of decoded, view-independent shape geometry.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.2
+ *
+ * @since 2024-10-21 09:40:18
+ * @date 2024-10-24 12:41:00
+ *
+ * @note
+ */
+#include "shpgeomcache.h"
+
+#include <common/memapi.h>
+
+
+#define SHPGEOMCACHE_BUCKETS_MIN    1024
+
+
+STATIC_INLINE ub8 shpGeomCacheHash(int fileId, sb8 mtime, int nShapeId)
+{
+    // splitmix64 finalizer
+    ub8 h = (ub8)(ub4) fileId ^ ((ub8) mtime * 0x9E3779B97F4A7C15ULL) ^ ((ub8)(ub4) nShapeId << 1);
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+
+STATIC_INLINE shpGeomCacheEntry ** shpGeomCacheBucket(shpGeomCache *cache, int fileId, sb8 mtime, int nShapeId)
+{
+    return &cache->buckets[shpGeomCacheHash(fileId, mtime, nShapeId) & (ub8)(cache->numBuckets - 1)];
+}
+
+
+static void shpGeomCacheUnlink(shpGeomCache *cache, shpGeomCacheEntry *entry)
+{
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        cache->head = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        cache->tail = entry->prev;
+    }
+    entry->prev = entry->next = 0;
+}
+
+
+static void shpGeomCachePushFront(shpGeomCache *cache, shpGeomCacheEntry *entry)
+{
+    entry->prev = 0;
+    entry->next = cache->head;
+    if (cache->head) {
+        cache->head->prev = entry;
+    } else {
+        cache->tail = entry;
+    }
+    cache->head = entry;
+}
+
+
+static void shpGeomCacheRemove(shpGeomCache *cache, shpGeomCacheEntry *entry)
+{
+    shpGeomCacheEntry **pp = shpGeomCacheBucket(cache, entry->fileId, entry->mtime, entry->nShapeId);
+
+    while (*pp != entry) {
+        pp = &(*pp)->hnext;
+    }
+    *pp = entry->hnext;
+
+    shpGeomCacheUnlink(cache, entry);
+
+    cache->bytes -= entry->bytes;
+    cache->numEntries--;
+    mem_free(entry);
+}
+
+
+/**
+ * double buckets when chains get long
+ */
+static void shpGeomCacheRehash(shpGeomCache *cache)
+{
+    int i, oldBuckets = cache->numBuckets;
+    shpGeomCacheEntry **old = cache->buckets;
+
+    cache->numBuckets = oldBuckets * 2;
+    cache->buckets = (shpGeomCacheEntry **) mem_alloc_zero(cache->numBuckets, sizeof(shpGeomCacheEntry *));
+
+    for (i = 0; i < oldBuckets; i++) {
+        shpGeomCacheEntry *entry = old[i];
+        while (entry) {
+            shpGeomCacheEntry *hnext = entry->hnext;
+            shpGeomCacheEntry **pp = shpGeomCacheBucket(cache, entry->fileId, entry->mtime, entry->nShapeId);
+            entry->hnext = *pp;
+            *pp = entry;
+            entry = hnext;
+        }
+    }
+
+    mem_free(old);
+}
+
+
+static shpGeomCacheEntry * shpGeomCacheFind(shpGeomCache *cache, int fileId, sb8 mtime, int nShapeId)
+{
+    shpGeomCacheEntry *entry = *shpGeomCacheBucket(cache, fileId, mtime, nShapeId);
+
+    while (entry) {
+        if (entry->nShapeId == nShapeId && entry->fileId == fileId && entry->mtime == mtime) {
+            return entry;
+        }
+        entry = entry->hnext;
+    }
+    return 0;
+}
+
+
+STATIC_INLINE void shpGeomCachePinView(shpGeomCache *cache, shpGeomCacheEntry *entry, shapeGeomView *view)
+{
+    entry->refs++;
+
+    // most recently used
+    shpGeomCacheUnlink(cache, entry);
+    shpGeomCachePushFront(cache, entry);
+
+    shpGeomCacheEntryView(entry, view);
+}
+
+
+shpGeomCache * shpGeomCacheCreate(size_t budget)
+{
+    shpGeomCache *cache = (shpGeomCache *) mem_alloc_zero(1, sizeof(shpGeomCache));
+
+    if (pthread_mutex_init(&cache->lock, 0) != 0) {
+        printf("Error: pthread_mutex_init() failed\n");
+        mem_free(cache);
+        return 0;
+    }
+
+    cache->budget = budget;
+    cache->numBuckets = SHPGEOMCACHE_BUCKETS_MIN;
+    cache->buckets = (shpGeomCacheEntry **) mem_alloc_zero(cache->numBuckets, sizeof(shpGeomCacheEntry *));
+
+    return cache;
+}
+
+
+void shpGeomCacheDestroy(shpGeomCache *cache)
+{
+    shpGeomCacheEntry *entry = cache->head;
+
+    while (entry) {
+        shpGeomCacheEntry *next = entry->next;
+        mem_free(entry);
+        entry = next;
+    }
+
+    while (cache->numFiles-- > 0) {
+        mem_free(cache->files[cache->numFiles]);
+    }
+    mem_free(cache->files);
+
+    mem_free(cache->buckets);
+    pthread_mutex_destroy(&cache->lock);
+    mem_free(cache);
+}
+
+
+int shpGeomCacheFileId(shpGeomCache *cache, const char *pathfile)
+{
+    int fileId;
+    size_t len = strlen(pathfile);
+
+    pthread_mutex_lock(&cache->lock);
+
+    // a few files per process, opened once
+    for (fileId = 0; fileId < cache->numFiles; fileId++) {
+        if (! strcmp(cache->files[fileId], pathfile)) {
+            pthread_mutex_unlock(&cache->lock);
+            return fileId;
+        }
+    }
+
+    cache->files = (char **) mem_realloc(cache->files, sizeof(char *) * (cache->numFiles + 1));
+    cache->files[fileId] = (char *) mem_alloc_unset(len + 1);
+    memcpy(cache->files[fileId], pathfile, len + 1);
+    cache->numFiles++;
+
+    pthread_mutex_unlock(&cache->lock);
+    return fileId;
+}
+
+
+const shpGeomCacheEntry * shpGeomCacheGet(shpGeomCache *cache, int fileId, sb8 mtime, int nShapeId, shapeGeomView *view)
+{
+    shpGeomCacheEntry *entry;
+
+    pthread_mutex_lock(&cache->lock);
+
+    entry = shpGeomCacheFind(cache, fileId, mtime, nShapeId);
+    if (entry) {
+        shpGeomCachePinView(cache, entry, view);
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+    return entry;
+}
+
+
+const shpGeomCacheEntry * shpGeomCachePut(shpGeomCache *cache, int fileId, sb8 mtime, const shapeGeomView *src, shapeGeomView *view)
+{
+    shpGeomCacheEntry *entry, *victim, **pp;
+
+    size_t partsBytes = sizeof(int) * (size_t) src->nParts;
+    size_t bytes = sizeof(shpGeomCacheEntry) + partsBytes + sizeof(SHPPointType) * (size_t) src->nPoints;
+
+    if (bytes > cache->budget) {
+        return 0;
+    }
+
+    // copy outside of lock. points follow parts aligned to 8 bytes
+    partsBytes = (partsBytes + 7) & ~(size_t) 7;
+    bytes = sizeof(shpGeomCacheEntry) + partsBytes + sizeof(SHPPointType) * (size_t) src->nPoints;
+
+    entry = (shpGeomCacheEntry *) mem_alloc_unset(bytes);
+    bzero(entry, sizeof(shpGeomCacheEntry));
+
+    entry->fileId = fileId;
+    entry->mtime = mtime;
+    entry->nShapeId = src->nShapeId;
+    entry->bytes = bytes;
+    entry->nParts = src->nParts;
+    entry->nPoints = src->nPoints;
+    entry->panPartStart = (int *) (entry + 1);
+    entry->pPoints = (SHPPointType *) ((ub1 *) entry->panPartStart + partsBytes);
+
+    memcpy(entry->panPartStart, src->panPartStart, sizeof(int) * (size_t) src->nParts);
+    memcpy(entry->pPoints, src->pPoints, sizeof(SHPPointType) * (size_t) src->nPoints);
+
+    pthread_mutex_lock(&cache->lock);
+
+    victim = shpGeomCacheFind(cache, fileId, mtime, src->nShapeId);
+    if (victim) {
+        // put by another thread
+        mem_free(entry);
+        shpGeomCachePinView(cache, victim, view);
+        pthread_mutex_unlock(&cache->lock);
+        return victim;
+    }
+
+    // evict least recently used unpinned entries
+    victim = cache->tail;
+    while (victim && cache->bytes + bytes > cache->budget) {
+        shpGeomCacheEntry *prev = victim->prev;
+        if (! victim->refs) {
+            shpGeomCacheRemove(cache, victim);
+            cache->evictions++;
+        }
+        victim = prev;
+    }
+
+    if (cache->bytes + bytes > cache->budget) {
+        // all pinned
+        pthread_mutex_unlock(&cache->lock);
+        mem_free(entry);
+        return 0;
+    }
+
+    if (cache->numEntries >= cache->numBuckets * 2) {
+        shpGeomCacheRehash(cache);
+    }
+
+    pp = shpGeomCacheBucket(cache, fileId, mtime, src->nShapeId);
+    entry->hnext = *pp;
+    *pp = entry;
+
+    shpGeomCachePushFront(cache, entry);
+    cache->bytes += bytes;
+    cache->numEntries++;
+
+    shpGeomCachePinView(cache, entry, view);
+
+    pthread_mutex_unlock(&cache->lock);
+    return entry;
+}
+
+
+void shpGeomCacheRelease(shpGeomCache *cache, const shpGeomCacheEntry *entry)
+{
+    pthread_mutex_lock(&cache->lock);
+    ((shpGeomCacheEntry *) entry)->refs--;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+
+void shpGeomCacheGetStats(shpGeomCache *cache, shpGeomCacheStats *stats)
+{
+    pthread_mutex_lock(&cache->lock);
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->entries = cache->numEntries;
+    stats->bytes = cache->bytes;
+    stats->budget = cache->budget;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+
+void shpGeomCachePrintStats(shpGeomCache *cache)
+{
+    shpGeomCacheStats stats;
+    shpGeomCacheGetStats(cache, &stats);
+
+    printf("Info: geometry cache: hits=%" PRIu64 ", misses=%" PRIu64 ", evictions=%" PRIu64 ", entries=%d, bytes=%" PRIu64 "/%" PRIu64 "\n",
+        (uint64_t) stats.hits, (uint64_t) stats.misses, (uint64_t) stats.evictions, stats.entries, (uint64_t) stats.bytes, (uint64_t) stats.budget);
+}
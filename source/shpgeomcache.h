@@ -0,0 +1,164 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shpgeomcache.h
+ * @brief LRU cache of decoded, view-independent shape geometry.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.2
+ *
+ * @since 2024-10-21 09:40:18
+ * @date 2024-10-24 12:41:00
+ *
+ * @note
+ *   Entries are keyed by (file id, mtime, shape id) so that one cache can
+ *   be shared by all layers of a process and a rewritten shp file never
+ *   hits stale geometry. File ids are interned paths of the cache, so that
+ *   two files never share a key. Parts and points of an entry are copied into one
+ *   allocation. Entries in use are pinned and never evicted; the least
+ *   recently used unpinned entries are evicted when the byte budget is
+ *   exceeded. All calls are thread-safe.
+ */
+#ifndef SHP_GEOM_CACHE_H__
+#define SHP_GEOM_CACHE_H__
+
+#ifdef    __cplusplus
+extern "C" {
+#endif
+
+#include "shapegeom.h"
+
+#include <common/basetype.h>
+
+#include <pthread.h>
+
+
+
+typedef struct shpGeomCacheEntry_t
+{
+    // hash chain
+    struct shpGeomCacheEntry_t *hnext;
+
+    // LRU list, head is most recently used
+    struct shpGeomCacheEntry_t *prev;
+    struct shpGeomCacheEntry_t *next;
+
+    int fileId;
+    sb8 mtime;
+    int nShapeId;
+
+    int refs;
+    size_t bytes;
+
+    int nParts;
+    int nPoints;
+    int *panPartStart;
+    SHPPointType *pPoints;
+} shpGeomCacheEntry;
+
+
+typedef struct
+{
+    ub8 hits;
+    ub8 misses;
+    ub8 evictions;
+
+    int entries;
+    size_t bytes;
+    size_t budget;
+} shpGeomCacheStats;
+
+
+typedef struct
+{
+    pthread_mutex_t lock;
+
+    size_t budget;
+    size_t bytes;
+
+    int numBuckets;
+    int numEntries;
+    shpGeomCacheEntry **buckets;
+
+    shpGeomCacheEntry *head;
+    shpGeomCacheEntry *tail;
+
+    // interned paths, index is file id
+    int numFiles;
+    char **files;
+
+    ub8 hits;
+    ub8 misses;
+    ub8 evictions;
+} shpGeomCache;
+
+
+/**
+ * create cache with a budget in bytes. returns 0 on error.
+ */
+extern shpGeomCache * shpGeomCacheCreate(size_t budget);
+
+extern void shpGeomCacheDestroy(shpGeomCache *cache);
+
+/**
+ * id of file path in cache, combined with mtime to identify a version of
+ *   file. the same path always gets the same id.
+ */
+extern int shpGeomCacheFileId(shpGeomCache *cache, const char *pathfile);
+
+/**
+ * look up geometry of shape. on hit, view is set and the entry is pinned
+ *   until shpGeomCacheRelease(). returns 0 on miss.
+ */
+extern const shpGeomCacheEntry * shpGeomCacheGet(shpGeomCache *cache, int fileId, sb8 mtime, int nShapeId, shapeGeomView *view);
+
+/**
+ * copy geometry of src into cache and pin it, view is set to the copy.
+ *   returns 0 if it does not fit in budget, then src should be used.
+ */
+extern const shpGeomCacheEntry * shpGeomCachePut(shpGeomCache *cache, int fileId, sb8 mtime, const shapeGeomView *src, shapeGeomView *view);
+
+extern void shpGeomCacheRelease(shpGeomCache *cache, const shpGeomCacheEntry *entry);
+
+extern void shpGeomCacheGetStats(shpGeomCache *cache, shpGeomCacheStats *stats);
+
+extern void shpGeomCachePrintStats(shpGeomCache *cache);
+
+
+/**
+ * make view of a pinned entry
+ */
+STATIC_INLINE void shpGeomCacheEntryView(const shpGeomCacheEntry *entry, shapeGeomView *view)
+{
+    view->nShapeId = entry->nShapeId;
+    view->nParts = entry->nParts;
+    view->nPoints = entry->nPoints;
+    view->panPartStart = entry->panPartStart;
+    view->pPoints = entry->pPoints;
+}
+
+#ifdef    __cplusplus
+}
+#endif
+#endif /* SHP_GEOM_CACHE_H__ */
@@ -0,0 +1,478 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shpindex.c
+ * @brief packed Hilbert R-tree sidecar index (.sti) of shape envelopes.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.3
+ *
+ * @since 2024-10-18 14:05:31
+ * @date 2024-10-24 14:20:00
+ *
+ * @note
+ *   https://github.com/mourner/flatbush
+ */
+#include "shpindex.h"
+#include "shpfilemap.h"
+
+#include <common/memapi.h>
+
+
+#define SHPINDEX_VERSION        1
+
+#define SHPINDEX_HILBERT_MAX    0xFFFF
+
+// max depth of tree: nodeSize^32 items is far more than int
+#define SHPINDEX_LEVELS_MAX     32
+
+// search stack holds at most nodeSize entries per level
+#define SHPINDEX_NODESIZE_MAX   256
+
+
+typedef struct
+{
+    ub4 hilbert;
+    sb4 shapeId;
+} shpIndexItem;
+
+
+/**
+ * Hilbert curve index of (x, y) in [0, 65535] x [0, 65535]
+ *   https://github.com/rawrunprotected/hilbert_curves (public domain)
+ */
+static ub4 hilbertXYToIndex(ub4 x, ub4 y)
+{
+    ub4 a = x ^ y;
+    ub4 b = 0xFFFF ^ a;
+    ub4 c = 0xFFFF ^ (x | y);
+    ub4 d = x & (y ^ 0xFFFF);
+
+    ub4 A = a | (b >> 1);
+    ub4 B = (a >> 1) ^ a;
+    ub4 C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+    ub4 D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 2)) ^ (b & (b >> 2)));
+    B = ((a & (b >> 2)) ^ (b & ((a ^ b) >> 2)));
+    C ^= ((a & (c >> 2)) ^ (b & (d >> 2)));
+    D ^= ((b & (c >> 2)) ^ ((a ^ b) & (d >> 2)));
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 4)) ^ (b & (b >> 4)));
+    B = ((a & (b >> 4)) ^ (b & ((a ^ b) >> 4)));
+    C ^= ((a & (c >> 4)) ^ (b & (d >> 4)));
+    D ^= ((b & (c >> 4)) ^ ((a ^ b) & (d >> 4)));
+
+    a = A; b = B; c = C; d = D;
+    C ^= ((a & (c >> 8)) ^ (b & (d >> 8)));
+    D ^= ((b & (c >> 8)) ^ ((a ^ b) & (d >> 8)));
+
+    a = C ^ (C >> 1);
+    b = D ^ (D >> 1);
+
+    ub4 i0 = x ^ y;
+    ub4 i1 = b | (0xFFFF ^ (i0 | a));
+
+    i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+    i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+    i0 = (i0 | (i0 << 2)) & 0x33333333;
+    i0 = (i0 | (i0 << 1)) & 0x55555555;
+
+    i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+    i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+    i1 = (i1 | (i1 << 2)) & 0x33333333;
+    i1 = (i1 | (i1 << 1)) & 0x55555555;
+
+    return (i1 << 1) | i0;
+}
+
+
+static int shpIndexItemCompare(const void *a, const void *b)
+{
+    const shpIndexItem *ia = (const shpIndexItem *) a;
+    const shpIndexItem *ib = (const shpIndexItem *) b;
+
+    if (ia->hilbert != ib->hilbert) {
+        return (ia->hilbert < ib->hilbert ? -1 : 1);
+    }
+    return (ia->shapeId < ib->shapeId ? -1 : (ia->shapeId > ib->shapeId ? 1 : 0));
+}
+
+
+static int shapeIdCompare(const void *a, const void *b)
+{
+    int ia = *(const int *) a;
+    int ib = *(const int *) b;
+    return (ia < ib ? -1 : (ia > ib ? 1 : 0));
+}
+
+
+int shpIndexBuild(const char *stifile, const CGBox2D *envelopes, int nEntities, int nodeSize)
+{
+    int i, k, numItems, numNodes, numLevels, level, pos, count;
+    sb4 levelBounds[SHPINDEX_LEVELS_MAX];
+
+    shpIndexHeader header;
+    shpIndexItem *items;
+    double *boxes;
+    sb4 *indices;
+    FILE *fp;
+
+    if (nodeSize < 2 || nodeSize > SHPINDEX_NODESIZE_MAX) {
+        nodeSize = SHPINDEX_NODESIZE_DEFAULT;
+    }
+
+    bzero(&header, sizeof(header));
+    memcpy(header.magic, SHPINDEX_MAGIC, sizeof(header.magic));
+    header.version = SHPINDEX_VERSION;
+    header.nodeSize = nodeSize;
+    header.nEntities = nEntities;
+    header.bounds[0] = header.bounds[1] = DBL_MAX;
+    header.bounds[2] = header.bounds[3] = -DBL_MAX;
+
+    // skip null shapes
+    items = (shpIndexItem *) mem_alloc_unset(sizeof(shpIndexItem) * (nEntities > 0 ? nEntities : 1));
+    numItems = 0;
+    for (i = 0; i < nEntities; i++) {
+        const CGBox2D *env = &envelopes[i];
+        if (env->Xmin <= env->Xmax && env->Ymin <= env->Ymax) {
+            header.bounds[0] = CG_MIN(header.bounds[0], env->Xmin);
+            header.bounds[1] = CG_MIN(header.bounds[1], env->Ymin);
+            header.bounds[2] = CG_MAX(header.bounds[2], env->Xmax);
+            header.bounds[3] = CG_MAX(header.bounds[3], env->Ymax);
+            items[numItems++].shapeId = i;
+        }
+    }
+
+    // count nodes of all levels: leaves first, root last
+    numNodes = numItems;
+    numLevels = 0;
+    levelBounds[numLevels++] = numNodes;
+    if (numItems > 0) {
+        count = numItems;
+        do {
+            count = (count + nodeSize - 1) / nodeSize;
+            numNodes += count;
+            levelBounds[numLevels++] = numNodes;
+        } while (count != 1 && numLevels < SHPINDEX_LEVELS_MAX);
+    }
+
+    header.numItems = numItems;
+    header.numNodes = numNodes;
+    header.numLevels = numLevels;
+
+    boxes = (double *) mem_alloc_unset(sizeof(double) * 4 * (numNodes > 0 ? numNodes : 1));
+    indices = (sb4 *) mem_alloc_unset(sizeof(sb4) * (numNodes > 0 ? numNodes : 1));
+
+    if (numItems > 0) {
+        double W = header.bounds[2] - header.bounds[0];
+        double H = header.bounds[3] - header.bounds[1];
+
+        // sort leaves by hilbert value of centers
+        for (i = 0; i < numItems; i++) {
+            const CGBox2D *env = &envelopes[items[i].shapeId];
+            ub4 hx = (W > 0 ? (ub4) (SHPINDEX_HILBERT_MAX * ((env->Xmin + env->Xmax) / 2 - header.bounds[0]) / W) : 0);
+            ub4 hy = (H > 0 ? (ub4) (SHPINDEX_HILBERT_MAX * ((env->Ymin + env->Ymax) / 2 - header.bounds[1]) / H) : 0);
+            items[i].hilbert = hilbertXYToIndex(CG_MIN(hx, SHPINDEX_HILBERT_MAX), CG_MIN(hy, SHPINDEX_HILBERT_MAX));
+        }
+        qsort(items, numItems, sizeof(shpIndexItem), shpIndexItemCompare);
+
+        for (i = 0; i < numItems; i++) {
+            const CGBox2D *env = &envelopes[items[i].shapeId];
+            boxes[i * 4 + 0] = env->Xmin;
+            boxes[i * 4 + 1] = env->Ymin;
+            boxes[i * 4 + 2] = env->Xmax;
+            boxes[i * 4 + 3] = env->Ymax;
+            indices[i] = items[i].shapeId;
+        }
+
+        // generate nodes level by level
+        pos = 0;
+        for (level = 0; level < numLevels - 1; level++) {
+            int end = levelBounds[level];
+            int parent = end;
+
+            while (pos < end) {
+                double Xmin = DBL_MAX, Ymin = DBL_MAX, Xmax = -DBL_MAX, Ymax = -DBL_MAX;
+                int first = pos;
+
+                for (k = 0; k < nodeSize && pos < end; k++, pos++) {
+                    Xmin = CG_MIN(Xmin, boxes[pos * 4 + 0]);
+                    Ymin = CG_MIN(Ymin, boxes[pos * 4 + 1]);
+                    Xmax = CG_MAX(Xmax, boxes[pos * 4 + 2]);
+                    Ymax = CG_MAX(Ymax, boxes[pos * 4 + 3]);
+                }
+
+                boxes[parent * 4 + 0] = Xmin;
+                boxes[parent * 4 + 1] = Ymin;
+                boxes[parent * 4 + 2] = Xmax;
+                boxes[parent * 4 + 3] = Ymax;
+                indices[parent] = first;
+                parent++;
+            }
+        }
+    }
+
+    mem_free(items);
+
+    fp = fopen(stifile, "wb");
+    if (! fp) {
+        printf("Error: Cannot create index file: %s\n", stifile);
+        mem_free(boxes);
+        mem_free(indices);
+        return -1;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, fp) != 1 ||
+        fwrite(boxes, sizeof(double) * 4, numNodes, fp) != (size_t) numNodes ||
+        fwrite(indices, sizeof(sb4), numNodes, fp) != (size_t) numNodes ||
+        fwrite(levelBounds, sizeof(sb4), numLevels, fp) != (size_t) numLevels) {
+        printf("Error: Failed to write index file: %s\n", stifile);
+        fclose(fp);
+        mem_free(boxes);
+        mem_free(indices);
+        remove(stifile);
+        return -1;
+    }
+
+    fclose(fp);
+    mem_free(boxes);
+    mem_free(indices);
+
+    printf("Info: index built: %s (items=%d, nodes=%d, levels=%d)\n", stifile, numItems, numNodes, numLevels);
+    return 0;
+}
+
+
+/**
+ * test that levels are ascending, every child is in the next lower level
+ *   and every leaf is a shape id, so that searches never read out of the
+ *   mapping nor overflow their stacks.
+ */
+static int shpIndexCheckTree(const shpIndex *index)
+{
+    int level, pos, first, lower;
+
+    const shpIndexHeader *header = index->header;
+
+    if (index->levelBounds[0] != header->numItems || index->levelBounds[header->numLevels - 1] != header->numNodes) {
+        return 0;
+    }
+
+    for (level = 1; level < header->numLevels; level++) {
+        if (index->levelBounds[level] <= index->levelBounds[level - 1]) {
+            return 0;
+        }
+    }
+
+    for (pos = 0; pos < header->numItems; pos++) {
+        if (index->indices[pos] < 0 || index->indices[pos] >= header->nEntities) {
+            return 0;
+        }
+    }
+
+    for (level = 1; level < header->numLevels; level++) {
+        lower = (level > 1 ? index->levelBounds[level - 2] : 0);
+
+        for (pos = index->levelBounds[level - 1]; pos < index->levelBounds[level]; pos++) {
+            first = index->indices[pos];
+            if (first < lower || first >= index->levelBounds[level - 1]) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+
+int shpIndexOpen(shpIndex *index, const char *stifile)
+{
+    const shpIndexHeader *header;
+    size_t expectSize;
+
+    bzero(index, sizeof(shpIndex));
+
+    index->addr = shpFileMapBytes(stifile, &index->size);
+    if (! index->addr) {
+        return -1;
+    }
+
+    header = (const shpIndexHeader *) index->addr;
+
+    if (index->size < sizeof(shpIndexHeader) ||
+        memcmp(header->magic, SHPINDEX_MAGIC, sizeof(header->magic)) ||
+        header->version != SHPINDEX_VERSION ||
+        header->nodeSize < 2 || header->nodeSize > SHPINDEX_NODESIZE_MAX ||
+        header->numItems < 0 || header->numNodes < header->numItems || header->nEntities < header->numItems ||
+        header->numLevels < 1 || header->numLevels > SHPINDEX_LEVELS_MAX) {
+        printf("Error: Bad index file: %s\n", stifile);
+        shpIndexClose(index);
+        return -1;
+    }
+
+    expectSize = sizeof(shpIndexHeader) + (sizeof(double) * 4 + sizeof(sb4)) * (size_t) header->numNodes + sizeof(sb4) * (size_t) header->numLevels;
+    if (index->size != expectSize) {
+        printf("Error: Bad index file size: %s\n", stifile);
+        shpIndexClose(index);
+        return -1;
+    }
+
+    index->header = header;
+    index->boxes = (const double *) (index->addr + sizeof(shpIndexHeader));
+    index->indices = (const sb4 *) (index->boxes + 4 * (size_t) header->numNodes);
+    index->levelBounds = index->indices + header->numNodes;
+
+    if (! shpIndexCheckTree(index)) {
+        printf("Error: Bad index file nodes: %s\n", stifile);
+        shpIndexClose(index);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void shpIndexClose(shpIndex *index)
+{
+    shpFileUnmapBytes(index->addr, index->size);
+    bzero(index, sizeof(shpIndex));
+}
+
+
+int shpIndexSearch(const shpIndex *index, const CGBox2D *dataBox, int **shapeIds, int *capacity)
+{
+    // pending nodes: (nodeIndex, level)
+    sb4 stackNodes[SHPINDEX_LEVELS_MAX * SHPINDEX_NODESIZE_MAX];
+    sb4 stackLevels[SHPINDEX_LEVELS_MAX * SHPINDEX_NODESIZE_MAX];
+    int top = 0, count = 0;
+
+    const shpIndexHeader *header = index->header;
+    const int nodeSize = header->nodeSize;
+    const int numItems = header->numItems;
+
+    int nodeIndex, level, pos, end;
+
+    if (numItems == 0) {
+        return 0;
+    }
+
+    // start at root
+    nodeIndex = header->numNodes - 1;
+    level = header->numLevels - 1;
+
+    for (;;) {
+        end = CG_MIN(nodeIndex + nodeSize, index->levelBounds[level]);
+
+        for (pos = nodeIndex; pos < end; pos++) {
+            const double *box = &index->boxes[pos * 4];
+
+            if (dataBox->Xmax < box[0] || dataBox->Ymax < box[1] || dataBox->Xmin > box[2] || dataBox->Ymin > box[3]) {
+                continue;
+            }
+
+            if (nodeIndex < numItems) {
+                // leaf item
+                if (count == *capacity) {
+                    *capacity = (*capacity < 256 ? 256 : *capacity * 2);
+                    *shapeIds = (int *) mem_realloc(*shapeIds, sizeof(int) * (*capacity));
+                }
+                (*shapeIds)[count++] = index->indices[pos];
+            } else {
+                stackNodes[top] = index->indices[pos];
+                stackLevels[top] = level - 1;
+                top++;
+            }
+        }
+
+        if (! top) {
+            break;
+        }
+
+        top--;
+        nodeIndex = stackNodes[top];
+        level = stackLevels[top];
+    }
+
+    // keep record order as painter's order
+    qsort(*shapeIds, count, sizeof(int), shapeIdCompare);
+
+    return count;
+}
+
+
+int shpIndexProbe(const shpIndex *index, const CGBox2D *dataBox, int maxFound, int *shapeIds)
+{
+    sb4 stackNodes[SHPINDEX_LEVELS_MAX * SHPINDEX_NODESIZE_MAX];
+    sb4 stackLevels[SHPINDEX_LEVELS_MAX * SHPINDEX_NODESIZE_MAX];
+    int top = 0, count = 0;
+
+    const shpIndexHeader *header = index->header;
+    const int nodeSize = header->nodeSize;
+    const int numItems = header->numItems;
+
+    int nodeIndex, level, pos, end;
+
+    if (numItems == 0 || maxFound <= 0) {
+        return 0;
+    }
+
+    nodeIndex = header->numNodes - 1;
+    level = header->numLevels - 1;
+
+    for (;;) {
+        end = CG_MIN(nodeIndex + nodeSize, index->levelBounds[level]);
+
+        for (pos = nodeIndex; pos < end; pos++) {
+            const double *box = &index->boxes[pos * 4];
+
+            if (dataBox->Xmax < box[0] || dataBox->Ymax < box[1] || dataBox->Xmin > box[2] || dataBox->Ymin > box[3]) {
+                continue;
+            }
+
+            if (nodeIndex < numItems) {
+                shapeIds[count++] = index->indices[pos];
+                if (count == maxFound) {
+                    return count;
+                }
+            } else {
+                stackNodes[top] = index->indices[pos];
+                stackLevels[top] = level - 1;
+                top++;
+            }
+        }
+
+        if (! top) {
+            break;
+        }
+
+        top--;
+        nodeIndex = stackNodes[top];
+        level = stackLevels[top];
+    }
+
+    return count;
+}
@@ -0,0 +1,125 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shpindex.h
+ * @brief packed Hilbert R-tree sidecar index (.sti) of shape envelopes.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.2
+ *
+ * @since 2024-10-18 14:05:31
+ * @date 2024-10-24 13:02:00
+ *
+ * @note
+ *   Static packed R-tree like flatbush: leaf items are sorted by Hilbert
+ *   value of their centers and every node holds up to nodeSize children.
+ *
+ *   .sti file layout (little-endian):
+ *     shpIndexHeader         64 bytes
+ *     double boxes[numNodes * 4]
+ *     int indices[numNodes]  leaf: shape id; node: index of first child
+ *     int levelBounds[numLevels]
+ */
+#ifndef SHP_INDEX_H__
+#define SHP_INDEX_H__
+
+#ifdef    __cplusplus
+extern "C" {
+#endif
+
+#include <common/basetype.h>
+#include <common/cgtypes.h>
+
+
+#define SHPINDEX_FILE_EXT       ".sti"
+#define SHPINDEX_MAGIC          "SHPSTI\0\1"
+
+#define SHPINDEX_NODESIZE_DEFAULT   16
+
+
+typedef struct
+{
+    char magic[8];
+
+    sb4 version;
+    sb4 nodeSize;
+    sb4 numItems;
+    sb4 numNodes;
+    sb4 numLevels;
+
+    // number of records of shp when index built
+    sb4 nEntities;
+
+    // Xmin, Ymin, Xmax, Ymax of all items
+    double bounds[4];
+} shpIndexHeader;
+
+
+typedef struct
+{
+    // mapped .sti file
+    const ub1 *addr;
+    size_t size;
+
+    const shpIndexHeader *header;
+
+    const double *boxes;
+    const sb4 *indices;
+    const sb4 *levelBounds;
+} shpIndex;
+
+
+/**
+ * build index from envelopes of all shapes and write it to stifile.
+ *   null shapes must have an empty envelope (Xmin > Xmax).
+ * returns 0 on success.
+ */
+extern int shpIndexBuild(const char *stifile, const CGBox2D *envelopes, int nEntities, int nodeSize);
+
+/**
+ * open (mmap) a .sti file. returns 0 on success.
+ */
+extern int shpIndexOpen(shpIndex *index, const char *stifile);
+
+extern void shpIndexClose(shpIndex *index);
+
+/**
+ * search ids of shapes whose envelopes overlap the dataBox.
+ *   *shapeIds is (re)allocated by mem_realloc and must be freed by caller.
+ *   ids are returned in ascending order so that draw order is preserved.
+ * returns number of ids.
+ */
+extern int shpIndexSearch(const shpIndex *index, const CGBox2D *dataBox, int **shapeIds, int *capacity);
+
+/**
+ * as shpIndexSearch, but stops once maxFound ids are put in shapeIds,
+ *   which must hold maxFound items. ids are in no order.
+ * returns number of ids, at most maxFound.
+ */
+extern int shpIndexProbe(const shpIndex *index, const CGBox2D *dataBox, int maxFound, int *shapeIds);
+
+#ifdef    __cplusplus
+}
+#endif
+#endif /* SHP_INDEX_H__ */
@@ -0,0 +1,433 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shppyramid.c
+ * @brief multi-resolution simplified geometry (.shpp) of shp file.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.4
+ *
+ * @since 2024-10-21 14:36:52
+ * @date 2024-10-24 14:35:00
+ *
+ * @note
+ */
+#include "shppyramid.h"
+
+#include <common/memapi.h>
+#include <common/cgsimplify.h>
+
+
+#define SHPPYRAMID_VERSION      2
+
+// tolerance of level k: extent / 2^(SHPPYRAMID_TOLERANCE_SHIFT - 2k)
+#define SHPPYRAMID_TOLERANCE_SHIFT  19
+
+
+/**
+ * int32 column growing on demand
+ */
+typedef struct
+{
+    sb4 *data;
+    sb8 count;
+    sb8 capacity;
+} shppColumn;
+
+
+STATIC_INLINE void shppColumnReserve(shppColumn *col, sb8 more)
+{
+    if (col->count + more > col->capacity) {
+        col->capacity = CG_MAX(col->count + more, CG_MAX(1024, col->capacity * 2));
+        col->data = (sb4 *) mem_realloc(col->data, sizeof(sb4) * (size_t) col->capacity);
+    }
+}
+
+
+/**
+ * scratch buffers for simplifying one part
+ */
+typedef struct
+{
+    CGPoint2D *inPts;
+    CGPoint2D *outPts;
+    int *stack;
+    int capacity;
+} shppScratch;
+
+
+STATIC_INLINE void shppScratchReserve(shppScratch *scratch, int count)
+{
+    if (scratch->capacity < count) {
+        scratch->capacity = CG_MAX(count, CG_MAX(256, scratch->capacity * 2));
+        scratch->inPts = (CGPoint2D *) mem_realloc(scratch->inPts, sizeof(CGPoint2D) * scratch->capacity);
+        scratch->outPts = (CGPoint2D *) mem_realloc(scratch->outPts, sizeof(CGPoint2D) * scratch->capacity);
+        scratch->stack = (int *) mem_realloc(scratch->stack, sizeof(int) * 2 * scratch->capacity);
+    }
+}
+
+
+/**
+ * append one simplified record to level columns.
+ *   polygon rings which collapse under 4 points are dropped, but if all rings
+ *   of a record collapse the last one is kept so that it still draws a dot.
+ */
+static void shppAppendRecord(const shapeGeomView *view, int isPolygon, double tolerance, const shpPyramidHeader *header,
+    shppColumn *parts, shppColumn *xy, shppScratch *scratch)
+{
+    int k, j, start, end, numOut, numParts = 0, numPoints = 0;
+
+    for (k = 0; k < view->nParts; k++) {
+        start = view->panPartStart[k];
+        end = ShapeGeomPartEnd(view, k);
+        if (end <= start) {
+            continue;
+        }
+
+        shppScratchReserve(scratch, end - start);
+
+        // mapped points may be unaligned, simplify an aligned copy
+        for (j = start; j < end; j++) {
+            scratch->inPts[j - start].X = view->pPoints[j].x;
+            scratch->inPts[j - start].Y = view->pPoints[j].y;
+        }
+
+        numOut = CGSimplifyDouglasPeucker(scratch->inPts, end - start, tolerance, scratch->outPts, scratch->stack);
+
+        if (isPolygon && numOut < 4 && (k + 1 < view->nParts || numParts > 0)) {
+            continue;
+        }
+
+        shppColumnReserve(parts, 1);
+        shppColumnReserve(xy, (sb8) numOut * 2);
+
+        parts->data[parts->count++] = numPoints;
+
+        for (j = 0; j < numOut; j++) {
+            xy->data[xy->count++] = shpcQuantize(scratch->outPts[j].X, header->bounds[0], header->scale[0]);
+            xy->data[xy->count++] = shpcQuantize(scratch->outPts[j].Y, header->bounds[1], header->scale[1]);
+        }
+
+        numParts++;
+        numPoints += numOut;
+    }
+}
+
+
+int shpPyramidBuild(const char *shppfile, const shpFileMap *fileMap, int nShapeType, const double bounds[4], int numLevels)
+{
+    int i, k, level, ret = -1;
+    sb8 offset;
+
+    const int nEntities = fileMap->nEntities;
+    const size_t n = (size_t) nEntities;
+
+    // polygon: 5, 15, 25; line: 3, 13, 23
+    const int isPolygon = (nShapeType % 10 == 5);
+
+    shpPyramidHeader header;
+    shpPyramidLevelHeader *levelHeader;
+    shapeGeomView view;
+    CGBox2D env;
+    FILE *fp;
+
+    shppColumn parts, xy;
+    shppScratch scratch;
+    shpRecordBuf alignBuf;
+    sb4 *recParts, *recPoints;
+    double extent;
+
+    if (nShapeType % 10 != 5 && nShapeType % 10 != 3) {
+        printf("Error: pyramid needs line or polygon shapes, but type=%d: %s\n", nShapeType, shppfile);
+        return -1;
+    }
+    if (numLevels < SHPPYRAMID_LEVELS_MIN || numLevels > SHPPYRAMID_LEVELS_MAX) {
+        printf("Error: invalid pyramid levels=%d (%d-%d)\n", numLevels, SHPPYRAMID_LEVELS_MIN, SHPPYRAMID_LEVELS_MAX);
+        return -1;
+    }
+
+    bzero(&header, sizeof(header));
+    memcpy(header.magic, SHPPYRAMID_MAGIC, sizeof(header.magic));
+    header.version = SHPPYRAMID_VERSION;
+    header.nShapeType = nShapeType;
+    header.nEntities = nEntities;
+    header.numLevels = numLevels;
+
+    for (k = 0; k < 4; k++) {
+        header.bounds[k] = bounds[k];
+    }
+    header.scale[0] = (bounds[2] > bounds[0] ? (bounds[2] - bounds[0]) / SHPCOMPACT_QUANT_MAX : 1.0);
+    header.scale[1] = (bounds[3] > bounds[1] ? (bounds[3] - bounds[1]) / SHPCOMPACT_QUANT_MAX : 1.0);
+
+    extent = CG_MAX(bounds[2] - bounds[0], bounds[3] - bounds[1]);
+    if (extent <= 0) {
+        extent = 1.0;
+    }
+
+    fp = fopen(shppfile, "wb");
+    if (! fp) {
+        printf("Error: Cannot create pyramid file: %s\n", shppfile);
+        return -1;
+    }
+
+    bzero(&parts, sizeof(parts));
+    bzero(&xy, sizeof(xy));
+    bzero(&scratch, sizeof(scratch));
+    bzero(&alignBuf, sizeof(alignBuf));
+
+    recParts = (sb4 *) mem_alloc_unset(sizeof(sb4) * (n + 1));
+    recPoints = (sb4 *) mem_alloc_unset(sizeof(sb4) * (n + 1));
+
+    // header is written again when all levels are done
+    offset = sizeof(shpPyramidHeader);
+    if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+        goto onerror;
+    }
+
+    for (level = 1; level <= numLevels; level++) {
+        levelHeader = &header.levels[level - 1];
+        levelHeader->tolerance = ldexp(extent, 2 * level - SHPPYRAMID_TOLERANCE_SHIFT);
+
+        parts.count = 0;
+        xy.count = 0;
+
+        for (i = 0; i < nEntities; i++) {
+            recParts[i] = (sb4) parts.count;
+            recPoints[i] = (sb4) (xy.count / 2);
+
+            if (shpFileMapGetEnvelope(fileMap, i, &env) != SHPT_NULL && shpFileMapGetGeom(fileMap, i, &alignBuf, &view)) {
+                shppAppendRecord(&view, isPolygon, levelHeader->tolerance, &header, &parts, &xy, &scratch);
+            }
+
+            if (parts.count > INT_MAX || xy.count > INT_MAX) {
+                printf("Error: too many points for pyramid file: %s\n", shppfile);
+                goto onerror;
+            }
+        }
+
+        recParts[n] = (sb4) parts.count;
+        recPoints[n] = (sb4) (xy.count / 2);
+
+        levelHeader->numParts = (sb4) parts.count;
+        levelHeader->numPoints = (sb4) (xy.count / 2);
+
+        levelHeader->recPartsOffset = offset;
+        offset += SHPC_ALIGN8(sizeof(sb4) * (sb8) (n + 1));
+        levelHeader->recPointsOffset = offset;
+        offset += SHPC_ALIGN8(sizeof(sb4) * (sb8) (n + 1));
+        levelHeader->partsOffset = offset;
+        offset += SHPC_ALIGN8(sizeof(sb4) * parts.count);
+        levelHeader->xyOffset = offset;
+        offset += SHPC_ALIGN8(sizeof(sb4) * xy.count);
+
+        if (shpcWriteColumn(fp, recParts, sizeof(sb4) * (sb8) (n + 1)) ||
+            shpcWriteColumn(fp, recPoints, sizeof(sb4) * (sb8) (n + 1)) ||
+            shpcWriteColumn(fp, parts.data, sizeof(sb4) * parts.count) ||
+            shpcWriteColumn(fp, xy.data, sizeof(sb4) * xy.count)) {
+            goto onerror;
+        }
+
+        printf("Info: pyramid level %d: tolerance=%g, parts=%d, points=%d\n",
+            level, levelHeader->tolerance, levelHeader->numParts, levelHeader->numPoints);
+    }
+
+    header.fileSize = offset;
+
+    if (fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, fp) == 1) {
+        ret = 0;
+    }
+
+onerror:
+    if (ret != 0) {
+        printf("Error: Failed to write pyramid file: %s\n", shppfile);
+        fclose(fp);
+        remove(shppfile);
+    } else {
+        fclose(fp);
+        printf("Info: pyramid file built: %s (records=%d, levels=%d, bytes=%" PRId64 ")\n",
+            shppfile, nEntities, numLevels, (int64_t) header.fileSize);
+    }
+
+    mem_free(recParts);
+    mem_free(recPoints);
+    if (parts.data) {
+        mem_free(parts.data);
+    }
+    if (xy.data) {
+        mem_free(xy.data);
+    }
+    if (scratch.outPts) {
+        mem_free(scratch.inPts);
+        mem_free(scratch.outPts);
+        mem_free(scratch.stack);
+    }
+    shpRecordBufFree(&alignBuf);
+    return ret;
+}
+
+
+STATIC_INLINE int shpPyramidColumnValid(const shpPyramid *pyramid, sb8 offset, sb8 bytes)
+{
+    return (offset >= (sb8) sizeof(shpPyramidHeader) && (offset & 7) == 0 && offset + bytes <= (sb8) pyramid->size);
+}
+
+
+int shpPyramidOpen(shpPyramid *pyramid, const char *shppfile)
+{
+    int i, level;
+    sb8 n;
+    const shpPyramidHeader *header;
+    const shpPyramidLevelHeader *lh;
+    shpPyramidLevel *lv;
+
+    bzero(pyramid, sizeof(shpPyramid));
+
+    pyramid->addr = shpFileMapBytes(shppfile, &pyramid->size);
+    if (! pyramid->addr) {
+        return -1;
+    }
+
+    header = (const shpPyramidHeader *) pyramid->addr;
+
+    if (pyramid->size < sizeof(shpPyramidHeader) ||
+        memcmp(header->magic, SHPPYRAMID_MAGIC, sizeof(header->magic)) ||
+        header->version != SHPPYRAMID_VERSION ||
+        header->fileSize != (sb8) pyramid->size ||
+        header->nEntities < 0 ||
+        header->numLevels < 1 || header->numLevels > SHPPYRAMID_LEVELS_MAX) {
+        printf("Error: Bad pyramid file: %s\n", shppfile);
+        shpPyramidClose(pyramid);
+        return -1;
+    }
+
+    n = header->nEntities;
+
+    for (level = 0; level < header->numLevels; level++) {
+        lh = &header->levels[level];
+        lv = &pyramid->levels[level];
+
+        if (lh->numParts < 0 || lh->numPoints < 0 ||
+            (level > 0 && lh->tolerance < header->levels[level - 1].tolerance) ||
+            ! shpPyramidColumnValid(pyramid, lh->recPartsOffset, sizeof(sb4) * (n + 1)) ||
+            ! shpPyramidColumnValid(pyramid, lh->recPointsOffset, sizeof(sb4) * (n + 1)) ||
+            ! shpPyramidColumnValid(pyramid, lh->partsOffset, sizeof(sb4) * (sb8) lh->numParts) ||
+            ! shpPyramidColumnValid(pyramid, lh->xyOffset, sizeof(sb4) * 2 * (sb8) lh->numPoints)) {
+            printf("Error: Bad pyramid file level %d: %s\n", level + 1, shppfile);
+            shpPyramidClose(pyramid);
+            return -1;
+        }
+
+        lv->tolerance = lh->tolerance;
+        lv->recParts = (const sb4 *) (pyramid->addr + lh->recPartsOffset);
+        lv->recPoints = (const sb4 *) (pyramid->addr + lh->recPointsOffset);
+        lv->parts = (const sb4 *) (pyramid->addr + lh->partsOffset);
+        lv->xy = (const sb4 *) (pyramid->addr + lh->xyOffset);
+
+        // record offsets must be ascending so that no record reads out of columns
+        if (lv->recParts[0] != 0 || lv->recPoints[0] != 0 ||
+            lv->recParts[n] != lh->numParts || lv->recPoints[n] != lh->numPoints) {
+            printf("Error: Bad pyramid file records: %s\n", shppfile);
+            shpPyramidClose(pyramid);
+            return -1;
+        }
+        for (i = 0; i < n; i++) {
+            if (lv->recParts[i] > lv->recParts[i + 1] || lv->recPoints[i] > lv->recPoints[i + 1]) {
+                printf("Error: Bad pyramid file records: %s\n", shppfile);
+                shpPyramidClose(pyramid);
+                return -1;
+            }
+        }
+
+        // part starts index points of views, they are checked once here
+        for (i = 0; i < n; i++) {
+            if (! shpFileCheckPartStarts(lv->parts + lv->recParts[i], lv->recParts[i + 1] - lv->recParts[i],
+                    lv->recPoints[i + 1] - lv->recPoints[i], i)) {
+                printf("Error: Bad pyramid file parts: %s\n", shppfile);
+                shpPyramidClose(pyramid);
+                return -1;
+            }
+        }
+    }
+
+    pyramid->header = header;
+    pyramid->numLevels = header->numLevels;
+    return 0;
+}
+
+
+/**
+ * dequantize nPoints absolute X, Y of a level into pointsBuf
+ */
+static SHPPointType * shppDecodePoints(const sb4 *xy, int nPoints, const double origin[2], const double scale[2], shpcPointsBuf *pointsBuf)
+{
+    int k;
+    SHPPointType *pts;
+
+    if (pointsBuf->capacity < nPoints) {
+        pointsBuf->capacity = CG_MAX(nPoints, CG_MAX(256, pointsBuf->capacity * 2));
+        pointsBuf->pPoints = (SHPPointType *) mem_realloc(pointsBuf->pPoints, sizeof(SHPPointType) * pointsBuf->capacity);
+    }
+
+    pts = pointsBuf->pPoints;
+
+    for (k = 0; k < nPoints; k++) {
+        pts[k].x = origin[0] + xy[k * 2] * scale[0];
+        pts[k].y = origin[1] + xy[k * 2 + 1] * scale[1];
+    }
+    return pts;
+}
+
+
+void shpPyramidClose(shpPyramid *pyramid)
+{
+    shpFileUnmapBytes(pyramid->addr, pyramid->size);
+    bzero(pyramid, sizeof(shpPyramid));
+}
+
+
+int shpPyramidGetGeom(const shpPyramid *pyramid, int level, int nShapeId, shpcPointsBuf *pointsBuf, shapeGeomView *view)
+{
+    int nParts, nPoints;
+    const shpPyramidLevel *lv;
+
+    if (level < 1 || level > pyramid->numLevels || nShapeId < 0 || nShapeId >= pyramid->header->nEntities) {
+        return 0;
+    }
+
+    lv = &pyramid->levels[level - 1];
+
+    nParts = lv->recParts[nShapeId + 1] - lv->recParts[nShapeId];
+    nPoints = lv->recPoints[nShapeId + 1] - lv->recPoints[nShapeId];
+    if (nParts < 1) {
+        return 0;
+    }
+
+    view->nShapeId = nShapeId;
+    view->nParts = nParts;
+    view->nPoints = nPoints;
+    view->panPartStart = lv->parts + lv->recParts[nShapeId];
+    view->pPoints = shppDecodePoints(lv->xy + (size_t) lv->recPoints[nShapeId] * 2, nPoints, pyramid->header->bounds, pyramid->header->scale, pointsBuf);
+
+    return 1;
+}
@@ -0,0 +1,170 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shppyramid.h
+ * @brief multi-resolution simplified geometry (.shpp) of shp file.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.3
+ *
+ * @since 2024-10-21 14:36:52
+ * @date 2024-10-24 14:35:00
+ *
+ * @note
+ *   Level k (1..numLevels) keeps every part of a record simplified by
+ *   Douglas-Peucker at tolerance[k-1], tolerances growing 4x per level.
+ *   Vertices are quantized as in .shpc and stored as absolute int32, which
+ *   read at a fixed stride. Envelopes are not stored: culling always uses
+ *   full resolution envelopes.
+ *
+ *   A level is good for drawing if its tolerance is not more than half a
+ *   pixel in data units (0.5 / XScale), so the coarsest such level is used.
+ *
+ *   .shpp file layout (little-endian, every column 8-byte aligned):
+ *     shpPyramidHeader
+ *     level 1: recParts[nEntities + 1], recPoints[nEntities + 1], parts[numParts], xy[numPoints * 2]
+ *     ...
+ *     level numLevels
+ */
+#ifndef SHP_PYRAMID_H__
+#define SHP_PYRAMID_H__
+
+#ifdef    __cplusplus
+extern "C" {
+#endif
+
+#include "shpcompact.h"
+
+
+#define SHPPYRAMID_FILE_EXT     ".shpp"
+#define SHPPYRAMID_MAGIC        "SHPPYR\0\1"
+
+#define SHPPYRAMID_LEVELS_MIN   4
+#define SHPPYRAMID_LEVELS_MAX   8
+#define SHPPYRAMID_LEVELS_DEFAULT  6
+
+
+typedef struct
+{
+    // max distance of dropped vertex to simplified part in data units
+    double tolerance;
+
+    sb4 numParts;
+    sb4 numPoints;
+
+    // byte offsets of columns from start of file
+    sb8 recPartsOffset;
+    sb8 recPointsOffset;
+    sb8 partsOffset;
+    sb8 xyOffset;
+} shpPyramidLevelHeader;
+
+
+typedef struct
+{
+    char magic[8];
+
+    sb4 version;
+    sb4 nShapeType;
+    sb4 nEntities;
+    sb4 numLevels;
+
+    // Xmin, Ymin, Xmax, Ymax of quantization grid (layer bounds)
+    double bounds[4];
+
+    // X = bounds[0] + qx * scale[0], Y = bounds[1] + qy * scale[1]
+    double scale[2];
+
+    shpPyramidLevelHeader levels[SHPPYRAMID_LEVELS_MAX];
+
+    sb8 fileSize;
+} shpPyramidHeader;
+
+
+typedef struct
+{
+    double tolerance;
+
+    const sb4 *recParts;
+    const sb4 *recPoints;
+    const sb4 *parts;
+    const sb4 *xy;
+} shpPyramidLevel;
+
+
+typedef struct
+{
+    // mapped .shpp file
+    const ub1 *addr;
+    size_t size;
+
+    const shpPyramidHeader *header;
+
+    int numLevels;
+    shpPyramidLevel levels[SHPPYRAMID_LEVELS_MAX];
+} shpPyramid;
+
+
+/**
+ * build simplified levels of mapped shp file into .shpp.
+ *   bounds: Xmin, Ymin, Xmax, Ymax of layer.
+ *   numLevels: SHPPYRAMID_LEVELS_MIN ~ SHPPYRAMID_LEVELS_MAX
+ * returns 0 on success.
+ */
+extern int shpPyramidBuild(const char *shppfile, const shpFileMap *fileMap, int nShapeType, const double bounds[4], int numLevels);
+
+/**
+ * open (mmap) a .shpp file. returns 0 on success.
+ */
+extern int shpPyramidOpen(shpPyramid *pyramid, const char *shppfile);
+
+extern void shpPyramidClose(shpPyramid *pyramid);
+
+/**
+ * decode shape of level (1..numLevels) into pointsBuf and make a view of it.
+ * returns 1 on success, 0 on null shape.
+ */
+extern int shpPyramidGetGeom(const shpPyramid *pyramid, int level, int nShapeId, shpcPointsBuf *pointsBuf, shapeGeomView *view);
+
+
+/**
+ * coarsest level whose tolerance is under half a pixel,
+ *   0 if none (full resolution should be drawn).
+ *   XScale: pixels per data unit
+ */
+STATIC_INLINE int shpPyramidSelectLevel(const shpPyramid *pyramid, double XScale)
+{
+    int level = pyramid->numLevels;
+    double halfPixel = 0.5 / XScale;
+
+    while (level > 0 && pyramid->levels[level - 1].tolerance > halfPixel) {
+        level--;
+    }
+    return level;
+}
+
+#ifdef    __cplusplus
+}
+#endif
+#endif /* SHP_PYRAMID_H__ */
@@ -0,0 +1,247 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shpreadahead.c
+ * @brief read-ahead decode pipeline between shp file reading and drawing.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.2
+ *
+ * @since 2024-10-19 15:22:08
+ * @date 2024-10-20 15:18:06
+ *
+ * @note
+ */
+#include "shpreadahead.h"
+
+#include <common/memapi.h>
+
+
+static void * shpReadAheadDecoder(void *arg)
+{
+    int k, first, end, chunk;
+    shpReadAheadWorker *worker = (shpReadAheadWorker *) arg;
+    shpReadAhead *ra = worker->ra;
+
+    for (;;) {
+        unsema_wait(&ra->semEmpty);
+
+        if (uatomic_int_get(&ra->stopFlag)) {
+            // pass wake-up to other decoders
+            unsema_post(&ra->semEmpty);
+            break;
+        }
+
+        chunk = uatomic_int_add(&ra->nextChunk) - 1;
+
+        first = chunk * ra->chunkSize;
+        if (first >= ra->numShapes) {
+            // all claimed
+            unsema_post(&ra->semEmpty);
+            break;
+        }
+        end = CG_MIN(first + ra->chunkSize, ra->numShapes);
+
+        shpReadAheadSlot *slots = &ra->slots[(chunk % ra->numChunks) * ra->chunkSize];
+
+        for (k = first; k < end; k++) {
+            shpReadAheadSlot *slot = &slots[k - first];
+
+            slot->nShapeId = ra->shapeIds[k];
+            slot->decoded = (SHPReadObjectEx(worker->hSHP, slot->nShapeId, slot->shpObj) ? 1 : 0);
+
+            if (slot->decoded) {
+                uatomic_int_add(&ra->decodedCount);
+            } else {
+                uatomic_int_add(&ra->failedCount);
+            }
+        }
+
+        unsema_post(&ra->semReady[chunk % ra->numChunks]);
+    }
+
+    return 0;
+}
+
+
+int shpReadAheadStart(shpReadAhead *ra, const char *shapefile, SHPHandle hSHP, const int *shapeIds, int numShapes, int numSlots, int numWorkers)
+{
+    int i;
+
+    bzero(ra, sizeof(shpReadAhead));
+
+    numSlots = CG_MAX(1, CG_MIN(numSlots, SHPREADAHEAD_SLOTS_MAX));
+    numWorkers = CG_MAX(1, CG_MIN(numWorkers, SHPREADAHEAD_WORKERS_MAX));
+
+    // two chunks per decoder in flight
+    ra->chunkSize = CG_MAX(1, CG_MIN(numSlots / (numWorkers * 2), SHPREADAHEAD_CHUNK_MAX));
+    ra->numChunks = CG_MAX(1, numSlots / ra->chunkSize);
+
+    ra->shapeIds = shapeIds;
+    ra->numShapes = numShapes;
+    ra->slots = (shpReadAheadSlot *) mem_alloc_zero(ra->numChunks * ra->chunkSize, sizeof(shpReadAheadSlot));
+
+    for (i = 0; i < ra->numChunks * ra->chunkSize; i++) {
+        if (! SHPCreateObjectEx(&ra->slots[i].shpObj)) {
+            // out of memory
+            abort();
+        }
+    }
+
+    uatomic_int_zero(&ra->nextChunk);
+    uatomic_int_zero(&ra->stopFlag);
+    uatomic_int_zero(&ra->decodedCount);
+    uatomic_int_zero(&ra->failedCount);
+
+    ra->semReady = (unsema_t *) mem_alloc_zero(ra->numChunks, sizeof(unsema_t));
+
+    for (i = 0; i < ra->numChunks; i++) {
+        if (unsema_init(&ra->semReady[i], 0) != 0) {
+            printf("Error: unsema_init() failed\n");
+            while (i-- > 0) {
+                unsema_uninit(&ra->semReady[i]);
+            }
+            shpReadAheadFinish(ra);
+            return -1;
+        }
+    }
+    if (unsema_init(&ra->semEmpty, ra->numChunks) != 0) {
+        printf("Error: unsema_init() failed\n");
+        for (i = 0; i < ra->numChunks; i++) {
+            unsema_uninit(&ra->semReady[i]);
+        }
+        shpReadAheadFinish(ra);
+        return -1;
+    }
+
+    // semaphores are released by shpReadAheadFinish() from now on
+    ra->started = 1;
+
+    ra->workers = (shpReadAheadWorker *) mem_alloc_zero(numWorkers, sizeof(shpReadAheadWorker));
+    ra->numWorkers = numWorkers;
+
+    for (i = 0; i < numWorkers; i++) {
+        shpReadAheadWorker *worker = &ra->workers[i];
+
+        worker->ra = ra;
+
+        if (i == 0) {
+            worker->hSHP = hSHP;
+        } else {
+            worker->hSHP = SHPOpen(shapefile, "rb");
+            if (! worker->hSHP) {
+                printf("Error: Cannot open shp file: %s\n", shapefile);
+                shpReadAheadFinish(ra);
+                return -1;
+            }
+            worker->ownHandle = 1;
+        }
+
+        if (pthread_create(&worker->thread, 0, shpReadAheadDecoder, worker) != 0) {
+            printf("Error: pthread_create() failed\n");
+            shpReadAheadFinish(ra);
+            return -1;
+        }
+        worker->started = 1;
+    }
+
+    return 0;
+}
+
+
+const shpReadAheadSlot * shpReadAheadNext(shpReadAhead *ra)
+{
+    int chunk, offset;
+
+    if (ra->nextIndex >= ra->numShapes) {
+        return 0;
+    }
+
+    chunk = ra->nextIndex / ra->chunkSize;
+    offset = ra->nextIndex % ra->chunkSize;
+
+    if (offset == 0) {
+        // wait until whole chunk decoded
+        unsema_wait(&ra->semReady[chunk % ra->numChunks]);
+    }
+
+    ra->nextIndex++;
+    return &ra->slots[(chunk % ra->numChunks) * ra->chunkSize + offset];
+}
+
+
+void shpReadAheadRelease(shpReadAhead *ra, const shpReadAheadSlot *slot)
+{
+    if (ra->nextIndex % ra->chunkSize == 0 || ra->nextIndex == ra->numShapes) {
+        // last slot of chunk consumed
+        unsema_post(&ra->semEmpty);
+    }
+}
+
+
+void shpReadAheadFinish(shpReadAhead *ra)
+{
+    int i;
+
+    if (ra->started) {
+        // wake up decoders waiting for a free chunk
+        uatomic_int_set(&ra->stopFlag, 1);
+        unsema_post(&ra->semEmpty);
+
+        for (i = 0; i < ra->numWorkers; i++) {
+            if (ra->workers[i].started) {
+                pthread_join(ra->workers[i].thread, 0);
+            }
+        }
+
+        unsema_uninit(&ra->semEmpty);
+        for (i = 0; i < ra->numChunks; i++) {
+            unsema_uninit(&ra->semReady[i]);
+        }
+    }
+
+    if (ra->workers) {
+        for (i = 0; i < ra->numWorkers; i++) {
+            if (ra->workers[i].ownHandle) {
+                SHPClose(ra->workers[i].hSHP);
+            }
+        }
+        mem_free(ra->workers);
+    }
+
+    if (ra->semReady) {
+        mem_free(ra->semReady);
+    }
+
+    if (ra->slots) {
+        for (i = 0; i < ra->numChunks * ra->chunkSize; i++) {
+            if (ra->slots[i].shpObj) {
+                SHPDestroyObjectEx(ra->slots[i].shpObj);
+            }
+        }
+        mem_free(ra->slots);
+    }
+
+    bzero(ra, sizeof(shpReadAhead));
+}
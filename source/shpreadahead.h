@@ -0,0 +1,152 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shpreadahead.h
+ * @brief read-ahead decode pipeline between shp file reading and drawing.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.2
+ *
+ * @since 2024-10-19 15:22:08
+ * @date 2024-10-20 15:18:06
+ *
+ * @note
+ *   Decoder threads decode the shapes to draw into a bounded ring of chunks
+ *   of SHPObjectEx slots while the cairo thread consumes them in order:
+ *
+ *     decoder: wait(semEmpty) -> claim next chunk -> SHPReadObjectEx
+ *              -> post(semReady[chunk])
+ *     consumer: wait(semReady[chunk]) -> draw chunk -> post(semEmpty)
+ *
+ *   Chunks are claimed in order only after a free ring slot is taken, so at
+ *   most numChunks chunks are in flight and each owns a distinct slot. Each
+ *   decoder reads through its own SHPHandle; the first one uses the handle
+ *   given to shpReadAheadStart() until shpReadAheadFinish().
+ */
+#ifndef SHP_READ_AHEAD_H__
+#define SHP_READ_AHEAD_H__
+
+#ifdef    __cplusplus
+extern "C" {
+#endif
+
+#include <shapefile/shapefile_api.h>
+
+#include <common/cgtypes.h>
+#include <common/unsema.h>
+#include <common/uatomic.h>
+
+#include <pthread.h>
+
+
+#define SHPREADAHEAD_SLOTS_MAX    1024
+
+#define SHPREADAHEAD_WORKERS_MAX  64
+
+// max shapes decoded by one claim of a decoder
+#define SHPREADAHEAD_CHUNK_MAX    32
+
+
+typedef struct
+{
+    SHPObjectEx *shpObj;
+
+    int nShapeId;
+
+    // 1 if shpObj decoded successfully
+    int decoded;
+} shpReadAheadSlot;
+
+
+typedef struct
+{
+    struct shpReadAhead_t *ra;
+
+    SHPHandle hSHP;
+
+    // 1 if hSHP opened by this decoder
+    int ownHandle;
+
+    int started;
+    pthread_t thread;
+} shpReadAheadWorker;
+
+
+typedef struct shpReadAhead_t
+{
+    // ids of shapes to decode in order
+    const int *shapeIds;
+    int numShapes;
+
+    // ring of numChunks * chunkSize slots
+    int chunkSize;
+    int numChunks;
+    shpReadAheadSlot *slots;
+
+    // free chunks of ring and decoded state of each chunk
+    unsema_t semEmpty;
+    unsema_t *semReady;
+
+    // next chunk to claim by decoders
+    uatomic_int nextChunk;
+
+    // consumer position
+    int nextIndex;
+
+    uatomic_int stopFlag;
+    uatomic_int decodedCount;
+    uatomic_int failedCount;
+
+    // 1 if semaphores initialized
+    int started;
+
+    int numWorkers;
+    shpReadAheadWorker *workers;
+} shpReadAhead;
+
+
+/**
+ * start decoder threads. returns 0 on success.
+ *   numSlots: shapes in flight. numWorkers: decoder threads, workers other
+ *   than the first open their own handle of shapefile.
+ */
+extern int shpReadAheadStart(shpReadAhead *ra, const char *shapefile, SHPHandle hSHP, const int *shapeIds, int numShapes, int numSlots, int numWorkers);
+
+/**
+ * wait for next decoded slot in order. returns 0 if all shapes consumed.
+ *   the slot must be given back by shpReadAheadRelease() before next call.
+ */
+extern const shpReadAheadSlot * shpReadAheadNext(shpReadAhead *ra);
+
+extern void shpReadAheadRelease(shpReadAhead *ra, const shpReadAheadSlot *slot);
+
+/**
+ * stop and join decoder threads and free all slots
+ */
+extern void shpReadAheadFinish(shpReadAhead *ra);
+
+#ifdef    __cplusplus
+}
+#endif
+#endif /* SHP_READ_AHEAD_H__ */
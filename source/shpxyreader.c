@@ -0,0 +1,232 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shpxyreader.c
+ * @brief read X/Y of shp records without Z/M.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.3
+ *
+ * @since 2024-10-21 17:05:40
+ * @date 2024-10-24 10:12:40
+ *
+ * @note
+ */
+#include "shpxyreader.h"
+
+#include <common/memapi.h>
+
+#if defined(WIN32API)
+#   include <io.h>
+#   include <fcntl.h>
+#   include <sys/stat.h>
+
+#   define shpxy_open_rdonly(path)   _open((path), _O_RDONLY | _O_BINARY)
+#   define shpxy_close(fd)           _close(fd)
+
+STATIC_INLINE sb8 shpxy_filesize(int fd)
+{
+    struct __stat64 st;
+    if (_fstat64(fd, &st) == 0) {
+        return (sb8) st.st_size;
+    }
+    return (-1);
+}
+
+/**
+ * positioned read that does not move file pointer shared by threads
+ */
+STATIC_INLINE int shpxy_pread(int fd, void *buf, int bytes, sb8 offset)
+{
+    DWORD cbread = 0;
+    OVERLAPPED ov;
+    bzero(&ov, sizeof(ov));
+    ov.Offset = (DWORD) (offset & 0xFFFFFFFF);
+    ov.OffsetHigh = (DWORD) (offset >> 32);
+    if (! ReadFile((HANDLE) _get_osfhandle(fd), buf, (DWORD) bytes, &cbread, &ov)) {
+        return (-1);
+    }
+    return (int) cbread;
+}
+#else
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/stat.h>
+
+#   define shpxy_open_rdonly(path)   open((path), O_RDONLY)
+#   define shpxy_close(fd)           close(fd)
+
+STATIC_INLINE sb8 shpxy_filesize(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        return (sb8) st.st_size;
+    }
+    return (-1);
+}
+
+STATIC_INLINE int shpxy_pread(int fd, void *buf, int bytes, sb8 offset)
+{
+    return (int) pread(fd, buf, (size_t) bytes, (off_t) offset);
+}
+#endif
+
+
+// head of record content: type, box, numParts, numPoints
+#define SHPXY_RECORD_HEAD    44
+
+// start index of the only part of point and multipoint records
+static const int shpXYPointPartStart[1] = { 0 };
+
+
+int shpXYReaderOpen(shpXYReader *reader, const char *shpfile)
+{
+    char shxfile[260];
+
+    bzero(reader, sizeof(shpXYReader));
+    reader->fd = -1;
+
+    if (shpFileSidecarPath(shpfile, ".shx", shxfile, sizeof(shxfile)) < 0) {
+        printf("Error: Bad shp file: %s\n", shpfile);
+        return -1;
+    }
+
+    reader->fd = shpxy_open_rdonly(shpfile);
+    if (reader->fd == -1) {
+        printf("Error: Cannot open file: %s\n", shpfile);
+        return -1;
+    }
+
+    reader->shpSize = shpxy_filesize(reader->fd);
+
+    reader->shxAddr = shpFileMapBytes(shxfile, &reader->shxSize);
+    if (! reader->shxAddr || reader->shxSize < SHPFILE_HEADER_SIZE || reader->shpSize < SHPFILE_HEADER_SIZE) {
+        printf("Error: Bad shp or shx file: %s\n", shpfile);
+        shpXYReaderClose(reader);
+        return -1;
+    }
+
+    reader->nEntities = (int)((reader->shxSize - SHPFILE_HEADER_SIZE) / 8);
+
+    return 0;
+}
+
+
+void shpXYReaderClose(shpXYReader *reader)
+{
+    shpFileUnmapBytes(reader->shxAddr, reader->shxSize);
+    if (reader->fd != -1) {
+        shpxy_close(reader->fd);
+    }
+    bzero(reader, sizeof(shpXYReader));
+    reader->fd = -1;
+}
+
+
+/**
+ * get offset and content length of record. returns 0 if bad record.
+ */
+STATIC_INLINE int shpXYReaderRecord(const shpXYReader *reader, int nShapeId, sb8 *offset, int *length)
+{
+    const ub1 *shxrec;
+
+    if (nShapeId < 0 || nShapeId >= reader->nEntities) {
+        return 0;
+    }
+
+    shxrec = reader->shxAddr + SHPFILE_HEADER_SIZE + (size_t) nShapeId * 8;
+
+    // offset and content length are in 16-bit words
+    *offset = (sb8)(ub4) shpBytesBigInt32(shxrec) * 2 + SHPFILE_RECHDR_SIZE;
+    *length = (int)(ub4) shpBytesBigInt32(shxrec + 4) * 2;
+
+    return (*length >= 4 && *offset + *length <= reader->shpSize);
+}
+
+
+int shpXYReaderGetEnvelope(const shpXYReader *reader, int nShapeId, CGBox2D *envelope)
+{
+    ub1 head[SHPXY_RECORD_HEAD];
+    sb8 offset;
+    int length, headBytes;
+
+    if (! shpXYReaderRecord(reader, nShapeId, &offset, &length)) {
+        return SHPT_NULL;
+    }
+
+    // type and box
+    headBytes = CG_MIN(length, 36);
+    if (shpxy_pread(reader->fd, head, headBytes, offset) != headBytes) {
+        return SHPT_NULL;
+    }
+
+    return shpFileRecordEnvelope(head, length, envelope);
+}
+
+
+int shpXYReaderGetGeom(const shpXYReader *reader, int nShapeId, shpXYReadBuf *readBuf, shapeGeomView *view)
+{
+    ub1 head[SHPXY_RECORD_HEAD];
+    sb8 offset;
+    int length, headBytes, nParts, nPoints, partsOffset, pointsOffset, partBytes, pad, bytes;
+
+    if (! shpXYReaderRecord(reader, nShapeId, &offset, &length)) {
+        return 0;
+    }
+
+    headBytes = CG_MIN(length, SHPXY_RECORD_HEAD);
+    if (shpxy_pread(reader->fd, head, headBytes, offset) != headBytes) {
+        return 0;
+    }
+
+    if (! shpFileRecordLayout(head, length, nShapeId, &nParts, &nPoints, &partsOffset, &pointsOffset)) {
+        return 0;
+    }
+
+    partBytes = pointsOffset - partsOffset;
+
+    // keep X/Y 8-byte aligned after an odd number of part starts
+    pad = (partBytes & 7);
+    bytes = partBytes + nPoints * 16;
+
+    shpRecordBufReserve(readBuf, pad + bytes);
+
+    if (shpxy_pread(reader->fd, readBuf->bytes + pad, bytes, offset + partsOffset) != bytes) {
+        return 0;
+    }
+
+    view->nShapeId = nShapeId;
+    view->nParts = nParts;
+    view->nPoints = nPoints;
+    view->panPartStart = (partBytes > 0 ? (const int *) (readBuf->bytes + pad) : shpXYPointPartStart);
+    view->pPoints = (const SHPPointType *) (readBuf->bytes + pad + partBytes);
+
+    return shpFileCheckPartStarts(view->panPartStart, nParts, nPoints, nShapeId);
+}
+
+
+void shpXYReadBufFree(shpXYReadBuf *readBuf)
+{
+    shpRecordBufFree(readBuf);
+}
@@ -0,0 +1,95 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file shpxyreader.h
+ * @brief read X/Y of shp records without Z/M.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.3
+ *
+ * @since 2024-10-21 17:05:40
+ * @date 2024-10-24 10:12:40
+ *
+ * @note
+ *   Z and M arrays of PolygonZ/PolygonM records are stored after X/Y, so
+ *   a record is read by two positioned reads: the fixed head (type, box,
+ *   counts) and then part starts with X/Y. Z/M bytes are never read.
+ *   Reads are positioned, so one reader can be shared by threads, each
+ *   with its own shpXYReadBuf.
+ */
+#ifndef SHP_XY_READER_H__
+#define SHP_XY_READER_H__
+
+#ifdef    __cplusplus
+extern "C" {
+#endif
+
+#include "shpfilemap.h"
+
+
+typedef struct
+{
+    // .shp file opened for read
+    int fd;
+    sb8 shpSize;
+
+    // mapped .shx file
+    const ub1 *shxAddr;
+    size_t shxSize;
+
+    int nEntities;
+} shpXYReader;
+
+
+/**
+ * bytes of a record read by shpXYReaderGetGeom, grows on demand
+ */
+typedef shpRecordBuf shpXYReadBuf;
+
+
+/**
+ * open .shp for positioned reads and map its .shx. returns 0 on success.
+ */
+extern int shpXYReaderOpen(shpXYReader *reader, const char *shpfile);
+
+extern void shpXYReaderClose(shpXYReader *reader);
+
+/**
+ * read bounding box of shape. returns shp type, SHPT_NULL for null or bad record.
+ */
+extern int shpXYReaderGetEnvelope(const shpXYReader *reader, int nShapeId, CGBox2D *envelope);
+
+/**
+ * read part starts and X/Y of shape into readBuf and make a view of it.
+ *   view is valid until next read with the same readBuf.
+ * returns 1 on success, 0 on null or bad record.
+ */
+extern int shpXYReaderGetGeom(const shpXYReader *reader, int nShapeId, shpXYReadBuf *readBuf, shapeGeomView *view);
+
+extern void shpXYReadBufFree(shpXYReadBuf *readBuf);
+
+#ifdef    __cplusplus
+}
+#endif
+#endif /* SHP_XY_READER_H__ */
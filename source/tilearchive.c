@@ -0,0 +1,321 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file tilearchive.c
+ * @brief single-file archive of XYZ tiles with a sorted directory.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.2
+ *
+ * @since 2024-10-23 17:12:26
+ * @date 2024-10-23 19:40:52
+ *
+ * @note
+ */
+#include "tilearchive.h"
+#include "shpfilemap.h"
+
+#include <common/memapi.h>
+
+
+#define TILEARCHIVE_VERSION     1
+
+// directory is aligned to entries in mapped file
+#define TILEARCHIVE_DIR_ALIGN   8
+
+#define TILEARCHIVE_ZOOM_MAX    30
+
+
+/**
+ * Hilbert curve index of (x, y) in [0, 2^z) x [0, 2^z)
+ */
+static ub8 hilbertTileIndex(int z, ub4 x, ub4 y)
+{
+    ub4 s, rx, ry, t;
+    ub8 d = 0;
+    const ub4 n = (ub4) 1 << z;
+
+    for (s = n / 2; s > 0; s /= 2) {
+        rx = (x & s) > 0;
+        ry = (y & s) > 0;
+
+        d += (ub8) s * s * ((3 * rx) ^ ry);
+
+        // rotate quadrant
+        if (ry == 0) {
+            if (rx == 1) {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            t = x;
+            x = y;
+            y = t;
+        }
+    }
+
+    return d;
+}
+
+
+static int tileArchiveEntryCompare(const void *a, const void *b)
+{
+    const tileArchiveEntry *ea = (const tileArchiveEntry *) a;
+    const tileArchiveEntry *eb = (const tileArchiveEntry *) b;
+
+    return (ea->tileId < eb->tileId ? -1 : (ea->tileId > eb->tileId ? 1 : 0));
+}
+
+
+ub8 tileArchiveTileId(int z, int x, int y)
+{
+    // tiles of zooms 0..z-1: (4^z - 1) / 3
+    ub8 base = (((ub8) 1 << (2 * z)) - 1) / 3;
+
+    return base + hilbertTileIndex(z, (ub4) x, (ub4) y);
+}
+
+
+int tileArchiveCreate(tileArchiveWriter *writer, const char *pathfile, const CGBox2D *gridBox, int tileSize, int minZoom, int maxZoom)
+{
+    bzero(writer, sizeof(tileArchiveWriter));
+
+    memcpy(writer->header.magic, TILEARCHIVE_MAGIC, sizeof(writer->header.magic));
+    writer->header.version = TILEARCHIVE_VERSION;
+    writer->header.tileSize = tileSize;
+    writer->header.minZoom = minZoom;
+    writer->header.maxZoom = maxZoom;
+    writer->header.gridBox[0] = gridBox->Xmin;
+    writer->header.gridBox[1] = gridBox->Ymin;
+    writer->header.gridBox[2] = gridBox->Xmax;
+    writer->header.gridBox[3] = gridBox->Ymax;
+
+    writer->fp = fopen(pathfile, "wb");
+    if (! writer->fp) {
+        printf("Error: Cannot create tile archive: %s\n", pathfile);
+        return -1;
+    }
+
+    // unfinished until header is written again with dirOffset
+    if (fwrite(&writer->header, sizeof(tileArchiveHeader), 1, writer->fp) != 1) {
+        printf("Error: Failed to write tile archive: %s\n", pathfile);
+        fclose(writer->fp);
+        writer->fp = 0;
+        remove(pathfile);
+        return -1;
+    }
+
+    writer->pathfile = mem_strdup(pathfile);
+    writer->offset = sizeof(tileArchiveHeader);
+
+    pthread_mutex_init(&writer->lock, 0);
+    return 0;
+}
+
+
+/**
+ * add entry of tile z/x/y. writer must be locked.
+ */
+static void tileArchiveAddEntry(tileArchiveWriter *writer, int z, int x, int y, ub8 offset, ub4 length)
+{
+    tileArchiveEntry *entry;
+
+    if ((sb8) writer->header.numEntries == writer->capacity) {
+        writer->capacity = (writer->capacity < 1024 ? 1024 : writer->capacity * 2);
+        writer->entries = (tileArchiveEntry *) mem_realloc(writer->entries, sizeof(tileArchiveEntry) * writer->capacity);
+    }
+
+    entry = &writer->entries[writer->header.numEntries++];
+    entry->tileId = tileArchiveTileId(z, x, y);
+    entry->offset = offset;
+    entry->length = length;
+    entry->reserved = 0;
+}
+
+
+int tileArchiveAppend(tileArchiveWriter *writer, int z, int x, int y, const void *blob, ub4 length, ub8 *offset)
+{
+    pthread_mutex_lock(&writer->lock);
+
+    if (writer->failed || fwrite(blob, 1, length, writer->fp) != length) {
+        writer->failed = 1;
+        pthread_mutex_unlock(&writer->lock);
+        return -1;
+    }
+
+    tileArchiveAddEntry(writer, z, x, y, writer->offset, length);
+
+    if (offset) {
+        *offset = writer->offset;
+    }
+    writer->offset += length;
+
+    pthread_mutex_unlock(&writer->lock);
+    return 0;
+}
+
+
+int tileArchiveAppendRef(tileArchiveWriter *writer, int z, int x, int y, ub8 offset, ub4 length)
+{
+    pthread_mutex_lock(&writer->lock);
+
+    if (writer->failed || offset < sizeof(tileArchiveHeader) || offset + length > writer->offset) {
+        writer->failed = 1;
+        pthread_mutex_unlock(&writer->lock);
+        return -1;
+    }
+
+    tileArchiveAddEntry(writer, z, x, y, offset, length);
+
+    pthread_mutex_unlock(&writer->lock);
+    return 0;
+}
+
+
+int tileArchiveFinish(tileArchiveWriter *writer, int commit)
+{
+    static const ub1 zeros[TILEARCHIVE_DIR_ALIGN] = { 0 };
+
+    int ret = -1;
+    size_t pad = (size_t) ((TILEARCHIVE_DIR_ALIGN - writer->offset % TILEARCHIVE_DIR_ALIGN) % TILEARCHIVE_DIR_ALIGN);
+    const size_t numEntries = (size_t) writer->header.numEntries;
+
+    if (! writer->fp) {
+        return -1;
+    }
+
+    if (commit && ! writer->failed) {
+        qsort(writer->entries, numEntries, sizeof(tileArchiveEntry), tileArchiveEntryCompare);
+
+        writer->header.dirOffset = writer->offset + pad;
+
+        if (fwrite(zeros, 1, pad, writer->fp) == pad &&
+            fwrite(writer->entries, sizeof(tileArchiveEntry), numEntries, writer->fp) == numEntries &&
+            fseek(writer->fp, 0, SEEK_SET) == 0 &&
+            fwrite(&writer->header, sizeof(tileArchiveHeader), 1, writer->fp) == 1) {
+            ret = 0;
+        }
+    }
+
+    if (fclose(writer->fp) != 0) {
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        printf("Info: tile archive written: %s (tiles=%" PRIu64 ", bytes=%" PRIu64 ")\n",
+            writer->pathfile, writer->header.numEntries, (ub8) (writer->header.dirOffset + sizeof(tileArchiveEntry) * numEntries));
+    } else {
+        if (commit) {
+            printf("Error: Failed to write tile archive: %s\n", writer->pathfile);
+        }
+        remove(writer->pathfile);
+    }
+
+    pthread_mutex_destroy(&writer->lock);
+    mem_free(writer->entries);
+    mem_free(writer->pathfile);
+    bzero(writer, sizeof(tileArchiveWriter));
+
+    return ret;
+}
+
+
+int tileArchiveOpen(tileArchive *archive, const char *pathfile)
+{
+    const tileArchiveHeader *header;
+
+    bzero(archive, sizeof(tileArchive));
+
+    archive->addr = shpFileMapBytes(pathfile, &archive->size);
+    if (! archive->addr) {
+        return -1;
+    }
+
+    header = (const tileArchiveHeader *) archive->addr;
+
+    if (archive->size < sizeof(tileArchiveHeader) ||
+        memcmp(header->magic, TILEARCHIVE_MAGIC, sizeof(header->magic)) ||
+        header->version != TILEARCHIVE_VERSION) {
+        printf("Error: Bad tile archive: %s\n", pathfile);
+        tileArchiveClose(archive);
+        return -1;
+    }
+
+    if (header->dirOffset < sizeof(tileArchiveHeader) || header->dirOffset % TILEARCHIVE_DIR_ALIGN ||
+        header->dirOffset > archive->size ||
+        (archive->size - header->dirOffset) / sizeof(tileArchiveEntry) != header->numEntries ||
+        (archive->size - header->dirOffset) % sizeof(tileArchiveEntry)) {
+        printf("Error: Unfinished or truncated tile archive: %s\n", pathfile);
+        tileArchiveClose(archive);
+        return -1;
+    }
+
+    archive->header = header;
+    archive->entries = (const tileArchiveEntry *) (archive->addr + header->dirOffset);
+
+    return 0;
+}
+
+
+void tileArchiveClose(tileArchive *archive)
+{
+    shpFileUnmapBytes(archive->addr, archive->size);
+    bzero(archive, sizeof(tileArchive));
+}
+
+
+const ub1 * tileArchiveLookup(const tileArchive *archive, int z, int x, int y, ub4 *length)
+{
+    ub8 tileId;
+    sb8 lo, hi, mid;
+    const tileArchiveEntry *entry;
+
+    if (z < 0 || z > TILEARCHIVE_ZOOM_MAX || x < 0 || y < 0 || x >= (1 << z) || y >= (1 << z)) {
+        return 0;
+    }
+
+    tileId = tileArchiveTileId(z, x, y);
+
+    lo = 0;
+    hi = (sb8) archive->header->numEntries - 1;
+
+    while (lo <= hi) {
+        mid = lo + (hi - lo) / 2;
+        entry = &archive->entries[mid];
+
+        if (entry->tileId < tileId) {
+            lo = mid + 1;
+        } else if (entry->tileId > tileId) {
+            hi = mid - 1;
+        } else {
+            if (entry->offset < sizeof(tileArchiveHeader) || entry->offset + entry->length > archive->header->dirOffset) {
+                // corrupted entry
+                return 0;
+            }
+            *length = entry->length;
+            return archive->addr + entry->offset;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file tilearchive.h
+ * @brief single-file archive of XYZ tiles with a sorted directory.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.2
+ *
+ * @since 2024-10-23 17:12:26
+ * @date 2024-10-23 19:40:52
+ *
+ * @note
+ *   .tiles file layout (little-endian):
+ *     tileArchiveHeader         72 bytes
+ *     ub1 blobs[]               png of tiles, in order of writing
+ *     ub1 pad[]                 zeros up to 8-byte boundary
+ *     tileArchiveEntry dir[numEntries]   sorted by tileId
+ *
+ *   Identical tiles may share one blob: their entries have same offset.
+ *
+ *   Blobs are appended as tiles are drawn and the directory is written
+ *   last, so the file is written sequentially. Only the header is written
+ *   twice: dirOffset is 0 until the archive is finished.
+ *
+ *   tileId of z/x/y is the number of tiles of zooms before z plus Hilbert
+ *   index of (x, y) at z, so that tiles close on map are close in the
+ *   directory.
+ */
+#ifndef TILE_ARCHIVE_H__
+#define TILE_ARCHIVE_H__
+
+#ifdef    __cplusplus
+extern "C" {
+#endif
+
+#include <common/basetype.h>
+#include <common/cgtypes.h>
+
+#include <pthread.h>
+
+
+#define TILEARCHIVE_FILE_EXT    ".tiles"
+#define TILEARCHIVE_MAGIC       "SHPTIL\0\1"
+
+
+typedef struct
+{
+    char magic[8];
+
+    sb4 version;
+    sb4 tileSize;
+    sb4 minZoom;
+    sb4 maxZoom;
+
+    ub8 numEntries;
+
+    // offset of directory, 0 if archive is not finished
+    ub8 dirOffset;
+
+    // Xmin, Ymin, Xmax, Ymax of tile 0/0/0
+    double gridBox[4];
+} tileArchiveHeader;
+
+
+typedef struct
+{
+    ub8 tileId;
+    ub8 offset;
+    ub4 length;
+    ub4 reserved;
+} tileArchiveEntry;
+
+
+typedef struct
+{
+    FILE *fp;
+    char *pathfile;
+
+    tileArchiveHeader header;
+
+    // end of blobs written
+    ub8 offset;
+
+    tileArchiveEntry *entries;
+    sb8 capacity;
+
+    int failed;
+
+    // tiles are appended by drawing threads
+    pthread_mutex_t lock;
+} tileArchiveWriter;
+
+
+typedef struct
+{
+    // mapped .tiles file
+    const ub1 *addr;
+    size_t size;
+
+    const tileArchiveHeader *header;
+    const tileArchiveEntry *entries;
+} tileArchive;
+
+
+/**
+ * id of tile z/x/y, x and y in [0, 2^z)
+ */
+extern ub8 tileArchiveTileId(int z, int x, int y);
+
+/**
+ * create archive file for writing. returns 0 on success.
+ */
+extern int tileArchiveCreate(tileArchiveWriter *writer, const char *pathfile, const CGBox2D *gridBox, int tileSize, int minZoom, int maxZoom);
+
+/**
+ * append blob of tile z/x/y. thread safe. offset of blob is returned in
+ *   offset if not null. returns 0 on success.
+ */
+extern int tileArchiveAppend(tileArchiveWriter *writer, int z, int x, int y, const void *blob, ub4 length, ub8 *offset);
+
+/**
+ * add tile z/x/y sharing blob appended before. thread safe.
+ */
+extern int tileArchiveAppendRef(tileArchiveWriter *writer, int z, int x, int y, ub8 offset, ub4 length);
+
+/**
+ * write directory and close. archive file is removed if commit is 0 or
+ *   writing ever failed. returns 0 on success.
+ */
+extern int tileArchiveFinish(tileArchiveWriter *writer, int commit);
+
+/**
+ * open (mmap) a finished .tiles file. returns 0 on success.
+ */
+extern int tileArchiveOpen(tileArchive *archive, const char *pathfile);
+
+extern void tileArchiveClose(tileArchive *archive);
+
+/**
+ * find blob of tile z/x/y in mapped archive. returns 0 if not found.
+ */
+extern const ub1 * tileArchiveLookup(const tileArchive *archive, int z, int x, int y, ub4 *length);
+
+#ifdef    __cplusplus
+}
+#endif
+#endif /* TILE_ARCHIVE_H__ */
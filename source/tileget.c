@@ -0,0 +1,83 @@
+/******************************************************************************
+* Copyright © 2024-2035 Light Zhang <mapaware@hotmail.com>, MapAware, Inc.
+* ALL RIGHTS RESERVED.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+******************************************************************************/
+/**
+ * @file tileget.c
+ * @brief read one tile out of tile archive (.tiles) into png file.
+ *
+ * @author mapaware@hotmail.com
+ * @copyright © 2024-2030 mapaware.top All Rights Reserved.
+ * @version 0.0.1
+ *
+ * @since 2024-10-23 17:12:26
+ * @date 2024-10-23 17:12:26
+ *
+ * @note
+ */
+#include "shapetool-common.h"
+#include "tilearchive.h"
+
+
+int tilearchive2png(shapetool_flags *flags, shapetool_options *options)
+{
+    int ret = SHAPETOOL_RES_ERR;
+
+    FILE *fp;
+    tileArchive archive;
+    const ub1 *blob;
+    ub4 length = 0;
+
+    const char *archivefile = CSTR_FILE_URI_PATH(options->archive);
+    const char *pngfile = CSTR_FILE_URI_PATH(options->outpng);
+
+    if (tileArchiveOpen(&archive, archivefile) != 0) {
+        return SHAPETOOL_RES_ERR;
+    }
+
+    blob = tileArchiveLookup(&archive, options->tilez, options->tilex, options->tiley, &length);
+    if (! blob) {
+        printf("Error: tile not found: %d/%d/%d\n", options->tilez, options->tilex, options->tiley);
+        tileArchiveClose(&archive);
+        return SHAPETOOL_RES_ERR;
+    }
+
+    fp = fopen(pngfile, "wb");
+    if (! fp) {
+        printf("Error: Cannot create png file: %s\n", pngfile);
+    } else {
+        if (fwrite(blob, 1, length, fp) == length) {
+            ret = SHAPETOOL_RES_SOK;
+        }
+        if (fclose(fp) != 0) {
+            ret = SHAPETOOL_RES_ERR;
+        }
+        if (ret == SHAPETOOL_RES_SOK) {
+            printf("Info: tile %d/%d/%d: %u bytes => %s\n", options->tilez, options->tilex, options->tiley, length, pngfile);
+        } else {
+            printf("Error: Failed to write png file: %s\n", pngfile);
+            remove(pngfile);
+        }
+    }
+
+    tileArchiveClose(&archive);
+    return ret;
+}